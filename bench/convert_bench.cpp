@@ -0,0 +1,189 @@
+// File Description
+// microbenchmark for the vertex conversion kernels
+// compares the old per-vertex glm path with the bulk scalar/SSE2/AVX2 kernels
+
+#include "convert.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+using namespace DATA;
+
+// interleaved synthetic accessor layout
+struct SourceVertex
+{
+    float pos[3];
+    float normal[3];
+    float tangent[4];
+    float coord[2];
+    float color[4];
+};
+
+// the loader loop before the bulk kernels
+static std::vector<Vertex> convertLegacy(const std::vector<SourceVertex>& source)
+{
+    const float* bufferPos = source[0].pos;
+    const float* bufferNormal = source[0].normal;
+    const float* bufferTangent = source[0].tangent;
+    const float* bufferCoord0 = source[0].coord;
+    const float* bufferColor = source[0].color;
+    const size_t stride = sizeof(SourceVertex) / sizeof(float);
+    std::vector<Vertex> vertices;
+    for(size_t v = 0; v < source.size(); v++)
+    {
+        Vertex vert{};
+        vert.pos = glm::make_vec3(&bufferPos[v * stride]);
+        vert.normal = glm::normalize(glm::make_vec3(&bufferNormal[v * stride]));
+        vert.tangent = glm::make_vec4(&bufferTangent[v * stride]);
+        vert.coord = glm::make_vec2(&bufferCoord0[v * stride]);
+        vert.color = glm::make_vec4(&bufferColor[v * stride]);
+        vertices.push_back(vert);
+    }
+    return vertices;
+}
+
+static void convertBulkInto(std::vector<Vertex>& vertices, const std::vector<SourceVertex>& source, ConvertPaths path)
+{
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(source.data());
+    AttributeSource sources[VERTEX_ATTRIBUTE_COUNT];
+    const size_t offsets[VERTEX_ATTRIBUTE_COUNT] = {
+        offsetof(SourceVertex, pos), offsetof(SourceVertex, normal), offsetof(SourceVertex, tangent),
+        offsetof(SourceVertex, coord), offsetof(SourceVertex, color)
+    };
+    const uint32_t components[VERTEX_ATTRIBUTE_COUNT] = {3, 3, 4, 2, 4};
+    for(uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+    {
+        sources[a].data = base + offsets[a];
+        sources[a].count = source.size();
+        sources[a].stride = sizeof(SourceVertex);
+        sources[a].components = components[a];
+        sources[a].type = ATTRIBUTE_FLOAT;
+    }
+    convertVertices(vertices.data(), vertices.size(), sources, path);
+}
+
+static std::vector<Vertex> convertBulk(const std::vector<SourceVertex>& source, ConvertPaths path)
+{
+    std::vector<Vertex> vertices(source.size());
+    convertBulkInto(vertices, source, path);
+    return vertices;
+}
+
+static float maxDifference(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+    const float* fa = reinterpret_cast<const float*>(a.data());
+    const float* fb = reinterpret_cast<const float*>(b.data());
+    size_t n = a.size() * sizeof(Vertex) / sizeof(float);
+    float diff = 0.0f;
+    for(size_t i = 0; i < n; i++)
+        diff = std::max(diff, std::fabs(fa[i] - fb[i]));
+    return diff;
+}
+
+// run func a few times and keep the best time in ms
+template<typename F>
+static double measure(F func, int runs)
+{
+    double best = 1e30;
+    for(int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 4000000;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<SourceVertex> source(count);
+    for(auto& v : source)
+    {
+        float* f = v.pos;
+        for(size_t i = 0; i < sizeof(SourceVertex) / sizeof(float); i++)
+            f[i] = dist(rng);
+    }
+
+    // narrow sources for the normalized integer kernels
+    std::vector<uint8_t> colors8(count * 4);
+    std::vector<uint16_t> coords16(count * 2);
+    for(auto& c : colors8) c = static_cast<uint8_t>(rng() & 0xFF);
+    for(auto& c : coords16) c = static_cast<uint16_t>(rng() & 0xFFFF);
+    // KHR_mesh_quantization style sources, snorm8 normals padded to 4 bytes and int16 positions padded to 8
+    std::vector<int8_t> normals8(count * 4);
+    std::vector<int16_t> positions16(count * 4);
+    for(auto& c : normals8) c = static_cast<int8_t>(rng() & 0xFF);
+    for(auto& c : positions16) c = static_cast<int16_t>(rng() & 0xFFFF);
+
+    printf("vertices %zu, best of %d runs, cpu path %s\n", count, runs, getVertexConvertPathName(getVertexConvertPath()));
+
+    std::vector<Vertex> reference = convertBulk(source, CONVERT_PATH_SCALAR);
+    double legacyMs = measure([&](){convertLegacy(source);}, runs);
+    printf("%-24s %9.2f ms\n", "legacy per-vertex", legacyMs);
+
+    const ConvertPaths paths[] = {CONVERT_PATH_SCALAR, CONVERT_PATH_SSE2, CONVERT_PATH_AVX2};
+    for(ConvertPaths path : paths)
+    {
+        if(path > getVertexConvertPath()) continue;
+        double ms = measure([&](){convertBulk(source, path);}, runs);
+        std::vector<Vertex> output = convertBulk(source, path);
+        float diff = maxDifference(reference, output);
+        // kernels only, output is already allocated and touched
+        double kernelMs = measure([&](){convertBulkInto(output, source, path);}, runs);
+        printf("%-24s %9.2f ms (%.2fx, max diff %g), kernels only %.2f ms\n",
+            getVertexConvertPathName(path), ms, legacyMs / ms, diff, kernelMs);
+    }
+
+    // normalized integer sources
+    std::vector<Vertex> vertices(count);
+    AttributeSource color8;
+    color8.data = colors8.data(); color8.count = count; color8.stride = 4; color8.components = 4; color8.type = ATTRIBUTE_UNORM8;
+    AttributeSource coord16;
+    coord16.data = reinterpret_cast<const unsigned char*>(coords16.data()); coord16.count = count; coord16.stride = 4;
+    coord16.components = 2; coord16.type = ATTRIBUTE_UNORM16;
+    for(ConvertPaths path : paths)
+    {
+        if(path > getVertexConvertPath()) continue;
+        double ms8 = measure([&](){convertVertexAttribute(vertices.data(), count, VERTEX_COLOR, color8, path);}, runs);
+        double ms16 = measure([&](){convertVertexAttribute(vertices.data(), count, VERTEX_COORD, coord16, path);}, runs);
+        printf("%-24s unorm8 color %8.2f ms, unorm16 coord %8.2f ms\n", getVertexConvertPathName(path), ms8, ms16);
+    }
+
+    // signed quantized sources, compared against the scalar path
+    AttributeSource normal8;
+    normal8.data = reinterpret_cast<const unsigned char*>(normals8.data()); normal8.count = count; normal8.stride = 4;
+    normal8.components = 3; normal8.type = ATTRIBUTE_SNORM8;
+    AttributeSource position16;
+    position16.data = reinterpret_cast<const unsigned char*>(positions16.data()); position16.count = count; position16.stride = 8;
+    position16.components = 3; position16.type = ATTRIBUTE_SINT16;
+    std::vector<Vertex> quantizedReference(count);
+    convertVertexAttribute(quantizedReference.data(), count, VERTEX_NORMAL, normal8, CONVERT_PATH_SCALAR);
+    convertVertexAttribute(quantizedReference.data(), count, VERTEX_POSITION, position16, CONVERT_PATH_SCALAR);
+    for(ConvertPaths path : paths)
+    {
+        if(path > getVertexConvertPath()) continue;
+        double ms8 = measure([&](){convertVertexAttribute(vertices.data(), count, VERTEX_NORMAL, normal8, path);}, runs);
+        double ms16 = measure([&](){convertVertexAttribute(vertices.data(), count, VERTEX_POSITION, position16, path);}, runs);
+        // only the normal and position members are written, the rest still holds the previous loop
+        for(size_t i = 0; i < count; i++)
+        {
+            vertices[i].tangent = quantizedReference[i].tangent;
+            vertices[i].coord = quantizedReference[i].coord;
+            vertices[i].color = quantizedReference[i].color;
+        }
+        printf("%-24s snorm8 normal %7.2f ms, sint16 pos %8.2f ms (max diff %g)\n", getVertexConvertPathName(path), ms8, ms16,
+            maxDifference(quantizedReference, vertices));
+    }
+    return 0;
+}
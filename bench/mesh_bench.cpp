@@ -0,0 +1,257 @@
+// File Description
+// microbenchmark and check for the load time mesh passes
+// runs them on a synthetic height field and checks that the output is still the same mesh
+// returns 1 if a check fails
+
+#include "mesh.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+using namespace DATA;
+
+// size x size quads of a smooth height field, indexed, triangles in random order
+static GraphUserInput createHeightField(size_t size, std::mt19937& rng)
+{
+    GraphUserInput mesh;
+    for(size_t y = 0; y <= size; y++)
+    {
+        for(size_t x = 0; x <= size; x++)
+        {
+            Vertex vertex{};
+            float fx = static_cast<float>(x) / size, fy = static_cast<float>(y) / size;
+            float height = 0.1f * std::sin(fx * 12.0f) * std::cos(fy * 9.0f);
+            vertex.pos = glm::vec3(fx, fy, height);
+            vertex.normal = glm::normalize(glm::vec3(-1.2f * std::cos(fx * 12.0f) * std::cos(fy * 9.0f),
+                0.9f * std::sin(fx * 12.0f) * std::sin(fy * 9.0f), 1.0f));
+            vertex.coord = glm::vec2(fx, fy);
+            vertex.color = glm::vec4(1.0f);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    std::vector<std::array<uint32_t, 3>> triangles;
+    uint32_t row = static_cast<uint32_t>(size + 1);
+    for(uint32_t y = 0; y < size; y++)
+    {
+        for(uint32_t x = 0; x < size; x++)
+        {
+            uint32_t v = y * row + x;
+            triangles.push_back({{v, v + 1, v + row}});
+            triangles.push_back({{v + 1, v + row + 1, v + row}});
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), rng);
+    for(auto& triangle : triangles)
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    return mesh;
+}
+
+// triangle as corner positions, rotated so the smallest corner comes first, winding is kept
+typedef std::array<float, 9> TriangleKey;
+
+static std::vector<TriangleKey> findTriangleKeys(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+    std::vector<TriangleKey> keys;
+    for(size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        std::array<std::array<float, 3>, 3> corners;
+        for(size_t c = 0; c < 3; c++)
+        {
+            const glm::vec3& pos = vertices[indices[t + c]].pos;
+            corners[c] = {{pos.x, pos.y, pos.z}};
+        }
+        size_t first = std::min_element(corners.begin(), corners.end()) - corners.begin();
+        TriangleKey key;
+        for(size_t c = 0; c < 3; c++)
+            std::copy(corners[(first + c) % 3].begin(), corners[(first + c) % 3].end(), key.begin() + c * 3);
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+static bool indicesValid(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    if(indices.size() % 3) return false;
+    for(uint32_t index : indices)
+        if(index >= vertexCount) return false;
+    return true;
+}
+
+static int failures = 0;
+
+static void check(bool passed, const char* what)
+{
+    printf("  %-56s %s\n", what, passed ? "ok" : "FAILED");
+    if(!passed) failures++;
+}
+
+// run func a few times and keep the best time in ms
+template<typename F>
+static double measure(F func, int runs)
+{
+    double best = 1e30;
+    for(int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 256;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    std::mt19937 rng(7);
+    const GraphUserInput source = createHeightField(size, rng);
+    const std::vector<TriangleKey> sourceKeys = findTriangleKeys(source.indices, source.vertices);
+    printf("height field %zux%zu, %zu vertices, %zu triangles, best of %d runs\n", size, size, source.vertices.size(),
+        source.indices.size() / 3, runs);
+
+    // duplicated vertices of a non-indexed copy and of an indexed copy with every vertex doubled (GRAPH_WELD_MESHES)
+    {
+        GraphUserInput expanded;
+        for(uint32_t index : source.indices)
+            expanded.vertices.push_back(source.vertices[index]);
+        GraphUserInput mesh;
+        size_t removed = 0;
+        double ms = measure([&](){mesh = expanded; removed = weldVertices(mesh.vertices, mesh.indices);}, runs);
+        printf("weldVertices %9.2f ms, %zu -> %zu vertices\n", ms, expanded.vertices.size(), mesh.vertices.size());
+        check(mesh.vertices.size() == source.vertices.size() && removed == expanded.vertices.size() - mesh.vertices.size(),
+            "non-indexed mesh welded to the unique vertices");
+        check(mesh.indices.size() == source.indices.size() && indicesValid(mesh.indices, mesh.vertices.size()),
+            "non-indexed mesh got valid indices");
+        check(findTriangleKeys(mesh.indices, mesh.vertices) == sourceKeys, "non-indexed mesh keeps its triangles");
+
+        GraphUserInput doubled = source;
+        doubled.vertices.insert(doubled.vertices.end(), source.vertices.begin(), source.vertices.end());
+        for(size_t i = 0; i < doubled.indices.size(); i += 2)
+            doubled.indices[i] += static_cast<uint32_t>(source.vertices.size());
+        weldVertices(doubled.vertices, doubled.indices, 0.0001f);
+        check(doubled.vertices.size() == source.vertices.size() && indicesValid(doubled.indices, doubled.vertices.size()),
+            "doubled vertices welded with an epsilon");
+        check(findTriangleKeys(doubled.indices, doubled.vertices) == sourceKeys, "doubled mesh keeps its triangles");
+    }
+
+    // vertex cache, overdraw and vertex fetch order (GRAPH_OPTIMIZE_MESHES)
+    {
+        GraphUserInput mesh;
+        double ms = measure([&](){mesh = source; optimizeMesh(mesh);}, runs);
+        VertexCacheStatistics before = analyzeVertexCache(source.indices, source.vertices.size());
+        VertexCacheStatistics after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+        printf("optimizeMesh %9.2f ms, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", ms, before.acmr(), after.acmr(), before.atvr(), after.atvr());
+        check(mesh.vertices.size() == source.vertices.size(), "vertex count kept");
+        check(indicesValid(mesh.indices, mesh.vertices.size()), "indices in range");
+        check(findTriangleKeys(mesh.indices, mesh.vertices) == sourceKeys, "same triangles with the same winding");
+        check(after.acmr() < before.acmr() && after.acmr() < 1.0f, "ACMR improved below 1");
+        bool fetchOrder = true;
+        uint32_t next = 0;
+        for(uint32_t index : mesh.indices)
+        {
+            if(index > next) fetchOrder = false;
+            if(index == next) next++;
+        }
+        check(fetchOrder, "vertices in first use order");
+    }
+
+    // meshlets of the cache optimized mesh (GRAPH_CULL_MESHLETS)
+    {
+        GraphUserInput mesh = source;
+        optimizeMesh(mesh);
+        std::vector<Meshlet> meshlets;
+        double ms = measure([&](){meshlets.clear(); buildMeshlets(mesh.indices, mesh.vertices, meshlets);}, runs);
+        size_t culled = 0;
+        for(const Meshlet& meshlet : meshlets)
+            if(meshlet.coneCutoff < 1.0f) culled++;
+        printf("buildMeshlets %8.2f ms, %zu meshlets, %zu with a cullable normal cone\n", ms, meshlets.size(), culled);
+        bool covered = true, limits = true, vertexCounts = true, spheres = true, cones = true;
+        uint32_t next = 0;
+        for(const Meshlet& meshlet : meshlets)
+        {
+            covered = covered && meshlet.indiceStart == next && meshlet.triangleCount > 0;
+            next = meshlet.indiceStart + meshlet.triangleCount * 3;
+            limits = limits && meshlet.triangleCount <= MESHLET_MAX_TRIANGLES && meshlet.vertexCount <= MESHLET_MAX_VERTICES;
+            if(next > mesh.indices.size()) { covered = false; break; }
+            std::vector<uint32_t> used(mesh.indices.begin() + meshlet.indiceStart, mesh.indices.begin() + next);
+            std::sort(used.begin(), used.end());
+            vertexCounts = vertexCounts && std::unique(used.begin(), used.end()) - used.begin() == meshlet.vertexCount;
+            float cosAngle = std::sqrt(std::max(0.0f, 1.0f - meshlet.coneCutoff * meshlet.coneCutoff));
+            for(uint32_t i = meshlet.indiceStart; i < next; i += 3)
+            {
+                const glm::vec3& p0 = mesh.vertices[mesh.indices[i]].pos;
+                const glm::vec3& p1 = mesh.vertices[mesh.indices[i + 1]].pos;
+                const glm::vec3& p2 = mesh.vertices[mesh.indices[i + 2]].pos;
+                for(const glm::vec3* p : {&p0, &p1, &p2})
+                    spheres = spheres && glm::length(*p - meshlet.center) <= meshlet.radius * 1.0001f + 1e-6f;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                if(meshlet.coneCutoff < 1.0f && glm::length(normal) > 0.0f)
+                    cones = cones && glm::dot(glm::normalize(normal), meshlet.coneAxis) >= cosAngle - 1e-4f;
+            }
+        }
+        check(covered && next == mesh.indices.size(), "meshlets cover all triangles in order");
+        check(limits, "meshlets within vertex and triangle limits");
+        check(vertexCounts, "meshlet vertex counts match their triangles");
+        check(spheres, "bounding spheres contain their triangles");
+        check(cones, "normal cones contain their triangle normals");
+    }
+
+    // simplification and LOD chains (GRAPH_GENERATE_LODS)
+    {
+        GraphUserInput mesh = source;
+        optimizeMesh(mesh);
+        glm::vec3 center;
+        float radius;
+        findMeshBounds(mesh.vertices, center, radius);
+        float maxError = MESH_LOD_MAX_ERROR * radius;
+        size_t target = (mesh.indices.size() / 6) * 3;
+        std::vector<uint32_t> result;
+        float error = 0.0f;
+        double ms = measure([&](){result.clear(); error = simplifyMesh(mesh.indices, mesh.vertices, target, maxError, result);}, runs);
+        printf("simplifyMesh %9.2f ms, %zu -> %zu triangles (target %zu), error %g of %g allowed\n", ms, mesh.indices.size() / 3,
+            result.size() / 3, target / 3, error, maxError);
+        check(indicesValid(result, mesh.vertices.size()), "simplified indices in range");
+        check(!result.empty() && result.size() <= target + target / 10, "simplified close to the target triangle count");
+        check(error >= 0.0f && error <= maxError, "simplification error within the limit");
+        bool degenerate = false;
+        for(size_t i = 0; i < result.size(); i += 3)
+            degenerate = degenerate || result[i] == result[i + 1] || result[i + 1] == result[i + 2] || result[i] == result[i + 2];
+        check(!degenerate, "no degenerate triangles");
+        // borders are locked, so the height field keeps its extent
+        glm::vec3 minPos(mesh.vertices[result.empty() ? 0 : result[0]].pos), maxPos(minPos);
+        for(uint32_t index : result)
+        {
+            minPos = glm::min(minPos, mesh.vertices[index].pos);
+            maxPos = glm::max(maxPos, mesh.vertices[index].pos);
+        }
+        check(minPos.x == 0.0f && minPos.y == 0.0f && maxPos.x == 1.0f && maxPos.y == 1.0f, "borders kept in place");
+
+        std::vector<std::vector<uint32_t>> lods;
+        std::vector<float> errors;
+        ms = measure([&](){generateMeshLods(mesh.indices, mesh.vertices, MESH_MAX_LODS, lods, errors);}, runs);
+        printf("generateMeshLods %5.2f ms, %zu levels:", ms, lods.size());
+        for(size_t l = 0; l < lods.size(); l++)
+            printf(" %zu (%g)", lods[l].size() / 3, errors[l]);
+        printf("\n");
+        bool chain = !lods.empty() && lods.size() <= MESH_MAX_LODS && errors.size() == lods.size();
+        for(size_t l = 0; chain && l < lods.size(); l++)
+        {
+            size_t previous = l ? lods[l - 1].size() : mesh.indices.size();
+            chain = indicesValid(lods[l], mesh.vertices.size()) && !lods[l].empty() && lods[l].size() < previous &&
+                (!l || errors[l] >= errors[l - 1]);
+        }
+        check(chain, "LOD levels valid, shrinking, errors growing");
+    }
+
+    printf("%s\n", failures ? "mesh checks FAILED" : "all mesh checks passed");
+    return failures ? 1 : 0;
+}
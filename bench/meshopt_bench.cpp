@@ -0,0 +1,203 @@
+// File Description
+// known-answer check and microbenchmark for the EXT_meshopt_compression decoders
+// the encoded buffers are the reference vectors of the meshoptimizer codecs and hand encoded ones
+// returns 1 if a check fails
+
+#include "meshopt.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace DATA;
+
+static int failures = 0;
+
+static void check(bool passed, const char* what)
+{
+    printf("  %-56s %s\n", what, passed ? "ok" : "FAILED");
+    if(!passed) failures++;
+}
+
+// run func a few times and keep the best time in ms
+template<typename F>
+static double measure(F func, int runs)
+{
+    double best = 1e30;
+    for(int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if(ms < best) best = ms;
+    }
+    return best;
+}
+
+// index codec version 0 and 1, and index sequence version 1 of the meshoptimizer tests
+static const unsigned char INDEX_DATA_V0[] = {
+    0xe0, 0xf0, 0x10, 0xfe, 0xff, 0xf0, 0x0c, 0xff, 0x02, 0x02, 0x02, 0x00, 0x76, 0x87,
+    0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00,
+};
+static const uint32_t INDEX_BUFFER_V0[] = {0, 1, 2, 2, 1, 3, 4, 6, 5, 7, 8, 9};
+
+static const unsigned char INDEX_DATA_V1[] = {
+    0xe1, 0xf0, 0x10, 0xfe, 0x1f, 0x3d, 0x00, 0x0a, 0x00, 0x76, 0x87, 0x56, 0x67, 0x78,
+    0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00,
+};
+static const uint32_t INDEX_BUFFER_V1[] = {0, 1, 2, 2, 1, 3, 0, 1, 2, 2, 1, 5, 2, 1, 4};
+
+static const unsigned char INDEX_SEQUENCE_V1[] = {
+    0xd1, 0x00, 0x04, 0xcd, 0x01, 0x04, 0x07, 0x98, 0x1f, 0x00, 0x00, 0x00, 0x00,
+};
+static const uint32_t INDEX_SEQUENCE[] = {0, 1, 51, 2, 49, 1000};
+
+// 12 byte vertices, every byte column is a byte group with a 2 bit header, escapes hold the zigzag deltas
+struct PackedVertex
+{
+    uint16_t px, py, pz;
+    uint8_t nu, nv;
+    uint16_t tx, ty;
+};
+static const PackedVertex VERTEX_BUFFER[] = {
+    {0, 0, 0, 0, 0, 0, 0},
+    {300, 0, 0, 0, 0, 500, 0},
+    {0, 300, 0, 0, 0, 0, 500},
+    {300, 300, 0, 0, 0, 500, 500},
+};
+static const unsigned char VERTEX_DATA_V0[] = {
+    0xa0,
+    0x01, 0x3f, 0x00, 0x00, 0x00, 0x58, 0x57, 0x58, // px low: 0 44 0 44
+    0x01, 0x26, 0x00, 0x00, 0x00,                   // px high: 0 1 0 1
+    0x01, 0x0c, 0x00, 0x00, 0x00, 0x58,             // py low: 0 0 44 44
+    0x01, 0x08, 0x00, 0x00, 0x00,                   // py high: 0 0 1 1
+    0x00, 0x00, 0x00, 0x00,                         // pz, nu and nv are all zero
+    0x01, 0x3f, 0x00, 0x00, 0x00, 0x17, 0x18, 0x17, // tx low: 0 244 0 244
+    0x01, 0x26, 0x00, 0x00, 0x00,                   // tx high: 0 1 0 1
+    0x01, 0x0c, 0x00, 0x00, 0x00, 0x17,             // ty low: 0 0 244 244
+    0x01, 0x08, 0x00, 0x00, 0x00,                   // ty high: 0 0 1 1
+    // tail of 32 bytes ending with the first vertex
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// filter inputs and the results of the formulas of the extension, five elements cover the SSE2 and scalar paths
+static const int8_t OCT8_DATA[] = {
+    0, 0, 127, 11,  127, 0, 127, 22,  127, 127, 127, 33,  64, 64, 127, 44,  100, -20, 127, -55,
+};
+static const int8_t OCT8_RESULT[] = {
+    0, 0, 127, 11,  127, 0, 0, 22,  0, 0, -127, 33,  90, 90, -1, 44,  124, -25, 9, -55,
+};
+static const int16_t OCT16_DATA[] = {
+    0, 0, 32767, 1,  32767, 0, 32767, 2,  -20000, 5000, 32767, 3,  30000, 30000, 32767, 4,  0, -32767, 32767, 5,
+};
+static const int16_t OCT16_RESULT[] = {
+    0, 0, 32767, 1,  32767, 0, 0, 2,  -29747, 7437, 11552, 3,  3295, 3295, -32434, 4,  0, -32767, 0, 5,
+};
+// w holds the scale in the top bits and the index of the largest component in the low 2 bits
+static const int16_t QUAT_DATA[] = {
+    0, 0, 0, 8191,  0, 0, 0, 8188,  4000, -3000, 1000, 8191,  -2048, 0, 2048, 8189,
+};
+static const int16_t QUAT_RESULT[] = {
+    0, 0, 0, 32767,  32767, 0, 0, 0,  11315, -8486, 2829, 29422,  5793, 31726, -5793, 0,
+};
+// signed exponent in the top 8 bits, signed 24 bit mantissa
+static const uint32_t EXP_DATA[] = {0x00000003, 0xff000001, 0x02ffffff, 0xf6000400, 0x00000000, 0x05000010};
+static const float EXP_RESULT[] = {3.0f, 0.5f, -4.0f, 1.0f, 0.0f, 512.0f};
+
+template<typename T, size_t N>
+static bool decodeIndexKAT(const unsigned char* data, size_t size, const uint32_t (&expected)[N], bool triangles)
+{
+    std::vector<T> result(N + 1, T(0x5a5a));
+    bool decoded = triangles ? decodeMeshoptTriangles(reinterpret_cast<unsigned char*>(result.data()), N, sizeof(T), data, size) :
+        decodeMeshoptIndices(reinterpret_cast<unsigned char*>(result.data()), N, sizeof(T), data, size);
+    if(!decoded || result[N] != T(0x5a5a)) return false;
+    for(size_t i = 0; i < N; i++)
+        if(result[i] != static_cast<T>(expected[i])) return false;
+    return true;
+}
+
+template<typename T, size_t N>
+static bool decodeFilterKAT(const T (&data)[N], const T (&expected)[N], size_t stride, MeshoptFilters filter)
+{
+    T result[N];
+    memcpy(result, data, sizeof(result));
+    decodeMeshoptFilter(reinterpret_cast<unsigned char*>(result), sizeof(result) / stride, stride, filter);
+    return memcmp(result, expected, sizeof(result)) == 0;
+}
+
+int main()
+{
+    const int runs = 20;
+
+    printf("index codecs\n");
+    check(decodeIndexKAT<uint32_t>(INDEX_DATA_V0, sizeof(INDEX_DATA_V0), INDEX_BUFFER_V0, true), "triangles v0, 32 bit");
+    check(decodeIndexKAT<uint16_t>(INDEX_DATA_V0, sizeof(INDEX_DATA_V0), INDEX_BUFFER_V0, true), "triangles v0, 16 bit");
+    check(decodeIndexKAT<uint32_t>(INDEX_DATA_V1, sizeof(INDEX_DATA_V1), INDEX_BUFFER_V1, true), "triangles v1, 32 bit");
+    check(decodeIndexKAT<uint16_t>(INDEX_DATA_V1, sizeof(INDEX_DATA_V1), INDEX_BUFFER_V1, true), "triangles v1, 16 bit");
+    check(decodeIndexKAT<uint32_t>(INDEX_SEQUENCE_V1, sizeof(INDEX_SEQUENCE_V1), INDEX_SEQUENCE, false), "sequence v1, 32 bit");
+    check(decodeIndexKAT<uint16_t>(INDEX_SEQUENCE_V1, sizeof(INDEX_SEQUENCE_V1), INDEX_SEQUENCE, false), "sequence v1, 16 bit");
+    {
+        uint32_t result[15];
+        std::vector<unsigned char> data(INDEX_DATA_V1, INDEX_DATA_V1 + sizeof(INDEX_DATA_V1));
+        bool rejected = true;
+        for(size_t size = 0; size < data.size(); size++)
+            rejected = rejected && !decodeMeshoptTriangles(reinterpret_cast<unsigned char*>(result), 15, 4, data.data(), size);
+        check(rejected, "truncated triangles rejected");
+        data[0] = 0xe2;
+        check(!decodeMeshoptTriangles(reinterpret_cast<unsigned char*>(result), 15, 4, data.data(), data.size()), "unknown triangle version rejected");
+        check(!decodeMeshoptIndices(reinterpret_cast<unsigned char*>(result), 6, 4, INDEX_SEQUENCE_V1, sizeof(INDEX_SEQUENCE_V1) - 1),
+            "truncated sequence rejected");
+        check(!decodeMeshoptBuffer(reinterpret_cast<unsigned char*>(result), 12, 3, INDEX_DATA_V0, sizeof(INDEX_DATA_V0),
+            MESHOPT_MODE_TRIANGLES, MESHOPT_FILTER_NONE), "index size 3 rejected");
+    }
+
+    printf("vertex codec\n");
+    {
+        PackedVertex result[4];
+        bool decoded = decodeMeshoptBuffer(reinterpret_cast<unsigned char*>(result), 4, sizeof(PackedVertex), VERTEX_DATA_V0,
+            sizeof(VERTEX_DATA_V0), MESHOPT_MODE_ATTRIBUTES, MESHOPT_FILTER_NONE);
+        check(decoded && memcmp(result, VERTEX_BUFFER, sizeof(result)) == 0, "attributes v0");
+        check(!decodeMeshoptVertices(reinterpret_cast<unsigned char*>(result), 4, sizeof(PackedVertex), VERTEX_DATA_V0,
+            sizeof(VERTEX_DATA_V0) - 1), "truncated attributes rejected");
+        check(!decodeMeshoptVertices(reinterpret_cast<unsigned char*>(result), 4, 6, VERTEX_DATA_V0, sizeof(VERTEX_DATA_V0)),
+            "stride 6 rejected");
+        std::vector<unsigned char> data(VERTEX_DATA_V0, VERTEX_DATA_V0 + sizeof(VERTEX_DATA_V0));
+        data[0] = 0xa1;
+        check(!decodeMeshoptVertices(reinterpret_cast<unsigned char*>(result), 4, sizeof(PackedVertex), data.data(), data.size()),
+            "unknown attribute version rejected");
+    }
+
+    printf("filters\n");
+    check(decodeFilterKAT(OCT8_DATA, OCT8_RESULT, 4, MESHOPT_FILTER_OCTAHEDRAL), "octahedral 8 bit");
+    check(decodeFilterKAT(OCT16_DATA, OCT16_RESULT, 8, MESHOPT_FILTER_OCTAHEDRAL), "octahedral 16 bit");
+    check(decodeFilterKAT(QUAT_DATA, QUAT_RESULT, 8, MESHOPT_FILTER_QUATERNION), "quaternion");
+    {
+        uint32_t result[6];
+        memcpy(result, EXP_DATA, sizeof(result));
+        decodeMeshoptFilter(reinterpret_cast<unsigned char*>(result), 3, 8, MESHOPT_FILTER_EXPONENTIAL);
+        check(memcmp(result, EXP_RESULT, sizeof(result)) == 0, "exponential");
+    }
+
+    // a large buffer of the same elements, every element has to match the scalar result
+    {
+        const size_t count = 1 << 20;
+        std::vector<int16_t> normals(count * 4), source(count * 4);
+        for(size_t i = 0; i < count; i++)
+            memcpy(&source[i * 4], &OCT16_DATA[(i % 5) * 4], 4 * sizeof(int16_t));
+        double ms = measure([&](){
+            normals = source;
+            decodeMeshoptFilter(reinterpret_cast<unsigned char*>(normals.data()), count, 8, MESHOPT_FILTER_OCTAHEDRAL);
+        }, runs);
+        bool same = true;
+        for(size_t i = 0; same && i < count; i++)
+            same = memcmp(&normals[i * 4], &OCT16_RESULT[(i % 5) * 4], 4 * sizeof(int16_t)) == 0;
+        printf("octahedral 16 bit %5.2f ms for %zu normals (including the copy)\n", ms, count);
+        check(same, "octahedral 16 bit, large buffer");
+    }
+
+    printf("%s\n", failures ? "meshopt checks FAILED" : "all meshopt checks passed");
+    return failures ? 1 : 0;
+}
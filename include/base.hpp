@@ -36,6 +36,8 @@ namespace BASE
         bool graphicsInit = false;
         uint32_t presentFamilyID;
         bool presentInit = false;
+        uint32_t transferFamilyID; // family with transfer but without graphics and compute support
+        bool transferInit = false;
     };
 
     struct VulkanSwapChainSupport
@@ -51,6 +53,7 @@ namespace BASE
     {
     friend class Renderer;
     friend class DATA::Graph;
+    friend class DATA::UploadQueue;
     friend class UTILS::UI;
     public:
         Backend();
@@ -115,6 +118,9 @@ namespace BASE
         VkDebugUtilsMessengerEXT d_debug_messenger;
         VkQueue d_graphics_queue;
         VkQueue d_present_queue;
+        VkQueue d_transfer_queue = VK_NULL_HANDLE; // null without a separate transfer family or BACKEND_ENABLE_TRANSFER_QUEUE
+        uint32_t d_transfer_family_id = 0;
+        DATA::MemoryAllocator* p_allocator = nullptr; // every buffer and image memory comes from here
     };
 
     class Renderer
@@ -129,7 +135,7 @@ namespace BASE
         void CreateGraph();
 
         // allocate render command buffers
-        std::vector<VkCommandBuffer> allocateRenderCommandBuffers(size_t size);
+        std::vector<VkCommandBuffer> allocateRenderCommandBuffers(size_t size, VkCommandBufferLevel level);
         // free render command buffers
         void freeRenderCommandBuffers(std::vector<VkCommandBuffer> buffers);
         // begin a single immediate command
@@ -186,7 +192,7 @@ namespace BASE
         VkExtent2D selectSwapChainExtent(VkSurfaceCapabilitiesKHR& capabilities);
         // create image
         void createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
-            VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+            VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, DATA::MemoryAllocation& imageMemory);
         // create image view from image
         VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
         // create shader module from source
@@ -197,8 +203,8 @@ namespace BASE
         void destroySwapChain();
         // recreate swap chain
         void recreateSwapChain();
-        // update uniform buffers
-        void updateUniformBuffers(USER_UPDATE user_func);
+        // let the user update the camera and write it to the frame slot of a swap chain image
+        void updateUniformBuffers(USER_UPDATE user_func, uint32_t imageID);
 
     private:
         Backend* p_backend;
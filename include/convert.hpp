@@ -0,0 +1,82 @@
+// File Description
+// bulk conversion kernels from strided attribute data (glTF accessors)
+// into the interleaved DATA::Vertex layout
+// AVX2 and SSE2 paths are picked at runtime, scalar path is the fallback
+// and packing of Vertex into the compact GPU vertex formats
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "data.hpp"
+
+namespace DATA
+{
+    // component types of an attribute source
+    // normalized types map to [0, 1] or [-1, 1], the others are converted as is (KHR_mesh_quantization)
+    enum AttributeComponentTypes
+    {
+        ATTRIBUTE_FLOAT,
+        ATTRIBUTE_UNORM8,
+        ATTRIBUTE_UNORM16,
+        ATTRIBUTE_SNORM8,
+        ATTRIBUTE_SNORM16,
+        ATTRIBUTE_UINT8,
+        ATTRIBUTE_UINT16,
+        ATTRIBUTE_SINT8,
+        ATTRIBUTE_SINT16,
+    };
+
+    // destination member inside Vertex
+    enum VertexAttributes
+    {
+        VERTEX_POSITION,    // vec3
+        VERTEX_NORMAL,      // vec3, normalized, zero vectors stay zero
+        VERTEX_TANGENT,     // vec4
+        VERTEX_COORD,       // vec2
+        VERTEX_COLOR,       // vec4, alpha set to 1 for vec3 sources
+        VERTEX_ATTRIBUTE_COUNT,
+    };
+
+    // kernel implementations
+    enum ConvertPaths
+    {
+        CONVERT_PATH_SCALAR,
+        CONVERT_PATH_SSE2,
+        CONVERT_PATH_AVX2,
+    };
+
+    // strided attribute data
+    struct AttributeSource
+    {
+        const unsigned char* data = nullptr;
+        size_t count = 0;
+        size_t stride = 0; // in bytes
+        uint32_t components = 0; // 2, 3 or 4
+        AttributeComponentTypes type = ATTRIBUTE_FLOAT;
+    };
+
+    // get the fastest path supported by the current CPU
+    ConvertPaths getVertexConvertPath();
+    // get readable name of a path
+    const char* getVertexConvertPathName(ConvertPaths path);
+    // convert count elements of src into dst[0, count) using the fastest path
+    void convertVertexAttribute(Vertex* dst, size_t count, VertexAttributes attribute, const AttributeSource& src);
+    // convert count elements of src into dst[0, count) using the given path
+    void convertVertexAttribute(Vertex* dst, size_t count, VertexAttributes attribute, const AttributeSource& src, ConvertPaths path);
+    // convert all attributes in one cache friendly pass, sources is indexed by VertexAttributes
+    // attributes with no data are written as zero, so dst does not need to be initialized
+    void convertVertices(Vertex* dst, size_t count, const AttributeSource* sources);
+    // same as above using the given path
+    void convertVertices(Vertex* dst, size_t count, const AttributeSource* sources, ConvertPaths path);
+
+    // get size of one vertex of a format in bytes
+    size_t getVertexFormatStride(VertexFormats format);
+    // get readable name of a format
+    const char* getVertexFormatName(VertexFormats format);
+    // find position bounds of vertices, stored positions are dequantized as offset + q * scale with q in [0, 1]
+    void findVertexQuantization(const Vertex* src, size_t count, glm::vec3& offset, glm::vec3& scale);
+    // pack count vertices into dst in format, offset and scale are only used by VERTEX_FORMAT_QUANTIZED
+    void packVertices(const Vertex* src, size_t count, VertexFormats format, const glm::vec3& offset, const glm::vec3& scale, unsigned char* dst);
+}
@@ -10,14 +10,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <array>
 #include <map>
 #include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+#include "memory.hpp"
 
 namespace DATA
 {
+    class UploadQueue;
+
     enum ShaderTypes
     {
         SHADER_VERTEX        = 0,
@@ -94,6 +104,118 @@ namespace DATA
 	    }
     };
 
+    // vertex layouts the graph can upload, chosen with GRAPH_VERTEX_FORMAT
+    // the graph keeps full Vertex data on the CPU and packs it when creating the vertex buffer
+    enum VertexFormats
+    {
+        VERTEX_FORMAT_FULL,         // Vertex, 64 bytes
+        VERTEX_FORMAT_COMPACT,      // CompactVertex, 28 bytes
+        VERTEX_FORMAT_QUANTIZED,    // QuantizedVertex, 24 bytes
+    };
+
+    // octahedral normal and tangent, half float coord and unorm8 color
+    struct CompactVertex
+    {
+        glm::vec3 pos;
+        int16_t normal[2];  // octahedral, snorm16
+        int8_t tangent[4];  // octahedral xy, handedness z, snorm8
+        uint16_t coord[2];  // half float
+        uint8_t color[4];   // unorm8
+
+        static VkVertexInputBindingDescription getBindingDescription()
+	    {
+	    	VkVertexInputBindingDescription bindingDescription{};
+	    	bindingDescription.binding = 0;
+	    	bindingDescription.stride = sizeof(CompactVertex);
+	    	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	    	return bindingDescription;
+	    }
+
+	    static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions()
+	    {
+	    	std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+	    	attributeDescriptions[0].binding = 0;
+	    	attributeDescriptions[0].location = 0;
+	    	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	    	attributeDescriptions[0].offset = offsetof(CompactVertex, pos);
+
+	    	attributeDescriptions[1].binding = 0;
+	    	attributeDescriptions[1].location = 1;
+	    	attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+	    	attributeDescriptions[1].offset = offsetof(CompactVertex, normal);
+
+	    	attributeDescriptions[2].binding = 0;
+	    	attributeDescriptions[2].location = 2;
+	    	attributeDescriptions[2].format = VK_FORMAT_R8G8B8A8_SNORM;
+	    	attributeDescriptions[2].offset = offsetof(CompactVertex, tangent);
+
+            attributeDescriptions[3].binding = 0;
+	    	attributeDescriptions[3].location = 3;
+	    	attributeDescriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+	    	attributeDescriptions[3].offset = offsetof(CompactVertex, coord);
+
+            attributeDescriptions[4].binding = 0;
+	    	attributeDescriptions[4].location = 4;
+	    	attributeDescriptions[4].format = VK_FORMAT_R8G8B8A8_UNORM;
+	    	attributeDescriptions[4].offset = offsetof(CompactVertex, color);
+
+	    	return attributeDescriptions;
+	    }
+    };
+
+    // CompactVertex with positions quantized inside the mesh bounds
+    // dequantized by MeshConstantData positionOffset and positionScale
+    struct QuantizedVertex
+    {
+        uint16_t pos[4];    // unorm16, w unused
+        int16_t normal[2];  // octahedral, snorm16
+        int8_t tangent[4];  // octahedral xy, handedness z, snorm8
+        uint16_t coord[2];  // half float
+        uint8_t color[4];   // unorm8
+
+        static VkVertexInputBindingDescription getBindingDescription()
+	    {
+	    	VkVertexInputBindingDescription bindingDescription{};
+	    	bindingDescription.binding = 0;
+	    	bindingDescription.stride = sizeof(QuantizedVertex);
+	    	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	    	return bindingDescription;
+	    }
+
+	    static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions()
+	    {
+	    	std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+	    	attributeDescriptions[0].binding = 0;
+	    	attributeDescriptions[0].location = 0;
+	    	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+	    	attributeDescriptions[0].offset = offsetof(QuantizedVertex, pos);
+
+	    	attributeDescriptions[1].binding = 0;
+	    	attributeDescriptions[1].location = 1;
+	    	attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+	    	attributeDescriptions[1].offset = offsetof(QuantizedVertex, normal);
+
+	    	attributeDescriptions[2].binding = 0;
+	    	attributeDescriptions[2].location = 2;
+	    	attributeDescriptions[2].format = VK_FORMAT_R8G8B8A8_SNORM;
+	    	attributeDescriptions[2].offset = offsetof(QuantizedVertex, tangent);
+
+            attributeDescriptions[3].binding = 0;
+	    	attributeDescriptions[3].location = 3;
+	    	attributeDescriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+	    	attributeDescriptions[3].offset = offsetof(QuantizedVertex, coord);
+
+            attributeDescriptions[4].binding = 0;
+	    	attributeDescriptions[4].location = 4;
+	    	attributeDescriptions[4].format = VK_FORMAT_R8G8B8A8_UNORM;
+	    	attributeDescriptions[4].offset = offsetof(QuantizedVertex, color);
+
+	    	return attributeDescriptions;
+	    }
+    };
+
     struct CameraUniform
     {
         glm::mat4 model = glm::mat4(1.0f);
@@ -101,9 +223,16 @@ namespace DATA
         glm::mat4 proj;
     };
 
-    struct NodeUniformData
+    // element of the transform storage buffer (binding = 1), one per node indexed by nodeID
+    struct NodeTransformData
     {
-        glm::mat4 localTransformation = glm::mat4(1.0f);
+        glm::mat4 world = glm::mat4(1.0f);
+    };
+
+    // element of the instance storage buffer (binding = 7), read with gl_InstanceIndex
+    struct InstanceData
+    {
+        uint32_t nodeID = 0; // node drawing the mesh, picks its transform
     };
 
     struct MeshConstantData
@@ -113,13 +242,17 @@ namespace DATA
         float hasNormal     = 0.0f;
         float hasOcclusion  = 0.0f;
         float hasEmissive   = 0.0f;
+        float padding[3]    = {0.0f, 0.0f, 0.0f};
+        // position = positionOffset + positionScale * stored position, only set for VERTEX_FORMAT_QUANTIZED
+        glm::vec4 positionOffset = glm::vec4(0.0f);
+        glm::vec4 positionScale  = glm::vec4(1.0f);
     };
 
     struct Image
     {
         VkImage image;
         VkImageView view;
-        VkDeviceMemory mem;
+        MemoryAllocation mem;
         bool allset = false;
 
         void destroy(VkDevice device)
@@ -127,7 +260,7 @@ namespace DATA
             if(!allset) return;
             vkDestroyImageView(device, view, nullptr);
             vkDestroyImage(device, image, nullptr);
-            vkFreeMemory(device, mem, nullptr);
+            mem.free();
             allset = false;
         }
     };
@@ -135,13 +268,13 @@ namespace DATA
     struct Buffer
     {
         VkBuffer buf;
-        VkDeviceMemory mem;
+        MemoryAllocation mem;
         bool allset = false;
         void destroy(VkDevice device)
         {
             if(!allset) return;
             vkDestroyBuffer(device, buf, nullptr);
-            vkFreeMemory(device, mem, nullptr);
+            mem.free();
             allset = false;
         }
     };
@@ -149,17 +282,60 @@ namespace DATA
     struct Texture
     {
         Image image;
-        VkSampler sampler;
+        VkSampler sampler; // owned by the sampler cache of the graph
         bool allset = false;
         void destroy(VkDevice device)
         {
             if(!allset) return;
             image.destroy(device);
-            vkDestroySampler(device, sampler, nullptr);
             allset = false;
         }
     };
 
+    // parameters samplers are cached by, textures with equal parameters share one sampler
+    struct SamplerParams
+    {
+        VkFilter filter = VK_FILTER_LINEAR;
+        VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        bool mipmaps = true; // sample all levels, else level 0 only
+        bool anisotropy = true;
+        bool operator<(const SamplerParams& other) const
+        {
+            if(filter != other.filter) return filter < other.filter;
+            if(addressMode != other.addressMode) return addressMode < other.addressMode;
+            if(mipmaps != other.mipmaps) return mipmaps < other.mipmaps;
+            return anisotropy < other.anisotropy;
+        }
+    };
+
+    // CPU side texture, mip levels are stored one after another in pixels
+    struct TextureData
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t levels = 1; // mip levels stored in pixels
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        std::vector<VkDeviceSize> levelOffsets = {0};
+        std::vector<unsigned char> pixels;
+    };
+
+    // how decoded textures are prepared on the workers before upload
+    struct TextureTarget
+    {
+        bool mipmap = false; // build the mip chain on the CPU
+        bool compress = false; // encode 8 bit textures into BC1 or BC3
+        std::vector<VkFormat> blockFormats; // block compressed formats the device can sample
+    };
+
+    // model file of a composed scene, placed by its root transform
+    struct GraphModel
+    {
+        std::string path;
+        glm::mat4 transform;
+        GraphModel(const std::string& modelPath = "", const glm::mat4& rootTransform = glm::mat4(1.0f))
+            : path(modelPath), transform(rootTransform) {}
+    };
+
     struct GraphUserInput
     {
         std::vector<Vertex> vertices;
@@ -167,13 +343,84 @@ namespace DATA
         std::string textureImagePath;
     };
 
+    // staging buffer that decoded geometry is packed into without a copy on the CPU
+    // vertex region in the vertex format, followed by the indice buffer layout at indiceOffset
+    struct GeometryStaging
+    {
+        VkBuffer buffer = VK_NULL_HANDLE; // staged through the upload queue
+        VkDeviceSize bufferOffset = 0;
+        unsigned char* mapped = nullptr;
+        uint64_t vertexCount = 0;
+        VkDeviceSize vertexSize = 0;
+        VkDeviceSize indiceOffset = 0; // 4 byte aligned
+        VkDeviceSize indiceSize = 0;
+        VkDeviceSize indiceOffset32 = 0; // of the 32 bit region inside the indice layout
+        std::vector<VkIndexType> indiceTypes; // per geometry
+        std::vector<uint32_t> indiceStarts; // per geometry, inside the region of its type
+        // copies from the staged regions into the vertex and indice buffers, offsets relative to the start of each region
+        // merged geometries are left out, so the buffers can be smaller than the regions
+        std::vector<VkBufferCopy> vertexCopies;
+        std::vector<VkBufferCopy> indiceCopies;
+        // set before beginGeometryStaging to also keep the regions on the CPU, e.g. for the scene cache
+        // compacted like the buffers, so they end up with the same bytes
+        bool keepCopy = false;
+        std::vector<unsigned char> vertexCopy;
+        std::vector<unsigned char> indiceCopy;
+        // first byte of a geometry inside the indice region
+        VkDeviceSize indiceByteOffset(uint32_t geometryID) const
+        {
+            if(indiceTypes[geometryID] == VK_INDEX_TYPE_UINT16) return (VkDeviceSize)indiceStarts[geometryID] * sizeof(uint16_t);
+            return indiceOffset32 + (VkDeviceSize)indiceStarts[geometryID] * sizeof(uint32_t);
+        }
+    };
+
+    // textures decoded on the workers while the graph is already drawn with placeholders
+    // shared with the decode tasks, so it stays alive until the last one finishes
+    struct TextureStream
+    {
+        std::vector<std::vector<unsigned char>> encoded; // freed once decoded
+        std::vector<TextureData> textures;
+        std::vector<std::string> errors;
+        std::vector<uint32_t> slots; // d_unique_textures slot of each texture
+        std::deque<size_t> decoded; // waiting for upload, guarded by mutex
+        std::mutex mutex;
+        std::atomic<bool> cancelled{false};
+        size_t uploaded = 0;
+        // scene cache is written when all textures are uploaded
+        std::string cachePath;
+        std::vector<unsigned char> vertexBlob;
+        std::vector<unsigned char> indiceBlob;
+        std::vector<std::string> dependencies;
+    };
+
+    // simplified levels stored after the full level of a mesh
+    const uint32_t MESH_MAX_LODS = 4;
+
+    // simplified level of a mesh, sharing the vertices of the full level
+    struct MeshLod
+    {
+        uint32_t indiceOffset; // first index relative to the mesh
+        uint32_t indiceCount;
+        float error; // simplification error in mesh space
+    };
+
     struct Mesh
     {
         // for rendering
+        // indices are local to the mesh, indiceStart is the first index in the region of indiceType
         uint32_t indiceStart;
         uint32_t indiceCount = 0;
-        uint32_t vertexStart;
+        uint32_t vertexStart; // vertex offset applied to the indices
         uint32_t vertexCount = 0;
+        VkIndexType indiceType = VK_INDEX_TYPE_UINT32; // UINT16 for meshes with less than 65536 vertices
+        // meshlets in d_meshlets, meshes without meshlets are drawn whole
+        uint32_t meshletStart = 0;
+        uint32_t meshletCount = 0;
+        // simplified levels, indiceCount only covers the full level
+        uint32_t lodCount = 0;
+        MeshLod lods[MESH_MAX_LODS];
+        glm::vec3 boundsCenter = glm::vec3(0.0f); // bounding sphere in mesh space
+        float boundsRadius = 0.0f;
         // texture bindings
         uint32_t texBase      = 0; // binding = 2
         uint32_t texRough     = 0; // binding = 3
@@ -183,6 +430,34 @@ namespace DATA
         // descriptor set reference
         uint32_t meshID = 0; // for referencing descriptor set
         uint32_t nodeID = 0; // for referencing the node
+        uint32_t geometryID = 0; // vertex and index data in the loaded mesh list, shared by meshes with the same data
+    };
+
+    // cluster of consecutive triangles of a mesh, bounds are in mesh space
+    struct Meshlet
+    {
+        glm::vec3 center; // bounding sphere
+        float radius;
+        glm::vec3 coneAxis; // average facing of the triangles
+        float coneCutoff; // sine of the normal cone half angle, 1 if the cone cannot be culled
+        uint32_t indiceStart; // first index relative to the mesh
+        uint32_t triangleCount;
+        uint32_t vertexCount;
+        uint32_t padding;
+    };
+
+    // culling and LOD counters of the last recorded frame
+    struct DrawStatistics
+    {
+        uint32_t meshlets = 0;
+        uint32_t meshletsVisible = 0;
+        uint64_t triangles = 0; // of the full levels
+        uint64_t trianglesFrustumCulled = 0;
+        uint64_t trianglesConeCulled = 0;
+        uint64_t trianglesSubmitted = 0;
+        uint32_t meshLevels[MESH_MAX_LODS + 1] = {}; // meshes drawn at each level, 0 is the full level
+        uint32_t draws = 0; // draw calls after instancing and merging neighbouring meshlets
+        uint32_t instances = 0; // meshes drawn, one instanced draw covers several
     };
 
     struct Node
@@ -222,69 +497,194 @@ namespace DATA
             return newGraph;
         }
 
-        // create render command buffers
+        // models are parsed and decoded together and merged into one graph
+        Graph(const std::vector<GraphModel>& models, VkDevice backendDevice);
+
+        static Graph* newGraph(const std::vector<GraphModel>& models, VkDevice backendDevice)
+        {
+            Graph* newGraph = new Graph(models, backendDevice);
+            return newGraph;
+        }
+
+        // allocate render command buffers, the scene draws and the UI are recorded into secondary buffers
         void createRenderCommandBuffers();
-        // update render command buffer by id
+        void freeRenderCommandBuffers();
+        // record render command buffer by id, imageID must not be in use by the GPU
+        // the scene draws are kept unless they changed
         void updateRenderCommandBuffer(uint32_t imageID);
         // frame size change callback
         void onFrameSizeChangeStart();
         void onFrameSizeChangeEnd();
+        // frame boundary callback, imageID must not be in use by the GPU
+        // uploads streamed textures and updates the texture descriptor sets of imageID
+        void onFrameStart(uint32_t imageID);
+        // write the camera and, if they changed since the slot was last written, the node transforms into the frame slot of imageID
+        // imageID must not be in use by the GPU, the other slots are left alone
+        void updateFrameData(uint32_t imageID);
 
     private:
         // process input meshes
         void convertInputMeshes(std::vector<GraphUserInput>& meshes);
-        // create uniform buffers for each mesh
+        // merge meshes with identical vertices and indices (GRAPH_DEDUPLICATE_GEOMETRY) and log the memory saved
+        // meshes is compacted to the unique data and geometryID of d_meshes is remapped to it
+        void deduplicateGeometry(std::vector<GraphUserInput>& meshes);
+        // lay out vertex ranges of the unique data back to back and copy them to every mesh using it
+        void layoutMeshes(const std::vector<GraphUserInput>& meshes);
+        // weld (GRAPH_WELD_MESHES) and reorder (GRAPH_OPTIMIZE_MESHES) indices and vertices of every mesh
+        // vertex and indice ranges of d_meshes are laid out again for the new counts
+        void optimizeMeshes(std::vector<GraphUserInput>& meshes);
+        // split meshes into meshlets for culling if GRAPH_CULL_MESHLETS is set
+        void createMeshlets(const std::vector<GraphUserInput>& meshes);
+        // simplify meshes into LOD chains if GRAPH_GENERATE_LODS is set, also finds mesh bounds
+        // LOD indices are appended to the indices of their mesh
+        void createMeshLods(std::vector<GraphUserInput>& meshes);
+        // group meshes with the same geometry and material into batches drawn with instancing (GRAPH_INSTANCE_MESHES)
+        void createInstanceBatches();
+        // pick the LOD of every mesh and cull meshlets against the current camera, collects the index ranges left to draw
+        // meshes of batches with several instances are culled as a whole, so instances at the same level can share a draw
+        void prepareMeshDraws();
+        // record draws of all meshes into a command buffer inside the render pass
+        void recordMeshDraws(VkCommandBuffer commandBuffer, uint32_t imageID);
+        // create the persistently mapped frame buffer, one slot of camera, node transforms and instances per swap chain image
         void createUniformBuffers();
-        // create descriptor set related variables
+        // mapped address of offset in the frame slot of imageID
+        unsigned char* frameData(uint32_t imageID, VkDeviceSize offset);
+        // make host writes to a range of the frame slot of imageID visible, only does work for non-coherent memory
+        void flushFrameData(uint32_t imageID, VkDeviceSize offset, VkDeviceSize size);
+        // group meshes with the same textures into materials sharing texture descriptor sets
+        void createMaterials();
+        // create descriptor set related variables, set 0 per frame and set 1 per material
         void createDescriptorSets();
+        // rewrite texture bindings of all material descriptor sets for a swap chain image
+        void updateTextureDescriptorSets(uint32_t imageID);
+        // get texture by slot, textures still streaming fall back to the empty texture
+        const Texture& findTexture(uint32_t textureID);
+        // upload decoded streamed textures, returns true if any texture changed
+        bool uploadStreamedTextures();
         // vertex buffers
         void createVertexBuffers(std::vector<GraphUserInput>& meshes);
+        // pack all vertices in d_vertex_format into dst, also fills the dequantization of d_mesh_constants
+        void writeVertexBuffer(const std::vector<GraphUserInput>& meshes, unsigned char* dst);
         // indice buffers
         void createIndiceBuffers(std::vector<GraphUserInput>& meshes);
+        // pick index type and region of every mesh, returns total size of the indice buffer in bytes
+        VkDeviceSize layoutIndiceBuffer(const std::vector<GraphUserInput>& meshes);
+        // same as above from the (vertex, indice) counts of every geometry
+        VkDeviceSize layoutIndiceBuffer(const std::vector<glm::uvec2>& geometryCounts);
+        // lay out vertices and indices of every geometry and stage one mapped region for them (GRAPH_STREAM_GEOMETRY)
+        void beginGeometryStaging(const std::vector<glm::uvec2>& geometryCounts, GeometryStaging& staging);
+        // merge staged geometries with equal hashes and bytes (GRAPH_DEDUPLICATE_GEOMETRY) and log the memory saved
+        // geometryID of d_meshes is remapped and the buffers are laid out for the unique geometries only
+        void deduplicateStagedGeometry(GeometryStaging& staging, const std::vector<uint64_t>& hashes);
+        // record copies of the staged geometry into the vertex and indice buffers
+        void endGeometryStaging(GeometryStaging& staging);
+        // write the indice buffer laid out by layoutIndiceBuffer into dst
+        void writeIndiceBuffer(const std::vector<GraphUserInput>& meshes, unsigned char* dst);
+        // bind the indice region of type for drawing
+        void bindIndiceBuffer(VkCommandBuffer commandBuffer, VkIndexType type);
         // create textures from image paths
         void createTexturesFromPaths(const std::set<std::string> paths);
         // create buffer helper function
         Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+        // create device local buffer filled with data
+        Buffer createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
         // create texture image helper function
+        // if levels covers all mip levels they are copied from the staging buffer, else they are blitted from level 0
+        // levelOffsets are relative to stagingOffset
         Image createTextureImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat imageFormat,
-            VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer stagingBuffer);
+            VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer stagingBuffer, VkDeviceSize stagingOffset,
+            uint32_t levels = 1, const VkDeviceSize* levelOffsets = nullptr);
+        // create texture with sampler from CPU data, pixels holds all levels of texture
+        Texture createTextureFromData(const TextureData& texture, const unsigned char* pixels);
         // create mipmaps for texture image
         void createTextureImageMipmaps(VkImage& image, VkFormat imageFormat, int32_t width, int32_t height, uint32_t mipLevels);
         // transition texture image layout
         void transitionTextureImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-        // copy buffer to image helper function
-        void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+        // copy buffer to image helper function, copies levels mip levels at bufferOffset + levelOffsets
+        void copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height,
+            uint32_t levels = 1, const VkDeviceSize* levelOffsets = nullptr);
         // copy buffer to buffer helper function
-        void copyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        // initialize an empty texture
+        void copyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0);
+        // same as above for several regions, srcOffset is added to the source offset of every region
+        void copyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions, VkDeviceSize srcOffset);
+        // create the upload queue all buffer and texture uploads of the graph are recorded into
+        void initUploads();
+        // initialize an empty texture and the texture target of the device
         void initTextures();
+        // texture memory uploaded so far against the same textures uncompressed, for logs
+        std::string describeTextureMemory();
+        // get the cached sampler for params, created on first use
+        VkSampler findSampler(const SamplerParams& params);
 
         // model loading related functions
-        // load model type gltf
-        std::vector<GraphUserInput> loadModelGLTF(const std::string modelPath, bool binary);
+        // load gltf models into one graph, also returns decoded textures and the files the models depend on
+        // with staging the vertex and indice buffers are created from the decoded primitives and no meshes are returned
+        std::vector<GraphUserInput> loadModelGLTF(const std::vector<GraphModel>& models,
+            std::vector<TextureData>& textures, std::vector<std::string>& dependencies, GeometryStaging* staging = nullptr);
+        // load cooked scene cache, returns false if missing or outdated
+        bool loadSceneCache(const std::string cachePath);
+        // pack meshes into the bytes of the vertex and indice buffers, as stored by the scene cache
+        void packSceneGeometry(const std::vector<GraphUserInput>& meshes, std::vector<unsigned char>& vertexBlob,
+            std::vector<unsigned char>& indiceBlob);
+        // write cooked scene cache after buffers are created, the blobs hold the bytes of the vertex and indice buffers
+        void saveSceneCache(const std::string cachePath, const std::vector<unsigned char>& vertexBlob,
+            const std::vector<unsigned char>& indiceBlob, const std::vector<TextureData>& textures,
+            const std::vector<std::string>& dependencies);
 
     public:
         std::vector<Node*> d_nodes;
         std::vector<Mesh*> d_meshes;
         std::vector<MeshConstantData> d_mesh_constants; // size of d_meshes
-        std::vector<std::vector<Buffer>> d_node_uniform_buffers; // size of d_nodes * swap chain images
-        bool d_node_uniform_buffers_need_update = true;
+        uint64_t d_node_transform_version = 1; // bump after changing node transforms, frame slots are rewritten when they are next drawn
+        std::vector<std::array<uint32_t, 5>> d_material_textures; // texture slots (base, rough, normal, occlusion, emissive) per material
+        std::vector<uint32_t> d_mesh_materials; // per mesh, index into d_material_textures
 
         std::vector<Texture> d_unique_textures;
+        std::map<SamplerParams, VkSampler> d_samplers; // shared by d_unique_textures
+        TextureTarget d_texture_target;
+        VkDeviceSize d_texture_bytes = 0; // uploaded texture data
+        VkDeviceSize d_texture_bytes_uncompressed = 0; // same textures as RGBA with full mip chains
+        std::shared_ptr<TextureStream> p_texture_stream; // null when nothing is streaming
+        uint64_t d_texture_version = 0; // bumped whenever a texture slot is filled
+        std::vector<uint64_t> d_descriptor_texture_version; // size of swap chain images
+        std::chrono::steady_clock::time_point d_time_created;
+        bool d_first_frame_started = false;
 
-        std::vector<Buffer> d_ubo_buffers; // size of swap chain images
         CameraUniform d_ubo_data;
-        
-        VkDescriptorSetLayout d_descriptor_layout;
-        VkDescriptorPool d_descriptor_pool;
-        std::vector<std::vector<VkDescriptorSet>> d_descriptor_per_mesh;
-        std::vector<VkDescriptorSet> d_descriptor_ubo; // size of swap chain images
 
-        Buffer d_vertex_buffer; // all vertex data
-        Buffer d_indice_buffer; // all indice data
+        // frame slots are laid out back to back, each one sub-allocated linearly in this order
+        Buffer d_frame_buffer; // mapped for its whole lifetime
+        VkDeviceSize d_frame_slot_size = 0;
+        VkDeviceSize d_frame_camera_offset = 0; // CameraUniform (binding = 0)
+        VkDeviceSize d_frame_transform_offset = 0; // NodeTransformData of every node (binding = 1)
+        VkDeviceSize d_frame_instance_offset = 0; // InstanceData of the meshes drawn (binding = 7)
+        std::vector<uint64_t> d_frame_transform_version; // d_node_transform_version last written per slot
+        
+        VkDescriptorSetLayout d_descriptor_layout = VK_NULL_HANDLE; // set 0, camera, transforms and instances
+        VkDescriptorSetLayout d_material_layout = VK_NULL_HANDLE; // set 1, textures
+        VkDescriptorPool d_descriptor_pool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> d_descriptor_frame; // size of swap chain images
+        std::vector<std::vector<VkDescriptorSet>> d_descriptor_per_material; // size of materials * swap chain images
+
+        Buffer d_vertex_buffer; // all vertex data, packed in d_vertex_format
+        VertexFormats d_vertex_format = VERTEX_FORMAT_FULL;
+        Buffer d_indice_buffer; // all indice data, 16 bit region followed by 32 bit region
+        VkDeviceSize d_indice_offset_32 = 0; // byte offset of the 32 bit region
         uint32_t d_indice_count = 0;
 
-        std::vector<VkCommandBuffer> d_commands;
+        std::vector<Meshlet> d_meshlets;
+        bool d_dynamic_draws = false; // draw commands depend on the camera, visible meshes are culled while recording
+        std::vector<glm::uvec2> d_draw_ranges; // index ranges (start, count) to draw relative to their mesh
+        std::vector<glm::uvec2> d_mesh_draw_ranges; // per mesh range (start, count) in d_draw_ranges
+        std::vector<uint32_t> d_mesh_batches; // per mesh, first mesh with the same geometry and material
+        std::vector<uint32_t> d_batch_sizes; // per mesh, number of meshes in the batch it starts
+
+        std::vector<VkCommandBuffer> d_commands; // primary, executes the scene and UI buffers of the image
+        std::vector<VkCommandBuffer> d_scene_commands;
+        std::vector<VkCommandBuffer> d_ui_commands;
+        std::vector<uint64_t> d_scene_commands_version; // d_descriptor_texture_version the scene draws were recorded with
+
+        UploadQueue* p_uploads = nullptr; // copies, transitions and mip blits, submitted together
 
     private:
         VkDevice d_device;
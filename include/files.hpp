@@ -1,6 +1,6 @@
 // File Description
 // A file system helper
-// read, write files
+// read, write, map and hash files
 
 #pragma once
 
@@ -9,6 +9,14 @@
 #include <sstream>
 #include <fstream>
 #include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace UTILS
+{
+    class ThreadPool;
+}
 
 namespace FILES
 {
@@ -37,21 +45,18 @@ namespace FILES
     static std::string read_string_from_file(std::string& filePath)
     {
         std::string path = std::string(GLOB_FILE_FOLDER) + "/" + filePath;
-        std::ifstream inFile(path.c_str(), std::ios::binary);
+        std::ifstream inFile(path.c_str(), std::ios::ate | std::ios::binary);
         if(!inFile.is_open())
         {
             std::string message = "failed to open file for reading: " + path;
             throw std::runtime_error(message);
         }
-        std::stringstream data;
-        char chr = inFile.get();
-        while(inFile.good())
-        {
-            data << chr;
-            chr = inFile.get();
-        }
+        // one read of the whole file
+        std::string data(static_cast<size_t>(inFile.tellg()), '\0');
+        inFile.seekg(0);
+        if(!data.empty()) inFile.read(&data[0], data.size());
         inFile.close();
-        return data.str();
+        return data;
     }
 
     // read bytes from a file
@@ -83,4 +88,137 @@ namespace FILES
         std::string ext = filePath.substr(idx+1);
         return ext;
     }
-}
\ No newline at end of file
+
+    // get folder part of a file path (empty if none)
+    static std::string get_file_folder(const std::string filePath)
+    {
+        std::size_t idx = filePath.find_last_of("/\\");
+        if(idx == std::string::npos)
+            return "";
+        return filePath.substr(0, idx);
+    }
+
+    // fast non-cryptographic 64 bit hash of a byte range
+    static uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0)
+    {
+        const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+        const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+        const uint64_t prime3 = 0x165667B19E3779F9ULL;
+        auto rotl = [](uint64_t x, int r){return (x << r) | (x >> (64 - r));};
+        auto round = [&](uint64_t acc, uint64_t v){return rotl(acc + v * prime2, 31) * prime1;};
+
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+        uint64_t h;
+        if(size >= 32)
+        {
+            uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+            while(end - p >= 32)
+            {
+                for(int k = 0; k < 4; k++)
+                {
+                    uint64_t v;
+                    memcpy(&v, p + k * 8, sizeof(v));
+                    lanes[k] = round(lanes[k], v);
+                }
+                p += 32;
+            }
+            h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+            for(int k = 0; k < 4; k++)
+                h = (h ^ round(0, lanes[k])) * prime1 + prime3;
+        }
+        else h = seed + prime3;
+        h += static_cast<uint64_t>(size);
+        while(end - p >= 8)
+        {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            h = rotl(h ^ round(0, v), 27) * prime1 + prime3;
+            p += 8;
+        }
+        while(p < end)
+        {
+            h = rotl(h ^ (*p * prime3), 11) * prime1;
+            p++;
+        }
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    // read-only memory mapped file
+    // the mapping stays valid until close or destruction
+    class MappedFile
+    {
+    public:
+        MappedFile(){}
+        ~MappedFile(){close();}
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // map a file relative to GLOB_FILE_FOLDER, returns false if it cannot be opened
+        bool open(const std::string& filePath);
+        // unmap the file
+        void close();
+
+        const unsigned char* data() const {return p_data;}
+        size_t size() const {return d_size;}
+        bool isOpen() const {return d_open;}
+
+    private:
+        const unsigned char* p_data = nullptr;
+        size_t d_size = 0;
+        bool d_open = false; // empty files are open but have no mapping
+        void* p_handle = nullptr;
+        void* p_mapping = nullptr;
+        int d_fd = -1;
+    };
+
+    // batch of whole file reads relative to GLOB_FILE_FOLDER
+    // on Linux the reads go through one io_uring, else (or if io_uring is unavailable) they run on the thread pool
+    // add every file, submit once, then take the results as they complete
+    // one thread drives the batch, threads waiting on the pool read files themselves instead of blocking
+    class ReadBatch
+    {
+    public:
+        ReadBatch(UTILS::ThreadPool* pool = nullptr);
+        ~ReadBatch();
+        ReadBatch(const ReadBatch&) = delete;
+        ReadBatch& operator=(const ReadBatch&) = delete;
+
+        // queue a file before submit, returns its id
+        size_t add(const std::string& filePath);
+        // start all queued reads
+        void submit();
+        // wait for the next completed read, returns false once every read was taken
+        bool next(size_t& id);
+        // wait for a given read, it is not returned by next afterwards
+        void wait(size_t id);
+        // find the id of a queued file, returns false if it is not in the batch
+        bool find(const std::string& filePath, size_t& id) const;
+
+        size_t size() const;
+        const std::string& path(size_t id) const;
+        // false if the file could not be read, only valid once the read completed
+        bool failed(size_t id) const;
+        // bytes of a completed read, can be moved out
+        std::vector<unsigned char>& data(size_t id);
+        // true if the reads went through io_uring
+        bool usesIOUring() const {return p_ring != nullptr;}
+
+        // requests and completion queue, defined in files.cpp
+        struct State;
+
+    private:
+        // wait until at least one more read completed
+        void waitAny();
+
+    private:
+        std::shared_ptr<State> p_state; // shared with the pool tasks, which may start after the batch is gone
+        UTILS::ThreadPool* p_pool = nullptr;
+        void* p_ring = nullptr;
+    };
+}
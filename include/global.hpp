@@ -8,6 +8,7 @@
 #include "camera.hpp"
 #include "ui.hpp"
 #include "logging.hpp"
+#include "threads.hpp"
 
 #define APP_EXIT_SUCCESS    0
 #define APP_EXIT_FAILURE    1
@@ -41,12 +42,16 @@ public:
         if(p_backend)
             delete p_backend;
         p_backend = nullptr;
+        if(p_thread_pool)
+            delete p_thread_pool;
+        p_thread_pool = nullptr;
     }
 
     void StartCamera(){p_camera = new UTILS::Camera(CAMERA_INIT_POS, CAMERA_INIT_UP);}
     void StartBackend(){p_backend = new BASE::Backend();}
     void StartRenderer(){p_renderer = new BASE::Renderer();}
     void StartUI(){p_ui = new UTILS::UI();}
+    void StartThreadPool(){p_thread_pool = new UTILS::ThreadPool(THREAD_POOL_SIZE);}
     void LoadGraph(){if(p_renderer) p_renderer->CreateGraph();}
     void Loop(USER_UPDATE user_func){if(p_renderer) p_renderer->loop(user_func);}
 
@@ -55,6 +60,7 @@ public:
     BASE::Renderer* GetRenderer(){return p_renderer;}
     UTILS::Camera* GetCamera(){return p_camera;}
     UTILS::UI* GetUI(){return p_ui;}
+    UTILS::ThreadPool* GetThreadPool(){return p_thread_pool;}
 
 public:
     // parameters for Backend
@@ -63,16 +69,36 @@ public:
     std::string WINDOW_TITLE = "Hello World";
     bool WINDOW_RESIZABLE = false;
     bool BACKEND_ENABLE_VALIDATION = true;
+    size_t BACKEND_MEMORY_BLOCK_SIZE = 64 << 20; // bytes of the device memory blocks buffers and images are sub-allocated from
+    bool BACKEND_ENABLE_TRANSFER_QUEUE = false; // upload on a transfer-only queue family if the device has one, else on the graphics queue, the ownership transfers are not yet validated on such a device
 
     // parameters for renderer creating a graph
     double RENDER_MAX_FPS = 144.0f;
     double RENDER_CURRENT_FPS = 0.0f;
+    DATA::DrawStatistics RENDER_DRAW_STATISTICS; // of the last recorded frame
     glm::vec4 RENDER_CLEAR_VALUES = {1.0f, 1.0f, 1.0f, 1.0f};
     bool RENDER_ENABLE_DEPTH = true;
     bool RENDER_ENABLE_MSAA = false;
     std::vector<DATA::GraphUserInput> GRAPH_MESHES;
     DATA::ShaderSourceDetails GRAPH_SHADER_DETAILS;
     std::string GRAPH_MODEL_PATH = "";
+    bool GRAPH_MAP_GLB = true; // map .glb files and read their BIN chunk in place, else tinygltf copies the whole file
+    std::vector<DATA::GraphModel> GRAPH_MODELS; // composed into one graph instead of GRAPH_MODEL_PATH if set
+    DATA::VertexFormats GRAPH_VERTEX_FORMAT = DATA::VERTEX_FORMAT_FULL; // compact formats need the compact vertex shader
+    bool GRAPH_DEDUPLICATE_GEOMETRY = true; // share one copy of meshes with identical vertices and indices, glTF instances always share
+    bool GRAPH_WELD_MESHES = false; // merge duplicated vertices of loaded meshes, non-indexed meshes become indexed, hashes every vertex at load and exported glTF meshes are mostly welded already
+    float GRAPH_WELD_EPSILON = 0.0f; // 0 only merges bit-identical vertices, else attributes closer than this are merged
+    bool GRAPH_OPTIMIZE_MESHES = false; // reorder triangles and vertices of loaded meshes for the vertex cache and overdraw, costs load time and drops the source order, see bench/mesh_bench.cpp
+    bool GRAPH_CULL_MESHLETS = false; // split meshes into meshlets culled by frustum and normal cone every frame, the scene draws are then recorded every frame on the CPU
+    bool GRAPH_INSTANCE_MESHES = true; // draw meshes sharing geometry and material with one instanced draw
+    bool GRAPH_GENERATE_LODS = false; // simplify meshes into LOD chains picked by screen space error every frame, slow to build and almost doubles the indice memory
+    float GRAPH_LOD_BIAS = 1.0f; // screen space error in pixels allowed for a LOD, higher picks coarser levels
+    bool GRAPH_ENABLE_SCENE_CACHE = false; // cook models into a .wcache file next to them, writes into the asset folder
+    bool GRAPH_STREAM_GEOMETRY = true; // decode glTF geometry straight into mapped staging memory, deduplication and the scene cache work on the staged bytes, only takes effect with GRAPH_WELD_MESHES, GRAPH_OPTIMIZE_MESHES, GRAPH_CULL_MESHLETS and GRAPH_GENERATE_LODS off
+    bool GRAPH_COMPRESS_TEXTURES = false; // lossily encode 8 bit color textures into BC1/BC3 with CPU mip chains, if the device samples them, normal, metallic roughness and occlusion maps are kept
+    bool GRAPH_STREAM_TEXTURES = true; // draw with placeholder textures while model textures are decoded
+    size_t GRAPH_STREAM_UPLOADS_PER_FRAME = 4; // max streamed textures uploaded at one frame boundary
+    size_t GRAPH_UPLOAD_RING_SIZE = 64 << 20; // bytes of the mapped staging ring all graph uploads go through, larger data gets its own buffer
 
     // parameters for setting camera
     glm::vec3 CAMERA_INIT_POS = glm::vec3(2.0f, 2.0f, 2.0f);
@@ -84,6 +110,9 @@ public:
     std::string LOGGER_PATH = "world.log";
     bool LOGGER_SAVE_LOG = false;
 
+    // parameters for worker threads (0 = hardware concurrency)
+    size_t THREAD_POOL_SIZE = 0;
+
 private:
 #ifdef IGNORE_LOGGING
     const bool _enable_logger = false;
@@ -96,4 +125,5 @@ private:
     BASE::Renderer* p_renderer = nullptr;
     UTILS::Camera* p_camera = nullptr;
     UTILS::UI* p_ui = nullptr;
+    UTILS::ThreadPool* p_thread_pool = nullptr;
 };
\ No newline at end of file
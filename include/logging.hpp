@@ -5,6 +5,7 @@
 
 #include <deque>
 #include <string>
+#include <cstddef>
 
 namespace LOGGING
 {
@@ -27,6 +28,11 @@ namespace LOGGING
         std::string time;
     };
 
+    // get peak resident memory of the process in bytes, 0 if unknown
+    size_t getPeakMemoryUsage();
+    // get current resident memory of the process in bytes, 0 if unknown
+    size_t getMemoryUsage();
+
     // a runtime logger
     class Logger
     {
@@ -0,0 +1,113 @@
+// File Description
+// device memory sub-allocator
+// buffers and images are placed in large blocks instead of one vkAllocateMemory each
+// small ranges come from size class free lists, larger ones from buddy allocators, huge ones get their own allocation
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+namespace DATA
+{
+    class MemoryAllocator;
+
+    // range of device memory bound to one buffer or image
+    struct MemoryAllocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0; // reserved, at least the requested size
+        unsigned char* mapped = nullptr; // host visible memory is mapped for its whole lifetime, points at offset
+        MemoryAllocator* allocator = nullptr; // null once freed
+        uint32_t pool = 0;
+        uint32_t block = 0;
+        uint32_t order = 0; // log2 of the reserved size, 0 for dedicated allocations
+
+        // give the range back to its allocator
+        void free();
+    };
+
+    class MemoryAllocator
+    {
+    public:
+        // blockSize is rounded down to a power of 2 and shrunk for small heaps
+        MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize);
+        // every allocation has to be freed before
+        ~MemoryAllocator();
+
+        // allocate memory for requirements of a buffer (linear) or an optimal tiling image
+        // dedicated forces an own vkAllocateMemory, resources larger than half a block always get one
+        // thread safe
+        MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated = false);
+        // thread safe
+        void free(MemoryAllocation& allocation);
+        // flush a written range of a mapped allocation, only does work for non-coherent memory
+        // the range is widened to nonCoherentAtomSize, allocations never share an atom
+        void flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+        // statistics of every memory type in use, one line each, for logs
+        std::vector<std::string> describe();
+
+    private:
+        // block of device memory, split by a buddy allocator
+        struct Block
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE; // null when released
+            unsigned char* mapped = nullptr;
+            std::vector<std::set<VkDeviceSize>> freeRanges; // offsets of free ranges per order above MIN_BUDDY_ORDER
+            VkDeviceSize used = 0;
+        };
+
+        // blocks of one memory type holding either linear or optimal resources
+        struct Pool
+        {
+            uint32_t memoryType = 0;
+            uint32_t blockOrder = 0; // log2 of the block size
+            std::vector<Block> blocks;
+            // free slots (block, offset) and used slots per slab (block, offset) of every size class
+            std::vector<std::set<std::pair<uint32_t, VkDeviceSize>>> freeSlots;
+            std::map<std::pair<uint32_t, VkDeviceSize>, uint32_t> slabUsed;
+        };
+
+        // statistics of one memory type
+        struct TypeStatistics
+        {
+            uint64_t blocks = 0;
+            uint64_t blockBytes = 0;
+            uint64_t dedicated = 0;
+            uint64_t dedicatedBytes = 0;
+            uint64_t allocations = 0; // live allocations, dedicated ones included
+            uint64_t reservedBytes = 0; // by the live sub-allocations, rounded to their class or order
+        };
+
+        // find the memory type as Backend::findDeviceMemoryType does
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        // call vkAllocateMemory and map host visible memory, counts against maxMemoryAllocationCount
+        VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, unsigned char** mapped);
+        void freeDeviceMemory(VkDeviceMemory memory);
+        // take a range of 2^order bytes from the buddy allocators of pool, adds a block if none fits
+        void allocateRange(Pool& pool, uint32_t order, uint32_t& block, VkDeviceSize& offset);
+        // give a range back and merge it with its free buddies, empty blocks beyond the first are released
+        void freeRange(Pool& pool, uint32_t block, VkDeviceSize offset, uint32_t order);
+
+    private:
+        static const uint32_t MIN_CLASS_ORDER = 8; // 256 bytes
+        static const uint32_t MIN_BUDDY_ORDER = 16; // 64 KB, also the slab size classes are carved from
+
+        VkDevice d_device;
+        VkPhysicalDeviceMemoryProperties d_memory_properties;
+        VkDeviceSize d_buffer_image_granularity;
+        VkDeviceSize d_non_coherent_atom_size;
+        uint32_t d_max_allocations;
+        std::vector<Pool> d_pools; // two per memory type, linear and optimal, shared if the granularity allows
+        std::vector<TypeStatistics> d_statistics; // per memory type
+        uint32_t d_device_allocations = 0; // live vkAllocateMemory calls
+        std::mutex d_mutex;
+    };
+}
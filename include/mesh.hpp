@@ -0,0 +1,87 @@
+// File Description
+// load time mesh optimization passes on local triangle lists
+// vertex welding of duplicated vertices
+// vertex cache (Tipsify), overdraw and vertex fetch reordering
+// and post-transform vertex cache analysis
+// meshlet partitioning with bounding spheres and normal cones
+// quadric error edge collapse simplification for LOD chains
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "data.hpp"
+
+namespace DATA
+{
+    // FIFO cache size used by the optimizer and the analysis
+    const size_t MESH_VERTEX_CACHE_SIZE = 16;
+    // meshlet limits, same as common mesh shader limits
+    const size_t MESHLET_MAX_VERTICES = 64;
+    const size_t MESHLET_MAX_TRIANGLES = 124;
+    // meshes with fewer triangles are not simplified further
+    const size_t MESH_LOD_MIN_TRIANGLES = 128;
+    // largest simplification error allowed for a LOD, relative to the bounding radius of the mesh
+    const float MESH_LOD_MAX_ERROR = 0.1f;
+
+    // simulated post-transform cache results
+    struct VertexCacheStatistics
+    {
+        size_t triangles = 0;
+        size_t vertices = 0; // vertices of the mesh, referenced or not
+        size_t transformed = 0; // cache misses
+        // average cache miss ratio, transformed vertices per triangle (0.5 is ideal for big grids, 3 is worst)
+        float acmr() const { return triangles ? (float)transformed / (float)triangles : 0.0f; }
+        // average transform to vertex ratio (1 is ideal)
+        float atvr() const { return vertices ? (float)transformed / (float)vertices : 0.0f; }
+        void add(const VertexCacheStatistics& other)
+        {
+            triangles += other.triangles;
+            vertices += other.vertices;
+            transformed += other.transformed;
+        }
+    };
+
+    // merge vertices whose attributes are all equal into one and rewrite indices to match
+    // non-indexed meshes get an index buffer, epsilon 0 only merges bit-identical vertices
+    // otherwise attributes are snapped to a grid of epsilon before they are compared
+    // returns the number of vertices removed
+    size_t weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float epsilon = 0.0f);
+
+    // simulate a FIFO post-transform cache over a triangle list
+    VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+        size_t cacheSize = MESH_VERTEX_CACHE_SIZE);
+    // reorder triangles for post-transform cache locality (Tipsify, Sander et al. 2007)
+    void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize = MESH_VERTEX_CACHE_SIZE);
+    // reorder clusters of a cache optimized triangle list so outward facing ones are drawn first
+    // clusters are only split where the ACMR of the result stays below threshold times the input ACMR
+    void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f,
+        size_t cacheSize = MESH_VERTEX_CACHE_SIZE);
+    // reorder vertices in first use order and remap indices, unreferenced vertices are kept at the end
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+    // run all passes above on a triangle list mesh, meshes without indices are left alone
+    // statistics before and after are returned if not null
+    void optimizeMesh(GraphUserInput& mesh, VertexCacheStatistics* before = nullptr, VertexCacheStatistics* after = nullptr);
+
+    // split a triangle list into meshlets of consecutive triangles and append them to meshlets
+    // indices are not changed, so they should already be in a cache friendly order
+    void buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, std::vector<Meshlet>& meshlets,
+        size_t maxVertices = MESHLET_MAX_VERTICES, size_t maxTriangles = MESHLET_MAX_TRIANGLES);
+    // find bounding sphere and normal cone of the count triangles in indices
+    void findMeshletBounds(const uint32_t* indices, size_t count, const std::vector<Vertex>& vertices, Meshlet& meshlet);
+
+    // simplify a triangle list towards targetIndexCount by collapsing vertices onto their neighbours
+    // only existing vertices are referenced, so result can share the vertex data of the input
+    // vertices on borders and attribute seams are kept in place, collapses above maxError are not done
+    // returns the error of the result in mesh space units
+    float simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount,
+        float maxError, std::vector<uint32_t>& result);
+    // build up to maxLods simplified levels, each one about half of the previous one
+    // errors are accumulated over the chain and are in mesh space units
+    void generateMeshLods(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t maxLods,
+        std::vector<std::vector<uint32_t>>& lods, std::vector<float>& errors);
+    // find bounding sphere of all vertices
+    void findMeshBounds(const std::vector<Vertex>& vertices, glm::vec3& center, float& radius);
+}
@@ -0,0 +1,43 @@
+// File Description
+// decoder of the meshoptimizer buffer codecs used by EXT_meshopt_compression
+// attribute, triangle and index sequence modes and the octahedral, quaternion and exponential filters
+// delta decoding and filters have SSE2 paths, scalar path is the fallback
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DATA
+{
+    // compression mode of a buffer view
+    enum MeshoptModes
+    {
+        MESHOPT_MODE_ATTRIBUTES,
+        MESHOPT_MODE_TRIANGLES,
+        MESHOPT_MODE_INDICES,
+    };
+
+    // filter applied after decoding attributes
+    enum MeshoptFilters
+    {
+        MESHOPT_FILTER_NONE,
+        MESHOPT_FILTER_OCTAHEDRAL,  // int8 or int16 normals and tangents
+        MESHOPT_FILTER_QUATERNION,  // int16 rotations
+        MESHOPT_FILTER_EXPONENTIAL, // 32 bit floats with shared exponents
+    };
+
+    // decode count elements of stride bytes, stride has to be a multiple of 4 up to 256 for attributes
+    // and 2 or 4 for indices, filters are only used by attributes
+    // returns false if the data is malformed
+    bool decodeMeshoptBuffer(unsigned char* dst, size_t count, size_t stride, const unsigned char* src, size_t size,
+        MeshoptModes mode, MeshoptFilters filter);
+    // decode attribute data, every byte of the vertex is delta coded against the previous vertex
+    bool decodeMeshoptVertices(unsigned char* dst, size_t count, size_t stride, const unsigned char* src, size_t size);
+    // decode a triangle list, count is the number of indices
+    bool decodeMeshoptTriangles(unsigned char* dst, size_t count, size_t indexSize, const unsigned char* src, size_t size);
+    // decode an index sequence that is not a triangle list
+    bool decodeMeshoptIndices(unsigned char* dst, size_t count, size_t indexSize, const unsigned char* src, size_t size);
+    // undo a filter in place on count elements of stride bytes
+    void decodeMeshoptFilter(unsigned char* data, size_t count, size_t stride, MeshoptFilters filter);
+}
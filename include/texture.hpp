@@ -0,0 +1,47 @@
+// File Description
+// CPU side texture helpers
+// image decoding, format sizes, mip chain layout and box filtered mipmaps
+// KTX2 containers and BC1/BC3 block compression for upload
+
+#pragma once
+
+#include <string>
+
+#include "data.hpp"
+
+namespace DATA
+{
+    // decode an encoded image (png, jpg, ...) into RGBA, 16 bit images stay 16 bit
+    // KTX2 images keep their format and mip levels
+    // thread safe, returns false and fills error on failure
+    bool decodeTextureData(const unsigned char* bytes, size_t size, TextureData& texture, std::string& error);
+    // load and decode an image file relative to GLOB_FILE_FOLDER into 8 bit RGBA, .ktx2 files are read as KTX2
+    // thread safe, returns false and fills error on failure
+    bool loadTextureData(const std::string path, TextureData& texture, std::string& error);
+    // check for the KTX2 file identifier
+    bool isKTX2Data(const unsigned char* bytes, size_t size);
+    // read the levels of a 2D KTX2 image without supercompression
+    // supercompressed and Basis Universal payloads need a transcoder and are rejected
+    bool decodeKTX2TextureData(const unsigned char* bytes, size_t size, TextureData& texture, std::string& error);
+    // get full mip chain length for an image size
+    uint32_t getTextureMipLevels(uint32_t width, uint32_t height);
+    // get block compressed formats textures can be loaded in
+    std::vector<VkFormat> getTextureBlockFormats();
+    // check if format stores 4x4 blocks
+    bool isTextureFormatCompressed(VkFormat format);
+    // get bytes per pixel of an uncompressed texture format
+    size_t getTextureFormatPixelSize(VkFormat format);
+    // get size of one mip level in bytes
+    VkDeviceSize getTextureLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level);
+    // get size of the first levels of a mip chain in bytes
+    VkDeviceSize getTextureSize(VkFormat format, uint32_t width, uint32_t height, uint32_t levels);
+    // fill in the full mip chain on the CPU with a 2x2 box filter (sRGB aware)
+    void generateTextureMipmaps(TextureData& texture);
+    // encode all levels of an 8 bit RGBA texture into a BC1 or BC3 format
+    void compressTextureData(TextureData& texture, VkFormat format);
+    // decode all levels of a BC1, BC3, BC4 or BC5 texture into 8 bit RGBA, returns false for other formats
+    bool decompressTextureData(TextureData& texture);
+    // get the mip chain and format ready for upload as target asks
+    // block formats the device cannot sample are decoded, throws if that is not possible
+    void prepareTextureData(TextureData& texture, const TextureTarget& target);
+}
@@ -0,0 +1,47 @@
+// File Description
+// a simple worker thread pool
+// used to spread loading work (decoding, parsing) across cores
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace UTILS
+{
+    class ThreadPool
+    {
+    public:
+        // threadCount = 0 means use hardware concurrency
+        ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+
+        // push a task into the queue, returns future to wait on
+        std::future<void> submit(std::function<void()> task);
+        // run func(i) for every i in [0, count), calling thread also takes part
+        // exceptions from func are rethrown on the calling thread
+        void parallelFor(size_t count, const std::function<void(size_t)>& func);
+        // run work(i) for every i in [0, count) on the workers, and consume(i) on the
+        // calling thread as soon as work(i) is done, in completion order
+        // after the first exception the remaining items are skipped, it is rethrown when all workers are done
+        void parallelPipeline(size_t count, const std::function<void(size_t)>& work, const std::function<void(size_t)>& consume);
+        // get number of worker threads
+        size_t size(){return d_workers.size();}
+
+    private:
+        // worker thread main loop
+        void workerLoop();
+
+    private:
+        std::vector<std::thread> d_workers;
+        std::deque<std::function<void()>> d_tasks;
+        std::mutex d_mutex;
+        std::condition_variable d_condition;
+        bool d_stop = false;
+    };
+}
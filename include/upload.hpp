@@ -0,0 +1,101 @@
+// File Description
+// batched uploads to device local buffers and images
+// staging data goes through one persistently mapped ring buffer
+// copies, layout transitions and mip blits are recorded into one command buffer and submitted together
+// with a separate transfer queue family the copies run there and are handed to the graphics queue by ownership transfer
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+
+#include "data.hpp"
+
+namespace DATA
+{
+    class UploadQueue
+    {
+    public:
+        // ring of ringSize bytes in host visible memory, commands are submitted to graphicsQueue of family graphicsFamilyID
+        // copies go to transferQueue if it is not null and of another family, else everything runs on graphicsQueue
+        UploadQueue(VkDevice device, VkQueue graphicsQueue, uint32_t graphicsFamilyID, VkQueue transferQueue, uint32_t transferFamilyID,
+            VkDeviceSize ringSize);
+        // waits for every submitted upload
+        ~UploadQueue();
+
+        // reserve size bytes of staging memory aligned to alignment (power of 2) and return where to write them
+        // buffer and offset are the source of the copy, valid until the commands recorded next have executed
+        // blocks while the ring is full, data larger than a quarter of the ring gets its own staging buffer
+        unsigned char* stage(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& buffer, VkDeviceSize& offset);
+        // get the command buffer copies and transitions to TRANSFER_DST_OPTIMAL are recorded into, begun on first use after a submit
+        // runs on the transfer queue if there is one, every call counts as one recorded upload for the statistics
+        VkCommandBuffer record();
+        // get the command buffer for work the transfer queue cannot do (mip blits, transitions for sampling)
+        // runs on the graphics queue after the copies of the same batch, the same as record() without a transfer queue
+        VkCommandBuffer recordGraphics();
+        // hand a buffer written by record() to the graphics queue for vertex, index, uniform or shader reads
+        void transferBuffer(VkBuffer buffer);
+        // hand all levels of an image written by record() in TRANSFER_DST_OPTIMAL to the graphics queue and transition them to layout
+        // SHADER_READ_ONLY_OPTIMAL for sampling, TRANSFER_DST_OPTIMAL to keep working on it with recordGraphics()
+        void transferImage(VkImage image, uint32_t levels, VkImageLayout layout);
+        // destroy buffer once the uploads recorded so far have executed
+        void release(Buffer buffer);
+        // submit the recorded uploads with a fence, does not wait
+        // commands submitted later to the graphics queue see their results
+        void submit();
+        // submit and wait until every upload has executed
+        void finish();
+        // statistics of the uploads since creation, for logs
+        std::string describe();
+
+    private:
+        // batch of uploads submitted together
+        struct Batch
+        {
+            VkCommandBuffer commands = VK_NULL_HANDLE;
+            VkCommandBuffer graphicsCommands = VK_NULL_HANDLE; // same as commands without a transfer queue
+            VkFence fence = VK_NULL_HANDLE; // signaled by the graphics queue, after the copies
+            VkSemaphore copied = VK_NULL_HANDLE; // copies of the transfer queue done, only with a transfer queue
+            uint64_t ringEnd = 0; // ring head when submitted, space before it is free once fence signals
+            std::vector<Buffer> released;
+        };
+
+        // begin a batch reusing the command buffers, fence and semaphore of a finished one
+        void beginBatch();
+        // free ring space and buffers of signaled batches, waits for the oldest one if wait is set
+        // returns false if nothing is in flight
+        bool reclaim(bool wait);
+        // create a host visible staging buffer, mapped until it is destroyed
+        Buffer createStagingBuffer(VkDeviceSize size, void** mapped);
+
+    private:
+        VkDevice d_device;
+        VkQueue d_graphics_queue;
+        VkQueue d_transfer_queue; // d_graphics_queue without a separate transfer family
+        uint32_t d_graphics_family_id;
+        uint32_t d_transfer_family_id;
+        bool d_separate_transfer = false;
+        VkCommandPool d_command_pool; // of the transfer family
+        VkCommandPool d_graphics_command_pool = VK_NULL_HANDLE; // only with a transfer queue
+        Buffer d_ring;
+        unsigned char* p_ring_mapped = nullptr;
+        VkDeviceSize d_ring_size;
+        uint64_t d_ring_head = 0; // both grow without wrapping, ring offsets are taken modulo d_ring_size
+        uint64_t d_ring_tail = 0;
+        Batch d_open; // recording, commands is null until the first upload
+        std::deque<Batch> d_in_flight; // oldest first
+        std::vector<Batch> d_finished; // command buffers and fences to reuse
+
+        // statistics
+        uint64_t d_recorded = 0; // uploads recorded, one submit and wait each without batching
+        uint64_t d_submits = 0;
+        uint64_t d_waits = 0; // blocking fence waits
+        uint64_t d_staged_bytes = 0;
+        uint64_t d_dedicated = 0; // staging buffers created for data too large for the ring
+        uint64_t d_ownership_transfers = 0; // buffers and images handed from the transfer to the graphics queue
+    };
+}
@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// input of DATA::CompactVertex and DATA::QuantizedVertex
+// normal and tangent xy are octahedral encoded, tangent z is the handedness
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec4 inTangent;
+layout (location = 3) in vec2 inCoord;
+layout (location = 4) in vec4 inColor;
+
+layout (location = 0) out vec4 fragColor;
+layout (location = 1) out vec2 fragCoord;
+
+layout (binding = 0) uniform CameraUniform
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+// world transforms of all nodes
+layout (std430, binding = 1) readonly buffer TransformBuffer
+{
+	mat4 transforms[];
+} nodes;
+
+// node of each drawn instance
+layout (std430, binding = 7) readonly buffer InstanceBuffer
+{
+	uint nodeIDs[];
+} instances;
+
+layout (push_constant) uniform MeshConstants
+{
+	float hasBase;
+    float hasRough;
+    float hasNormal;
+    float hasOcclusion;
+    float hasEmissive;
+    vec4 positionOffset; // zero unless positions are quantized
+    vec4 positionScale;  // one unless positions are quantized
+} m_constants;
+
+void main()
+{
+	vec3 position = m_constants.positionOffset.xyz + m_constants.positionScale.xyz * inPosition;
+	vec4 localPos = nodes.transforms[instances.nodeIDs[gl_InstanceIndex]] * vec4(position, 1.0);
+	gl_Position = ubo.proj * ubo.view * ubo.model * localPos;
+	fragColor = inColor;
+	fragCoord = inCoord;
+}
@@ -1,4 +1,5 @@
 @ECHO OFF
 ECHO Compiling Simple Shaders
 glslc -fshader-stage=fragment simple.frag.glsl -o simple.frag.spv
-glslc -fshader-stage=vertex simple.vert.glsl -o simple.vert.spv
\ No newline at end of file
+glslc -fshader-stage=vertex simple.vert.glsl -o simple.vert.spv
+glslc -fshader-stage=vertex compact.vert.glsl -o compact.vert.spv
\ No newline at end of file
@@ -2,3 +2,4 @@
 echo Compiling Simple Shaders
 glslc -fshader-stage=fragment simple.frag.glsl -o simple.frag.spv
 glslc -fshader-stage=vertex simple.vert.glsl -o simple.vert.spv
+glslc -fshader-stage=vertex compact.vert.glsl -o compact.vert.spv
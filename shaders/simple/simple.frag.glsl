@@ -6,11 +6,12 @@ layout (location = 1) in vec2 fragCoord;
 
 layout (location = 0) out vec4 outColor;
 
-layout (binding = 2) uniform sampler2D texBase;
-layout (binding = 3) uniform sampler2D texRough;
-layout (binding = 4) uniform sampler2D texNormal;
-layout (binding = 5) uniform sampler2D texOcclusion;
-layout (binding = 6) uniform sampler2D texEmissive;
+// textures of the material, set 0 holds the per frame data
+layout (set = 1, binding = 2) uniform sampler2D texBase;
+layout (set = 1, binding = 3) uniform sampler2D texRough;
+layout (set = 1, binding = 4) uniform sampler2D texNormal;
+layout (set = 1, binding = 5) uniform sampler2D texOcclusion;
+layout (set = 1, binding = 6) uniform sampler2D texEmissive;
 
 layout (push_constant) uniform MeshConstants
 {
@@ -17,14 +17,21 @@ layout (binding = 0) uniform CameraUniform
 	mat4 proj;
 } ubo;
 
-layout (binding = 1) uniform NodeUniform
+// world transforms of all nodes
+layout (std430, binding = 1) readonly buffer TransformBuffer
 {
-	mat4 localPosition;
-} nodeData;
+	mat4 transforms[];
+} nodes;
+
+// node of each drawn instance
+layout (std430, binding = 7) readonly buffer InstanceBuffer
+{
+	uint nodeIDs[];
+} instances;
 
 void main()
 {
-	vec4 localPos = nodeData.localPosition * vec4(inPosition, 1.0);
+	vec4 localPos = nodes.transforms[instances.nodeIDs[gl_InstanceIndex]] * vec4(inPosition, 1.0);
 	gl_Position = ubo.proj * ubo.view * ubo.model * localPos;
 	fragColor = inColor;
 	fragCoord = inCoord;
@@ -191,6 +191,7 @@ Backend::~Backend()
     Renderer* myRenderer = app->GetRenderer();
     if(myRenderer)
         delete myRenderer;
+    delete p_allocator;
 
     vkDestroyDevice(d_device, nullptr);
 
@@ -327,6 +328,9 @@ void Backend::createLogicalDevice()
     VulkanQueueFamilyIndices indices = getQueueFamilies(d_physical_device);
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilyIDs = {indices.graphicsFamilyID, indices.presentFamilyID};
+    bool useTransferQueue = app->BACKEND_ENABLE_TRANSFER_QUEUE && indices.transferInit;
+    if(useTransferQueue)
+        uniqueQueueFamilyIDs.insert(indices.transferFamilyID);
 
     float queuePriority = 1.0f;
     for(uint32_t queueID : uniqueQueueFamilyIDs)
@@ -367,6 +371,15 @@ void Backend::createLogicalDevice()
 
     vkGetDeviceQueue(d_device, indices.graphicsFamilyID, 0, &d_graphics_queue);
     vkGetDeviceQueue(d_device, indices.presentFamilyID, 0, &d_present_queue);
+    if(useTransferQueue)
+    {
+        d_transfer_family_id = indices.transferFamilyID;
+        vkGetDeviceQueue(d_device, d_transfer_family_id, 0, &d_transfer_queue);
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan transfer queue family " + std::to_string(d_transfer_family_id) + " used for uploads");}
+    }
+    else if(myLogger){myLogger->AddMessage(myLoggerOwner, "no separate Vulkan transfer queue family used, uploads run on the graphics queue");}
+
+    p_allocator = new DATA::MemoryAllocator(d_device, d_physical_device, app->BACKEND_MEMORY_BLOCK_SIZE);
 }
 
 void Backend::checkInstanceExtensions(const std::vector<const char*> requiredExtensions)
@@ -475,7 +488,7 @@ VulkanQueueFamilyIndices Backend::getQueueFamilies(VkPhysicalDevice device)
     uint32_t i = 0;
     for(const auto& queueFamily : queueFamilies)
     {
-        if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if(!indices.graphicsInit && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
         {
             indices.graphicsFamilyID = i;
             indices.graphicsInit = true;
@@ -483,13 +496,23 @@ VulkanQueueFamilyIndices Backend::getQueueFamilies(VkPhysicalDevice device)
 
         VkBool32 presentSupport = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, d_surface, &presentSupport);
-        if(presentSupport == VK_TRUE)
+        if(!indices.presentInit && presentSupport == VK_TRUE)
         {
             indices.presentFamilyID = i;
             indices.presentInit = true;
         }
 
-        if(indices.graphicsInit && indices.presentInit)
+        // dedicated copy engine, texture levels down to 1x1 need a transfer granularity of one texel
+        const VkExtent3D& granularity = queueFamily.minImageTransferGranularity;
+        if(!indices.transferInit && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            granularity.width == 1 && granularity.height == 1 && granularity.depth == 1)
+        {
+            indices.transferFamilyID = i;
+            indices.transferInit = true;
+        }
+
+        if(indices.graphicsInit && indices.presentInit && indices.transferInit)
             break;
 
         i++;
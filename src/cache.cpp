@@ -0,0 +1,506 @@
+#include "data.hpp"
+#include "files.hpp"
+#include "texture.hpp"
+#include "convert.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+
+#include "global.hpp"
+extern Application* app;
+
+using namespace DATA;
+
+// binary scene cache (.wcache) layout, all sections are 16 byte aligned
+// header | dependency paths | node table | meshes | mesh constants | meshlets | vertex blob | indice blob | textures
+// bump the version whenever any stored structure changes
+const char SCENE_CACHE_MAGIC[8] = {'W', 'C', 'A', 'C', 'H', 'E', '\0', '\0'};
+const uint32_t SCENE_CACHE_VERSION = 8;
+const size_t SCENE_CACHE_ALIGNMENT = 16;
+
+struct SceneCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexStride;  // stride of vertexFormat when written
+    uint32_t meshStride;    // sizeof(Mesh) when written
+    uint32_t dependencyCount;
+    uint64_t sourceHash;
+    uint32_t nodeCount;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t vertexFormat;  // VertexFormats of the vertex blob
+    uint64_t vertexBytes;
+    uint64_t indiceCount;
+    uint64_t indiceBytes;       // 16 bit region followed by 32 bit region
+    uint64_t indiceOffset32;    // byte offset of the 32 bit region
+    uint32_t buildFlags;        // SceneCacheBuildFlags the cache was cooked with
+    float weldEpsilon;          // GRAPH_WELD_EPSILON if meshes were welded
+    uint32_t meshletCount;
+    uint32_t meshletStride;     // sizeof(Meshlet) when written
+};
+
+// load time processing that changes the cooked data
+enum SceneCacheBuildFlags
+{
+    SCENE_CACHE_OPTIMIZED_MESHES = 1 << 0,
+    SCENE_CACHE_WELDED_MESHES = 1 << 1,
+    SCENE_CACHE_MESHLETS = 1 << 2,
+    SCENE_CACHE_LODS = 1 << 3,
+    SCENE_CACHE_DEDUPLICATED_GEOMETRY = 1 << 4,
+    SCENE_CACHE_COMPRESSED_TEXTURES = 1 << 5,
+};
+
+// get flags of the current settings
+uint32_t getSceneCacheBuildFlags()
+{
+    uint32_t flags = 0;
+    if(app->GRAPH_OPTIMIZE_MESHES) flags |= SCENE_CACHE_OPTIMIZED_MESHES;
+    if(app->GRAPH_WELD_MESHES) flags |= SCENE_CACHE_WELDED_MESHES;
+    if(app->GRAPH_CULL_MESHLETS) flags |= SCENE_CACHE_MESHLETS;
+    if(app->GRAPH_GENERATE_LODS) flags |= SCENE_CACHE_LODS;
+    if(app->GRAPH_DEDUPLICATE_GEOMETRY) flags |= SCENE_CACHE_DEDUPLICATED_GEOMETRY;
+    if(app->GRAPH_COMPRESS_TEXTURES) flags |= SCENE_CACHE_COMPRESSED_TEXTURES;
+    return flags;
+}
+
+struct SceneCacheTexture
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t format;
+    uint64_t dataSize;
+};
+
+// sequential writer for the cache file
+class SceneCacheWriter
+{
+public:
+    SceneCacheWriter(const std::string& path) : d_file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc){}
+    bool isOpen(){return d_file.is_open();}
+    bool good(){return d_file.good();}
+    void close(){d_file.close();}
+
+    void write(const void* data, size_t size)
+    {
+        if(!size) return;
+        d_file.write(static_cast<const char*>(data), size);
+        d_offset += size;
+    }
+    template<typename T>
+    void writeValue(const T& value){write(&value, sizeof(T));}
+    void align()
+    {
+        static const char zeros[SCENE_CACHE_ALIGNMENT] = {};
+        size_t rest = d_offset % SCENE_CACHE_ALIGNMENT;
+        if(rest) write(zeros, SCENE_CACHE_ALIGNMENT - rest);
+    }
+
+private:
+    std::ofstream d_file;
+    size_t d_offset = 0;
+};
+
+// sequential bounds checked reader over the mapped cache file
+class SceneCacheReader
+{
+public:
+    SceneCacheReader(const unsigned char* data, size_t size) : p_data(data), d_size(size){}
+
+    const unsigned char* skip(size_t size)
+    {
+        if(size > d_size - d_offset)
+            throw std::runtime_error("ERROR: scene cache is truncated");
+        const unsigned char* ptr = p_data + d_offset;
+        d_offset += size;
+        return ptr;
+    }
+    template<typename T>
+    T readValue()
+    {
+        T value;
+        memcpy(&value, skip(sizeof(T)), sizeof(T));
+        return value;
+    }
+    void align()
+    {
+        size_t rest = d_offset % SCENE_CACHE_ALIGNMENT;
+        if(rest) skip(SCENE_CACHE_ALIGNMENT - rest);
+    }
+
+private:
+    const unsigned char* p_data;
+    size_t d_size;
+    size_t d_offset = 0;
+};
+
+// texture read from the cache, pixels point into the mapping
+struct SceneCacheTextureView
+{
+    TextureData info;
+    const unsigned char* pixels;
+};
+
+// hash the content of every source file, files are hashed in parallel
+// returns 0 if any of them cannot be read
+static uint64_t hashSceneSources(const std::vector<std::string>& dependencies)
+{
+    std::vector<uint64_t> hashes(dependencies.size(), 0);
+    std::vector<char> found(dependencies.size(), 0);
+    auto hashFile = [&](size_t i)
+    {
+        FILES::MappedFile file;
+        if(!file.open(dependencies[i])) return;
+        hashes[i] = FILES::hash_bytes(file.data(), file.size());
+        found[i] = 1;
+    };
+    UTILS::ThreadPool* pool = app->GetThreadPool();
+    if(pool) pool->parallelFor(dependencies.size(), hashFile);
+    else for(size_t i = 0; i < dependencies.size(); i++) hashFile(i);
+
+    uint64_t hash = SCENE_CACHE_VERSION;
+    for(size_t i = 0; i < dependencies.size(); i++)
+    {
+        if(!found[i]) return 0;
+        hash = FILES::hash_bytes(dependencies[i].data(), dependencies[i].size(), hash);
+        hash = FILES::hash_bytes(&hashes[i], sizeof(uint64_t), hash);
+    }
+    return hash ? hash : 1;
+}
+
+// check the index ranges of a mesh read from the cache against the blobs and the meshlet table
+// the indices themselves are checked once per geometry, checked is a mesh with the same geometry that already passed
+static bool validateSceneCacheMesh(const SceneCacheHeader& header, const Mesh& mesh, const std::vector<Meshlet>& meshlets,
+    const unsigned char* indiceBlob, const Mesh* checked)
+{
+    if(mesh.lodCount > MESH_MAX_LODS || (uint64_t)mesh.meshletStart + mesh.meshletCount > meshlets.size())
+        return false;
+    if((uint64_t)mesh.vertexStart + mesh.vertexCount > header.vertexBytes / header.vertexStride)
+        return false;
+    // the levels follow the full level in the same region
+    uint64_t span = mesh.indiceCount;
+    for(uint32_t l = 0; l < mesh.lodCount; l++)
+        span = std::max<uint64_t>(span, (uint64_t)mesh.lods[l].indiceOffset + mesh.lods[l].indiceCount);
+    for(uint32_t m = mesh.meshletStart; m < mesh.meshletStart + mesh.meshletCount; m++)
+        if((uint64_t)meshlets[m].indiceStart + (uint64_t)meshlets[m].triangleCount * 3 > mesh.indiceCount)
+            return false;
+    if(!span) return true;
+    uint64_t begin, end;
+    if(mesh.indiceType == VK_INDEX_TYPE_UINT16)
+    {
+        begin = (uint64_t)mesh.indiceStart * sizeof(uint16_t);
+        end = begin + span * sizeof(uint16_t);
+        if(end > header.indiceOffset32) return false;
+    }
+    else if(mesh.indiceType == VK_INDEX_TYPE_UINT32)
+    {
+        begin = header.indiceOffset32 + (uint64_t)mesh.indiceStart * sizeof(uint32_t);
+        end = begin + span * sizeof(uint32_t);
+        if(end > header.indiceBytes) return false;
+    }
+    else return false;
+
+    if(checked && checked->indiceType == mesh.indiceType && checked->indiceStart == mesh.indiceStart &&
+        checked->vertexCount == mesh.vertexCount && memcmp(checked->lods, mesh.lods, sizeof(mesh.lods)) == 0 &&
+        checked->indiceCount == mesh.indiceCount && checked->lodCount == mesh.lodCount)
+        return true;
+    // indices are local to the mesh
+    for(uint64_t i = 0; i < span; i++)
+    {
+        uint32_t index;
+        if(mesh.indiceType == VK_INDEX_TYPE_UINT16)
+        {
+            uint16_t value;
+            memcpy(&value, indiceBlob + begin + i * sizeof(uint16_t), sizeof(uint16_t));
+            index = value;
+        }
+        else memcpy(&index, indiceBlob + begin + i * sizeof(uint32_t), sizeof(uint32_t));
+        if(index >= mesh.vertexCount) return false;
+    }
+    return true;
+}
+
+bool Graph::loadSceneCache(const std::string cachePath)
+{
+    LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+    FILES::MappedFile file;
+    if(!file.open(cachePath))
+    {
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "no scene cache found at " + cachePath);}
+        return false;
+    }
+
+    // parse and validate everything before touching the graph
+    SceneCacheHeader header;
+    std::vector<Node*> nodes;
+    std::vector<Mesh*> meshes;
+    std::vector<MeshConstantData> constants;
+    std::vector<Meshlet> meshlets;
+    std::vector<SceneCacheTextureView> textures;
+    const unsigned char* vertexBlob = nullptr;
+    const unsigned char* indiceBlob = nullptr;
+    try
+    {
+        SceneCacheReader reader(file.data(), file.size());
+        header = reader.readValue<SceneCacheHeader>();
+        if(memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(SCENE_CACHE_MAGIC)) != 0)
+            throw std::runtime_error("not a scene cache");
+        if(header.version != SCENE_CACHE_VERSION || header.meshStride != sizeof(Mesh) || header.meshletStride != sizeof(Meshlet) ||
+            header.vertexFormat != static_cast<uint32_t>(d_vertex_format) || header.vertexStride != getVertexFormatStride(d_vertex_format) ||
+            header.buildFlags != getSceneCacheBuildFlags() ||
+            header.weldEpsilon != (app->GRAPH_WELD_MESHES ? app->GRAPH_WELD_EPSILON : 0.0f))
+            throw std::runtime_error("scene cache version is outdated");
+
+        std::vector<std::string> dependencies(header.dependencyCount);
+        for(auto& dependency : dependencies)
+        {
+            uint32_t length = reader.readValue<uint32_t>();
+            const char* chars = reinterpret_cast<const char*>(reader.skip(length));
+            dependency.assign(chars, length);
+        }
+        if(hashSceneSources(dependencies) != header.sourceHash)
+            throw std::runtime_error("source files changed since scene cache was written");
+        reader.align();
+
+        nodes.resize(header.nodeCount, nullptr);
+        for(auto& node : nodes) node = new Node;
+        for(uint32_t i = 0; i < header.nodeCount; i++)
+        {
+            Node* node = nodes[i];
+            node->nodeID = reader.readValue<uint32_t>();
+            uint32_t parentID = reader.readValue<uint32_t>();
+            if(node->nodeID != i || (parentID != UINT32_MAX && parentID >= header.nodeCount))
+                throw std::runtime_error("scene cache node table is corrupted");
+            node->parentNode = parentID == UINT32_MAX ? nullptr : nodes[parentID];
+            memcpy(&node->transformMat, reader.skip(sizeof(glm::mat4)), sizeof(glm::mat4));
+            node->meshIDs.resize(reader.readValue<uint32_t>());
+            for(auto& meshID : node->meshIDs)
+            {
+                meshID = reader.readValue<uint32_t>();
+                if(meshID >= header.meshCount) throw std::runtime_error("scene cache node table is corrupted");
+            }
+            uint32_t childCount = reader.readValue<uint32_t>();
+            for(uint32_t c = 0; c < childCount; c++)
+            {
+                uint32_t childID = reader.readValue<uint32_t>();
+                if(childID >= header.nodeCount) throw std::runtime_error("scene cache node table is corrupted");
+                node->childrenNodes.push_back(nodes[childID]);
+            }
+        }
+        reader.align();
+
+        meshes.resize(header.meshCount, nullptr);
+        for(auto& mesh : meshes)
+        {
+            mesh = new Mesh;
+            memcpy(mesh, reader.skip(sizeof(Mesh)), sizeof(Mesh));
+        }
+        constants.resize(header.meshCount);
+        if(header.meshCount)
+            memcpy(constants.data(), reader.skip(sizeof(MeshConstantData) * header.meshCount), sizeof(MeshConstantData) * header.meshCount);
+        reader.align();
+
+        meshlets.resize(header.meshletCount);
+        if(header.meshletCount)
+            memcpy(meshlets.data(), reader.skip(sizeof(Meshlet) * header.meshletCount), sizeof(Meshlet) * header.meshletCount);
+        reader.align();
+
+        vertexBlob = reader.skip(static_cast<size_t>(header.vertexBytes));
+        reader.align();
+        if(header.indiceOffset32 > header.indiceBytes)
+            throw std::runtime_error("scene cache indice layout is corrupted");
+        indiceBlob = reader.skip(static_cast<size_t>(header.indiceBytes));
+        reader.align();
+
+        // draws and texture bindings index straight into the buffers and d_unique_textures
+        uint32_t textureSlots = static_cast<uint32_t>(d_unique_textures.size()) + header.textureCount;
+        std::vector<uint32_t> checkedGeometry(header.meshCount, UINT32_MAX);
+        for(uint32_t i = 0; i < header.meshCount; i++)
+        {
+            const Mesh& mesh = *meshes[i];
+            if(mesh.meshID != i || mesh.nodeID >= header.nodeCount || mesh.geometryID >= header.meshCount ||
+                mesh.texBase >= textureSlots || mesh.texRough >= textureSlots || mesh.texNormal >= textureSlots ||
+                mesh.texOcclusion >= textureSlots || mesh.texEmissive >= textureSlots ||
+                !validateSceneCacheMesh(header, mesh, meshlets, indiceBlob, checkedGeometry[mesh.geometryID] == UINT32_MAX ?
+                    nullptr : meshes[checkedGeometry[mesh.geometryID]]))
+                throw std::runtime_error("scene cache mesh table is corrupted");
+            checkedGeometry[mesh.geometryID] = i;
+        }
+
+        textures.resize(header.textureCount);
+        for(auto& texture : textures)
+        {
+            SceneCacheTexture info = reader.readValue<SceneCacheTexture>();
+            texture.info.width = info.width;
+            texture.info.height = info.height;
+            texture.info.levels = info.levels;
+            texture.info.format = static_cast<VkFormat>(info.format);
+            texture.info.levelOffsets.resize(info.levels);
+            for(auto& offset : texture.info.levelOffsets)
+                offset = reader.readValue<uint64_t>();
+            if(!info.levels || info.levels > getTextureMipLevels(info.width, info.height) ||
+                texture.info.levelOffsets.back() + getTextureLevelSize(texture.info.format, info.width, info.height, info.levels - 1) > info.dataSize)
+                throw std::runtime_error("scene cache texture table is corrupted");
+            // caches cooked on another device may hold block formats this one cannot sample
+            if(isTextureFormatCompressed(texture.info.format) && std::find(d_texture_target.blockFormats.begin(),
+                d_texture_target.blockFormats.end(), texture.info.format) == d_texture_target.blockFormats.end())
+                throw std::runtime_error("scene cache texture format is not supported by the device");
+            reader.align();
+            texture.pixels = reader.skip(static_cast<size_t>(info.dataSize));
+            reader.align();
+        }
+    }
+    catch(std::exception& e)
+    {
+        for(auto& node : nodes) delete node;
+        for(auto& mesh : meshes) delete mesh;
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "scene cache " + cachePath + " ignored: " + e.what());}
+        return false;
+    }
+
+    // upload straight from the mapping
+    d_nodes = nodes;
+    d_meshes = meshes;
+    d_mesh_constants = constants;
+    d_meshlets = meshlets;
+    d_dynamic_draws = !d_meshlets.empty();
+    for(auto& mesh : d_meshes)
+        if(mesh->lodCount) d_dynamic_draws = true;
+    for(auto& texture : textures)
+        d_unique_textures.push_back(createTextureFromData(texture.info, texture.pixels));
+    if(header.vertexBytes)
+        d_vertex_buffer = createDeviceLocalBuffer(vertexBlob, header.vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    d_indice_count = static_cast<uint32_t>(header.indiceCount);
+    d_indice_offset_32 = header.indiceOffset32;
+    if(header.indiceBytes)
+        d_indice_buffer = createDeviceLocalBuffer(indiceBlob, header.indiceBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    if(myLogger){myLogger->AddMessage(myLoggerOwner, "scene cache loaded from " + cachePath + ", " + describeTextureMemory());}
+    return true;
+}
+
+void Graph::packSceneGeometry(const std::vector<GraphUserInput>& meshes, std::vector<unsigned char>& vertexBlob,
+    std::vector<unsigned char>& indiceBlob)
+{
+    // same packing as the device vertex and indice buffers
+    size_t vertexCount = 0;
+    for(auto& mesh : meshes)
+        vertexCount += mesh.vertices.size();
+    vertexBlob.resize(getVertexFormatStride(d_vertex_format) * vertexCount);
+    writeVertexBuffer(meshes, vertexBlob.data());
+    indiceBlob.resize(static_cast<size_t>(layoutIndiceBuffer(meshes)));
+    writeIndiceBuffer(meshes, indiceBlob.data());
+}
+
+void Graph::saveSceneCache(const std::string cachePath, const std::vector<unsigned char>& vertexBlob,
+    const std::vector<unsigned char>& indiceBlob, const std::vector<TextureData>& textures,
+    const std::vector<std::string>& dependencies)
+{
+    LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+    uint64_t sourceHash = hashSceneSources(dependencies);
+    if(!sourceHash)
+    {
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "scene cache not written, some source files cannot be read");}
+        return;
+    }
+
+    SceneCacheHeader header{};
+    memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(SCENE_CACHE_MAGIC));
+    header.version = SCENE_CACHE_VERSION;
+    header.vertexStride = static_cast<uint32_t>(getVertexFormatStride(d_vertex_format));
+    header.vertexFormat = static_cast<uint32_t>(d_vertex_format);
+    header.buildFlags = getSceneCacheBuildFlags();
+    header.weldEpsilon = app->GRAPH_WELD_MESHES ? app->GRAPH_WELD_EPSILON : 0.0f;
+    header.meshStride = sizeof(Mesh);
+    header.meshletCount = static_cast<uint32_t>(d_meshlets.size());
+    header.meshletStride = sizeof(Meshlet);
+    header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    header.sourceHash = sourceHash;
+    header.nodeCount = static_cast<uint32_t>(d_nodes.size());
+    header.meshCount = static_cast<uint32_t>(d_meshes.size());
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.vertexBytes = vertexBlob.size();
+    header.indiceCount = d_indice_count;
+    header.indiceBytes = indiceBlob.size();
+    header.indiceOffset32 = d_indice_offset_32;
+
+    // write to a temporary file first so a crash never leaves a broken cache behind
+    std::string path = std::string(GLOB_FILE_FOLDER) + "/" + cachePath;
+    std::string tempPath = path + ".tmp";
+    SceneCacheWriter writer(tempPath);
+    if(!writer.isOpen())
+    {
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "scene cache not written, cannot open " + tempPath);}
+        return;
+    }
+
+    writer.writeValue(header);
+    for(auto& dependency : dependencies)
+    {
+        writer.writeValue(static_cast<uint32_t>(dependency.size()));
+        writer.write(dependency.data(), dependency.size());
+    }
+    writer.align();
+
+    for(auto& node : d_nodes)
+    {
+        writer.writeValue(node->nodeID);
+        writer.writeValue(node->parentNode ? node->parentNode->nodeID : UINT32_MAX);
+        writer.write(&node->transformMat, sizeof(glm::mat4));
+        writer.writeValue(static_cast<uint32_t>(node->meshIDs.size()));
+        for(uint32_t meshID : node->meshIDs)
+            writer.writeValue(meshID);
+        writer.writeValue(static_cast<uint32_t>(node->childrenNodes.size()));
+        for(auto& child : node->childrenNodes)
+            writer.writeValue(child->nodeID);
+    }
+    writer.align();
+
+    for(auto& mesh : d_meshes)
+        writer.write(mesh, sizeof(Mesh));
+    writer.write(d_mesh_constants.data(), sizeof(MeshConstantData) * d_mesh_constants.size());
+    writer.align();
+
+    writer.write(d_meshlets.data(), sizeof(Meshlet) * d_meshlets.size());
+    writer.align();
+
+    writer.write(vertexBlob.data(), vertexBlob.size());
+    writer.align();
+    writer.write(indiceBlob.data(), indiceBlob.size());
+    writer.align();
+
+    for(auto& texture : textures)
+    {
+        SceneCacheTexture info{};
+        info.width = texture.width;
+        info.height = texture.height;
+        info.levels = texture.levels;
+        info.format = static_cast<uint32_t>(texture.format);
+        info.dataSize = texture.pixels.size();
+        writer.writeValue(info);
+        for(uint32_t level = 0; level < texture.levels; level++)
+            writer.writeValue(static_cast<uint64_t>(texture.levelOffsets[level]));
+        writer.align();
+        writer.write(texture.pixels.data(), texture.pixels.size());
+        writer.align();
+    }
+
+    bool good = writer.good();
+    writer.close();
+    std::remove(path.c_str());
+    if(!good || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "scene cache not written, failed to write " + path);}
+        return;
+    }
+    if(myLogger){myLogger->AddMessage(myLoggerOwner, "scene cache written to " + cachePath);}
+}
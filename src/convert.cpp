@@ -0,0 +1,565 @@
+#include "convert.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/gtc/packing.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONVERT_ENABLE_SSE2
+#define CONVERT_ENABLE_AVX2
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CONVERT_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define CONVERT_AVX2_TARGET
+#endif
+
+using namespace DATA;
+
+// where and how an attribute is written into Vertex
+struct AttributeTarget
+{
+    size_t offset;          // byte offset inside Vertex
+    uint32_t components;    // floats written
+    bool normalize;         // normalize xyz
+    float fillW;            // 4th component when source has less
+};
+
+static AttributeTarget getAttributeTarget(VertexAttributes attribute)
+{
+    switch(attribute)
+    {
+        case VERTEX_POSITION:   return {offsetof(Vertex, pos), 3, false, 0.0f};
+        case VERTEX_NORMAL:     return {offsetof(Vertex, normal), 3, true, 0.0f};
+        case VERTEX_TANGENT:    return {offsetof(Vertex, tangent), 4, false, 1.0f};
+        case VERTEX_COORD:      return {offsetof(Vertex, coord), 2, false, 0.0f};
+        case VERTEX_COLOR:      return {offsetof(Vertex, color), 4, false, 1.0f};
+        default: throw std::runtime_error("ERROR: unsupported vertex attribute for conversion");
+    }
+}
+
+static size_t getComponentSize(AttributeComponentTypes type)
+{
+    switch(type)
+    {
+        case ATTRIBUTE_UNORM8:
+        case ATTRIBUTE_SNORM8:
+        case ATTRIBUTE_UINT8:
+        case ATTRIBUTE_SINT8:   return 1;
+        case ATTRIBUTE_UNORM16:
+        case ATTRIBUTE_SNORM16:
+        case ATTRIBUTE_UINT16:
+        case ATTRIBUTE_SINT16:  return 2;
+        default:                return 4;
+    }
+}
+
+static bool isComponentSigned(AttributeComponentTypes type)
+{
+    return type == ATTRIBUTE_SNORM8 || type == ATTRIBUTE_SNORM16 || type == ATTRIBUTE_SINT8 || type == ATTRIBUTE_SINT16;
+}
+
+// the smallest snorm value maps below -1 and is clamped
+static bool isComponentSnorm(AttributeComponentTypes type)
+{
+    return type == ATTRIBUTE_SNORM8 || type == ATTRIBUTE_SNORM16;
+}
+
+// factor from the stored integer to the float value, 1 for floats and unnormalized integers
+static float getComponentScale(AttributeComponentTypes type)
+{
+    switch(type)
+    {
+        case ATTRIBUTE_UNORM8:  return 1.0f / 255.0f;
+        case ATTRIBUTE_UNORM16: return 1.0f / 65535.0f;
+        case ATTRIBUTE_SNORM8:  return 1.0f / 127.0f;
+        case ATTRIBUTE_SNORM16: return 1.0f / 32767.0f;
+        default:                return 1.0f;
+    }
+}
+
+// number of leading elements that can be read with extra bytes past their end
+// without leaving the source range [0, (count-1) * stride + elementSize)
+static size_t getSafeCount(size_t count, size_t stride, size_t overread)
+{
+    if(!count || !overread) return count;
+    if(!stride) return 0;
+    size_t skip = (overread + stride - 1) / stride;
+    return count > skip ? count - skip : 0;
+}
+
+// read one component as float, T is the stored type
+template<typename T>
+static inline float readComponent(const unsigned char* in)
+{
+    T v;
+    memcpy(&v, in, sizeof(v));
+    return static_cast<float>(v);
+}
+
+template<typename T>
+static void convertScalarTyped(unsigned char* dst, size_t begin, size_t end, const AttributeSource& src, const AttributeTarget& target)
+{
+    uint32_t components = std::min(src.components, target.components);
+    float scale = getComponentScale(src.type);
+    bool snorm = isComponentSnorm(src.type);
+    for(size_t i = begin; i < end; i++)
+    {
+        const unsigned char* in = src.data + i * src.stride;
+        float v[4] = {0.0f, 0.0f, 0.0f, target.fillW};
+        for(uint32_t c = 0; c < components; c++)
+        {
+            v[c] = readComponent<T>(in + c * sizeof(T)) * scale;
+            if(snorm) v[c] = std::max(v[c], -1.0f);
+        }
+        if(target.normalize)
+        {
+            float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if(len > 0.0f)
+            {
+                v[0] = v[0] / len;
+                v[1] = v[1] / len;
+                v[2] = v[2] / len;
+            }
+            else v[0] = v[1] = v[2] = 0.0f;
+        }
+        float* out = reinterpret_cast<float*>(dst + i * sizeof(Vertex) + target.offset);
+        out[0] = v[0];
+        out[1] = v[1];
+        if(target.components > 2) out[2] = v[2];
+        if(target.components > 3) out[3] = v[3];
+    }
+}
+
+static void convertScalar(unsigned char* dst, size_t begin, size_t end, const AttributeSource& src, const AttributeTarget& target)
+{
+    switch(src.type)
+    {
+        case ATTRIBUTE_UNORM8:
+        case ATTRIBUTE_UINT8:   convertScalarTyped<uint8_t>(dst, begin, end, src, target); break;
+        case ATTRIBUTE_UNORM16:
+        case ATTRIBUTE_UINT16:  convertScalarTyped<uint16_t>(dst, begin, end, src, target); break;
+        case ATTRIBUTE_SNORM8:
+        case ATTRIBUTE_SINT8:   convertScalarTyped<int8_t>(dst, begin, end, src, target); break;
+        case ATTRIBUTE_SNORM16:
+        case ATTRIBUTE_SINT16:  convertScalarTyped<int16_t>(dst, begin, end, src, target); break;
+        default:                convertScalarTyped<float>(dst, begin, end, src, target); break;
+    }
+}
+
+#ifdef CONVERT_ENABLE_SSE2
+// store the first components of v into out
+static inline void storeSSE2(float* out, __m128 v, uint32_t components)
+{
+    if(components == 4)
+        _mm_storeu_ps(out, v);
+    else
+    {
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), v);
+        if(components == 3)
+            _mm_store_ss(out + 2, _mm_movehl_ps(v, v));
+    }
+}
+
+// load 4 components of one element as floats, integers are not scaled yet
+static inline __m128 loadSSE2(const unsigned char* in, size_t componentSize, bool isSigned)
+{
+    if(componentSize == 1)
+    {
+        int32_t raw;
+        memcpy(&raw, in, sizeof(raw));
+        __m128i w = _mm_cvtsi32_si128(raw);
+        // signed values are widened into the top bits and shifted back down
+        if(isSigned)
+        {
+            w = _mm_unpacklo_epi8(w, w);
+            w = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 24);
+        }
+        else
+            w = _mm_unpacklo_epi16(_mm_unpacklo_epi8(w, _mm_setzero_si128()), _mm_setzero_si128());
+        return _mm_cvtepi32_ps(w);
+    }
+    if(componentSize == 2)
+    {
+        __m128i w = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+        if(isSigned)
+            w = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16);
+        else
+            w = _mm_unpacklo_epi16(w, _mm_setzero_si128());
+        return _mm_cvtepi32_ps(w);
+    }
+    return _mm_loadu_ps(reinterpret_cast<const float*>(in));
+}
+
+// one element per iteration, loads 4 components at once
+static size_t convertSSE2(unsigned char* dst, size_t begin, size_t end, const AttributeSource& src, const AttributeTarget& target)
+{
+    size_t componentSize = getComponentSize(src.type);
+    bool isSigned = isComponentSigned(src.type);
+    bool snorm = isComponentSnorm(src.type);
+    uint32_t components = std::min(src.components, target.components);
+    size_t safe = std::min(end, getSafeCount(src.count, src.stride, (4 - components) * componentSize));
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 keep = _mm_castsi128_ps(_mm_setr_epi32(
+        components > 0 ? -1 : 0, components > 1 ? -1 : 0, components > 2 ? -1 : 0, components > 3 ? -1 : 0));
+    const __m128 fill = _mm_setr_ps(0.0f, 0.0f, 0.0f, components < 4 ? target.fillW : 0.0f);
+    const __m128 scale = _mm_set1_ps(getComponentScale(src.type));
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+
+    size_t i = begin;
+    for(; i < safe; i++)
+    {
+        const unsigned char* in = src.data + i * src.stride;
+        __m128 v = loadSSE2(in, componentSize, isSigned);
+        if(componentSize < 4) v = _mm_mul_ps(v, scale);
+        if(snorm) v = _mm_max_ps(v, minusOne);
+        v = _mm_or_ps(_mm_and_ps(v, keep), fill);
+
+        if(target.normalize)
+        {
+            // lane 3 is zero for normals, so the horizontal sum is x*x + y*y + z*z
+            __m128 sq = _mm_mul_ps(v, v);
+            __m128 sum = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            __m128 len = _mm_sqrt_ps(sum);
+            v = _mm_and_ps(_mm_div_ps(v, len), _mm_cmpgt_ps(len, zero));
+        }
+
+        storeSSE2(reinterpret_cast<float*>(dst + i * sizeof(Vertex) + target.offset), v, target.components);
+    }
+    return i;
+}
+
+// load elements a and b into the low and high lane, integers are not scaled yet
+CONVERT_AVX2_TARGET
+static inline __m256 loadPairAVX2(const unsigned char* a, const unsigned char* b, size_t componentSize, bool isSigned)
+{
+    if(componentSize == 1)
+    {
+        int32_t ra, rb;
+        memcpy(&ra, a, sizeof(ra));
+        memcpy(&rb, b, sizeof(rb));
+        __m128i w = _mm_unpacklo_epi32(_mm_cvtsi32_si128(ra), _mm_cvtsi32_si128(rb));
+        return _mm256_cvtepi32_ps(isSigned ? _mm256_cvtepi8_epi32(w) : _mm256_cvtepu8_epi32(w));
+    }
+    if(componentSize == 2)
+    {
+        __m128i w = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)));
+        return _mm256_cvtepi32_ps(isSigned ? _mm256_cvtepi16_epi32(w) : _mm256_cvtepu16_epi32(w));
+    }
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(reinterpret_cast<const float*>(a))),
+        _mm_loadu_ps(reinterpret_cast<const float*>(b)), 1);
+}
+
+// two elements per register, four elements per iteration
+CONVERT_AVX2_TARGET
+static size_t convertAVX2(unsigned char* dst, size_t begin, size_t end, const AttributeSource& src, const AttributeTarget& target)
+{
+    size_t componentSize = getComponentSize(src.type);
+    bool isSigned = isComponentSigned(src.type);
+    bool snorm = isComponentSnorm(src.type);
+    uint32_t components = std::min(src.components, target.components);
+    size_t safe = std::min(end, getSafeCount(src.count, src.stride, (4 - components) * componentSize));
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i keepi = _mm256_setr_epi32(
+        components > 0 ? -1 : 0, components > 1 ? -1 : 0, components > 2 ? -1 : 0, components > 3 ? -1 : 0,
+        components > 0 ? -1 : 0, components > 1 ? -1 : 0, components > 2 ? -1 : 0, components > 3 ? -1 : 0);
+    const __m256 keep = _mm256_castsi256_ps(keepi);
+    const float w = components < 4 ? target.fillW : 0.0f;
+    const __m256 fill = _mm256_setr_ps(0.0f, 0.0f, 0.0f, w, 0.0f, 0.0f, 0.0f, w);
+    const __m256 scale = _mm256_set1_ps(getComponentScale(src.type));
+    const __m256 minusOne = _mm256_set1_ps(-1.0f);
+
+    size_t i = begin;
+    for(; i + 4 <= safe; i += 4)
+    {
+        const unsigned char* in = src.data + i * src.stride;
+        __m256 v[2];
+        v[0] = loadPairAVX2(in, in + src.stride, componentSize, isSigned);
+        v[1] = loadPairAVX2(in + 2 * src.stride, in + 3 * src.stride, componentSize, isSigned);
+        for(uint32_t k = 0; k < 2; k++)
+        {
+            if(componentSize < 4) v[k] = _mm256_mul_ps(v[k], scale);
+            if(snorm) v[k] = _mm256_max_ps(v[k], minusOne);
+            v[k] = _mm256_or_ps(_mm256_and_ps(v[k], keep), fill);
+            if(target.normalize)
+            {
+                __m256 sq = _mm256_mul_ps(v[k], v[k]);
+                __m256 sum = _mm256_add_ps(sq, _mm256_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+                sum = _mm256_add_ps(sum, _mm256_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+                __m256 len = _mm256_sqrt_ps(sum);
+                v[k] = _mm256_and_ps(_mm256_div_ps(v[k], len), _mm256_cmp_ps(len, zero, _CMP_GT_OQ));
+            }
+            unsigned char* out = dst + (i + 2 * k) * sizeof(Vertex) + target.offset;
+            storeSSE2(reinterpret_cast<float*>(out), _mm256_castps256_ps128(v[k]), target.components);
+            storeSSE2(reinterpret_cast<float*>(out + sizeof(Vertex)), _mm256_extractf128_ps(v[k], 1), target.components);
+        }
+    }
+    return i;
+}
+#endif
+
+static ConvertPaths detectVertexConvertPath()
+{
+#ifdef CONVERT_ENABLE_AVX2
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        if(osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6)
+            return CONVERT_PATH_AVX2;
+    }
+#else
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return CONVERT_PATH_AVX2;
+#endif
+#endif
+#ifdef CONVERT_ENABLE_SSE2
+    return CONVERT_PATH_SSE2;
+#else
+    return CONVERT_PATH_SCALAR;
+#endif
+}
+
+ConvertPaths DATA::getVertexConvertPath()
+{
+    static ConvertPaths path = detectVertexConvertPath();
+    return path;
+}
+
+const char* DATA::getVertexConvertPathName(ConvertPaths path)
+{
+    switch(path)
+    {
+        case CONVERT_PATH_AVX2: return "AVX2";
+        case CONVERT_PATH_SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+// convert [begin, end) of one attribute, sources are already validated
+static void convertRange(unsigned char* dst, size_t begin, size_t end, const AttributeSource& src, const AttributeTarget& target, ConvertPaths path)
+{
+#ifdef CONVERT_ENABLE_SSE2
+    if(path == CONVERT_PATH_AVX2)
+        begin = convertAVX2(dst, begin, end, src, target);
+    if(path >= CONVERT_PATH_SSE2)
+        begin = convertSSE2(dst, begin, end, src, target);
+#endif
+    convertScalar(dst, begin, end, src, target);
+}
+
+static void validateSource(const AttributeSource& src)
+{
+    if(src.components < 2 || src.components > 4)
+        throw std::runtime_error("ERROR: unsupported vertex attribute component count");
+    if(!src.stride)
+        throw std::runtime_error("ERROR: invalid vertex attribute stride");
+}
+
+void DATA::convertVertexAttribute(Vertex* dst, size_t count, VertexAttributes attribute, const AttributeSource& src)
+{
+    convertVertexAttribute(dst, count, attribute, src, getVertexConvertPath());
+}
+
+void DATA::convertVertexAttribute(Vertex* dst, size_t count, VertexAttributes attribute, const AttributeSource& src, ConvertPaths path)
+{
+    if(!dst || !src.data || !count) return;
+    validateSource(src);
+    // never run a path the CPU does not support
+    path = std::min(path, getVertexConvertPath());
+    convertRange(reinterpret_cast<unsigned char*>(dst), 0, std::min(count, src.count), src, getAttributeTarget(attribute), path);
+}
+
+void DATA::convertVertices(Vertex* dst, size_t count, const AttributeSource* sources)
+{
+    convertVertices(dst, count, sources, getVertexConvertPath());
+}
+
+void DATA::convertVertices(Vertex* dst, size_t count, const AttributeSource* sources, ConvertPaths path)
+{
+    if(!dst || !count) return;
+    path = std::min(path, getVertexConvertPath());
+    AttributeTarget targets[VERTEX_ATTRIBUTE_COUNT];
+    for(uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+    {
+        targets[a] = getAttributeTarget(static_cast<VertexAttributes>(a));
+        if(sources[a].data) validateSource(sources[a]);
+    }
+
+    // walk the vertices in chunks small enough to stay in cache
+    // so every attribute writes into lines that are already loaded
+    const size_t chunk = 512;
+    unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+    for(size_t begin = 0; begin < count; begin += chunk)
+    {
+        size_t end = std::min(count, begin + chunk);
+        for(uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+        {
+            const AttributeSource& src = sources[a];
+            size_t srcEnd = src.data ? std::min(end, src.count) : begin;
+            if(srcEnd > begin)
+                convertRange(out, begin, srcEnd, src, targets[a], path);
+            // attributes that are missing or too short are zero
+            for(size_t i = std::max(begin, srcEnd); i < end; i++)
+                memset(out + i * sizeof(Vertex) + targets[a].offset, 0, targets[a].components * sizeof(float));
+        }
+    }
+}
+
+size_t DATA::getVertexFormatStride(VertexFormats format)
+{
+    switch(format)
+    {
+        case VERTEX_FORMAT_FULL:        return sizeof(Vertex);
+        case VERTEX_FORMAT_COMPACT:     return sizeof(CompactVertex);
+        case VERTEX_FORMAT_QUANTIZED:   return sizeof(QuantizedVertex);
+        default: throw std::runtime_error("ERROR: unknown vertex format");
+    }
+}
+
+const char* DATA::getVertexFormatName(VertexFormats format)
+{
+    switch(format)
+    {
+        case VERTEX_FORMAT_FULL:        return "full";
+        case VERTEX_FORMAT_COMPACT:     return "compact";
+        case VERTEX_FORMAT_QUANTIZED:   return "quantized";
+        default:                        return "unknown";
+    }
+}
+
+void DATA::findVertexQuantization(const Vertex* src, size_t count, glm::vec3& offset, glm::vec3& scale)
+{
+    if(!count)
+    {
+        offset = glm::vec3(0.0f);
+        scale = glm::vec3(1.0f);
+        return;
+    }
+    glm::vec3 minPos = src[0].pos;
+    glm::vec3 maxPos = src[0].pos;
+    for(size_t i = 1; i < count; i++)
+    {
+        minPos = glm::min(minPos, src[i].pos);
+        maxPos = glm::max(maxPos, src[i].pos);
+    }
+    offset = minPos;
+    scale = maxPos - minPos;
+}
+
+static inline float signNotZero(float v)
+{
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// octahedral mapping of a unit vector into [-1, 1]^2, zero vectors map to the origin
+static inline glm::vec2 encodeOctahedral(const glm::vec3& n)
+{
+    float length = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if(length <= 0.0f) return glm::vec2(0.0f);
+    glm::vec2 p = glm::vec2(n.x, n.y) / length;
+    if(n.z < 0.0f)
+        p = glm::vec2((1.0f - std::fabs(p.y)) * signNotZero(p.x), (1.0f - std::fabs(p.x)) * signNotZero(p.y));
+    return p;
+}
+
+static inline int16_t packSnorm16(float v)
+{
+    return static_cast<int16_t>(std::round(glm::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+static inline int8_t packSnorm8(float v)
+{
+    return static_cast<int8_t>(std::round(glm::clamp(v, -1.0f, 1.0f) * 127.0f));
+}
+
+static inline uint8_t packUnorm8(float v)
+{
+    return static_cast<uint8_t>(std::round(glm::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+
+static inline uint16_t packUnorm16(float v)
+{
+    return static_cast<uint16_t>(std::round(glm::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+// attributes shared by CompactVertex and QuantizedVertex
+template<typename T>
+static inline void packCompactAttributes(const Vertex& in, T& out)
+{
+    glm::vec2 normal = encodeOctahedral(in.normal);
+    out.normal[0] = packSnorm16(normal.x);
+    out.normal[1] = packSnorm16(normal.y);
+    glm::vec2 tangent = encodeOctahedral(glm::vec3(in.tangent));
+    out.tangent[0] = packSnorm8(tangent.x);
+    out.tangent[1] = packSnorm8(tangent.y);
+    out.tangent[2] = in.tangent.w < 0.0f ? -127 : 127;
+    out.tangent[3] = 0;
+    out.coord[0] = glm::packHalf1x16(in.coord.x);
+    out.coord[1] = glm::packHalf1x16(in.coord.y);
+    for(int c = 0; c < 4; c++)
+        out.color[c] = packUnorm8(in.color[c]);
+}
+
+void DATA::packVertices(const Vertex* src, size_t count, VertexFormats format, const glm::vec3& offset, const glm::vec3& scale, unsigned char* dst)
+{
+    if(!src || !count) return;
+    switch(format)
+    {
+        case VERTEX_FORMAT_FULL:
+        {
+            memcpy(dst, src, sizeof(Vertex) * count);
+            break;
+        }
+        case VERTEX_FORMAT_COMPACT:
+        {
+            CompactVertex* out = reinterpret_cast<CompactVertex*>(dst);
+            for(size_t i = 0; i < count; i++)
+            {
+                out[i].pos = src[i].pos;
+                packCompactAttributes(src[i], out[i]);
+            }
+            break;
+        }
+        case VERTEX_FORMAT_QUANTIZED:
+        {
+            // flat axes have zero scale and store zero
+            glm::vec3 inverse;
+            for(int c = 0; c < 3; c++)
+                inverse[c] = scale[c] > 0.0f ? 1.0f / scale[c] : 0.0f;
+            QuantizedVertex* out = reinterpret_cast<QuantizedVertex*>(dst);
+            for(size_t i = 0; i < count; i++)
+            {
+                glm::vec3 q = (src[i].pos - offset) * inverse;
+                out[i].pos[0] = packUnorm16(q.x);
+                out[i].pos[1] = packUnorm16(q.y);
+                out[i].pos[2] = packUnorm16(q.z);
+                out[i].pos[3] = 0;
+                packCompactAttributes(src[i], out[i]);
+            }
+            break;
+        }
+        default: throw std::runtime_error("ERROR: unknown vertex format");
+    }
+}
@@ -0,0 +1,571 @@
+#include "files.hpp"
+#include "threads.hpp"
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define FILES_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#endif
+#endif
+
+using namespace FILES;
+
+bool MappedFile::open(const std::string& filePath)
+{
+    close();
+    std::string path = std::string(GLOB_FILE_FOLDER) + "/" + filePath;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    p_handle = file;
+    d_open = true;
+    d_size = static_cast<size_t>(fileSize.QuadPart);
+    if(!d_size) return true;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping)
+    {
+        close();
+        return false;
+    }
+    p_mapping = mapping;
+    p_data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!p_data)
+    {
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    d_fd = fd;
+    d_open = true;
+    d_size = static_cast<size_t>(info.st_size);
+    if(!d_size) return true;
+    void* mapped = mmap(nullptr, d_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    p_data = static_cast<const unsigned char*>(mapped);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+    if(p_data) UnmapViewOfFile(p_data);
+    if(p_mapping) CloseHandle(static_cast<HANDLE>(p_mapping));
+    if(p_handle) CloseHandle(static_cast<HANDLE>(p_handle));
+#else
+    if(p_data) munmap(const_cast<unsigned char*>(p_data), d_size);
+    if(d_fd >= 0) ::close(d_fd);
+#endif
+    p_data = nullptr;
+    p_mapping = nullptr;
+    p_handle = nullptr;
+    d_fd = -1;
+    d_size = 0;
+    d_open = false;
+}
+
+struct ReadBatch::State
+{
+    struct Request
+    {
+        std::string path;
+        std::vector<unsigned char> data;
+        int fd = -1;
+        size_t offset = 0;
+        bool done = false;
+        bool taken = false;
+        bool failed = false;
+    };
+    std::deque<Request> requests;
+    std::map<std::string, size_t> ids;
+    std::deque<size_t> completed;
+    std::atomic<size_t> next{0}; // next request to claim in thread pool mode
+    size_t finished = 0;
+    size_t taken = 0;
+    bool submitted = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+namespace
+{
+    typedef ReadBatch::State ReadState;
+
+    // read a whole file with a single read call
+    void readWhole(ReadState::Request& request)
+    {
+        std::string path = std::string(GLOB_FILE_FOLDER) + "/" + request.path;
+        std::ifstream inFile(path.c_str(), std::ios::ate | std::ios::binary);
+        if(!inFile.is_open())
+        {
+            request.failed = true;
+            return;
+        }
+        request.data.resize(static_cast<size_t>(inFile.tellg()));
+        inFile.seekg(0);
+        if(!request.data.empty())
+            inFile.read(reinterpret_cast<char*>(request.data.data()), request.data.size());
+        request.failed = !inFile.good() && !request.data.empty();
+    }
+
+    void completeRead(ReadState& state, size_t id, bool failed)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            auto& request = state.requests[id];
+            if(failed)
+            {
+                request.failed = true;
+                std::vector<unsigned char>().swap(request.data);
+            }
+            request.done = true;
+            state.completed.push_back(id);
+            state.finished++;
+        }
+        state.condition.notify_all();
+    }
+
+    // claim one request and read it, returns false if nothing was left to claim
+    bool readClaimed(ReadState& state)
+    {
+        size_t id = state.next++;
+        if(id >= state.requests.size()) return false;
+        readWhole(state.requests[id]);
+        completeRead(state, id, state.requests[id].failed);
+        return true;
+    }
+
+#ifdef FILES_IO_URING
+    // minimal io_uring without liburing, one submission queue driven by the batch owner
+    struct IOUring
+    {
+        static const unsigned ENTRIES = 64;
+        // larger reads are split, a single read returns at most ~2GB
+        static const size_t MAX_READ = size_t(1) << 30;
+
+        int fd = -1;
+        void* sqMap = nullptr;
+        void* cqMap = nullptr;
+        size_t sqMapSize = 0;
+        size_t cqMapSize = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqesSize = 0;
+        unsigned* sqHead = nullptr;
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        unsigned entries = 0;
+        unsigned unsubmitted = 0;
+        unsigned inflight = 0;
+        std::deque<size_t> queued; // requests waiting for a free entry
+
+        bool init()
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, ENTRIES, &params));
+            if(fd < 0) return false;
+            entries = params.sq_entries;
+            sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if(singleMap) sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+            sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if(sqMap == MAP_FAILED)
+            {
+                sqMap = nullptr;
+                return false;
+            }
+            if(singleMap) cqMap = sqMap;
+            else
+            {
+                cqMap = mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if(cqMap == MAP_FAILED)
+                {
+                    cqMap = nullptr;
+                    return false;
+                }
+            }
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if(sqeMap == MAP_FAILED) return false;
+            sqes = static_cast<io_uring_sqe*>(sqeMap);
+            unsigned char* sq = static_cast<unsigned char*>(sqMap);
+            unsigned char* cq = static_cast<unsigned char*>(cqMap);
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        ~IOUring()
+        {
+            if(sqes) munmap(sqes, sqesSize);
+            if(cqMap && cqMap != sqMap) munmap(cqMap, cqMapSize);
+            if(sqMap) munmap(sqMap, sqMapSize);
+            if(fd >= 0) ::close(fd);
+        }
+
+        // put the next chunk of a request into the submission queue
+        void prepare(ReadState::Request& request, size_t id)
+        {
+            unsigned tail = *sqTail;
+            unsigned index = tail & *sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = request.fd;
+            sqe.off = request.offset;
+            sqe.addr = reinterpret_cast<unsigned long long>(request.data.data() + request.offset);
+            sqe.len = static_cast<unsigned>(std::min(request.data.size() - request.offset, size_t(MAX_READ)));
+            sqe.user_data = id;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            unsubmitted++;
+            inflight++;
+        }
+
+        // move queued requests into free entries
+        void fill(ReadState& state)
+        {
+            while(!queued.empty() && inflight < entries)
+            {
+                size_t id = queued.front();
+                queued.pop_front();
+                prepare(state.requests[id], id);
+            }
+        }
+
+        // submit prepared entries and optionally wait for one completion
+        void enter(bool wait)
+        {
+            unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+            for(;;)
+            {
+                long result = syscall(__NR_io_uring_enter, fd, unsubmitted, wait ? 1u : 0u, flags, nullptr, 0);
+                if(result >= 0)
+                {
+                    unsubmitted -= std::min(unsubmitted, static_cast<unsigned>(result));
+                    if(!unsubmitted || !wait) return;
+                    continue;
+                }
+                if(errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                throw std::runtime_error("ERROR: io_uring_enter failed with errno " + std::to_string(errno));
+            }
+        }
+
+        // handle every completion in the queue, requeue partial reads unless draining
+        void reap(ReadState& state, bool draining)
+        {
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for(; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                size_t id = static_cast<size_t>(cqe.user_data);
+                int result = cqe.res;
+                inflight--;
+                auto& request = state.requests[id];
+                if(draining)
+                {
+                    ::close(request.fd);
+                    request.fd = -1;
+                    continue;
+                }
+                if(result == -EINTR || result == -EAGAIN)
+                {
+                    queued.push_back(id);
+                    continue;
+                }
+                if(result > 0)
+                {
+                    request.offset += static_cast<size_t>(result);
+                    if(request.offset < request.data.size())
+                    {
+                        queued.push_back(id);
+                        continue;
+                    }
+                }
+                ::close(request.fd);
+                request.fd = -1;
+                if(result == -EINVAL || result == -EOPNOTSUPP)
+                {
+                    // kernel without IORING_OP_READ
+                    readWhole(request);
+                    completeRead(state, id, request.failed);
+                }
+                else if(result < 0) completeRead(state, id, true);
+                else
+                {
+                    // end of file reached early, the file shrank since it was opened
+                    request.data.resize(request.offset);
+                    completeRead(state, id, false);
+                }
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+    };
+#endif
+}
+
+ReadBatch::ReadBatch(UTILS::ThreadPool* pool) : p_state(std::make_shared<State>()), p_pool(pool)
+{
+}
+
+ReadBatch::~ReadBatch()
+{
+#ifdef FILES_IO_URING
+    if(p_ring)
+    {
+        IOUring* ring = static_cast<IOUring*>(p_ring);
+        // reads still in flight write into the request buffers
+        try
+        {
+            while(ring->inflight)
+            {
+                ring->enter(true);
+                ring->reap(*p_state, true);
+            }
+        }
+        catch(...)
+        {
+        }
+        for(auto& request : p_state->requests)
+            if(request.fd >= 0) ::close(request.fd);
+        delete ring;
+        p_ring = nullptr;
+        return;
+    }
+#endif
+    if(p_pool && p_state->submitted)
+    {
+        // stop new claims, then wait for the claimed reads
+        size_t count = p_state->requests.size();
+        size_t claimed = std::min(p_state->next.exchange(count), count);
+        std::unique_lock<std::mutex> lock(p_state->mutex);
+        p_state->condition.wait(lock, [&](){return p_state->finished >= claimed;});
+    }
+}
+
+size_t ReadBatch::add(const std::string& filePath)
+{
+    if(p_state->submitted)
+        throw std::runtime_error("ERROR: cannot add files to a submitted read batch");
+    auto found = p_state->ids.find(filePath);
+    if(found != p_state->ids.end()) return found->second;
+    size_t id = p_state->requests.size();
+    p_state->requests.emplace_back();
+    p_state->requests.back().path = filePath;
+    p_state->ids[filePath] = id;
+    return id;
+}
+
+void ReadBatch::submit()
+{
+    State& state = *p_state;
+    if(state.submitted) return;
+    state.submitted = true;
+    if(state.requests.empty()) return;
+#ifdef FILES_IO_URING
+    IOUring* ring = new IOUring();
+    if(!ring->init())
+    {
+        delete ring;
+        ring = nullptr;
+    }
+    if(ring)
+    {
+        p_ring = ring;
+        for(size_t i = 0; i < state.requests.size(); i++)
+        {
+            auto& request = state.requests[i];
+            std::string path = std::string(GLOB_FILE_FOLDER) + "/" + request.path;
+            request.fd = ::open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if(request.fd < 0 || fstat(request.fd, &info) != 0)
+            {
+                if(request.fd >= 0) ::close(request.fd);
+                request.fd = -1;
+                completeRead(state, i, true);
+                continue;
+            }
+            request.data.resize(static_cast<size_t>(info.st_size));
+            if(request.data.empty())
+            {
+                ::close(request.fd);
+                request.fd = -1;
+                completeRead(state, i, false);
+                continue;
+            }
+            ring->queued.push_back(i);
+        }
+        state.next = state.requests.size();
+        ring->fill(state);
+        ring->enter(false);
+        return;
+    }
+#endif
+    if(p_pool)
+    {
+        // helpers may start after every read was claimed, in which case they only touch the state
+        std::shared_ptr<State> shared = p_state;
+        size_t helpers = std::min(state.requests.size(), p_pool->size());
+        for(size_t i = 0; i < helpers; i++)
+            p_pool->submit([shared](){while(readClaimed(*shared));});
+        return;
+    }
+    while(readClaimed(state));
+}
+
+void ReadBatch::waitAny()
+{
+    State& state = *p_state;
+#ifdef FILES_IO_URING
+    if(p_ring)
+    {
+        IOUring* ring = static_cast<IOUring*>(p_ring);
+        if(!ring->inflight) return;
+        ring->enter(true);
+        ring->reap(state, false);
+        ring->fill(state);
+        ring->enter(false);
+        return;
+    }
+#endif
+    size_t seen;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        seen = state.finished;
+    }
+    // read a file here instead of blocking a pool thread
+    if(readClaimed(state)) return;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.condition.wait(lock, [&](){return state.finished != seen || state.finished == state.requests.size();});
+}
+
+bool ReadBatch::next(size_t& id)
+{
+    State& state = *p_state;
+    if(!state.submitted) submit();
+    for(;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            while(!state.completed.empty())
+            {
+                size_t completed = state.completed.front();
+                state.completed.pop_front();
+                if(state.requests[completed].taken) continue;
+                state.requests[completed].taken = true;
+                state.taken++;
+                id = completed;
+                return true;
+            }
+            if(state.taken == state.requests.size()) return false;
+        }
+        waitAny();
+    }
+}
+
+void ReadBatch::wait(size_t id)
+{
+    State& state = *p_state;
+    if(!state.submitted) submit();
+    for(;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            auto& request = state.requests[id];
+            if(request.done)
+            {
+                if(!request.taken)
+                {
+                    request.taken = true;
+                    state.taken++;
+                }
+                return;
+            }
+        }
+        waitAny();
+    }
+}
+
+bool ReadBatch::find(const std::string& filePath, size_t& id) const
+{
+    auto found = p_state->ids.find(filePath);
+    if(found == p_state->ids.end()) return false;
+    id = found->second;
+    return true;
+}
+
+size_t ReadBatch::size() const
+{
+    return p_state->requests.size();
+}
+
+const std::string& ReadBatch::path(size_t id) const
+{
+    return p_state->requests[id].path;
+}
+
+bool ReadBatch::failed(size_t id) const
+{
+    return p_state->requests[id].failed;
+}
+
+std::vector<unsigned char>& ReadBatch::data(size_t id)
+{
+    return p_state->requests[id].data;
+}
@@ -1,29 +1,56 @@
 #include "data.hpp"
 #include "files.hpp"
+#include "texture.hpp"
+#include "convert.hpp"
+#include "mesh.hpp"
 #include "ui.hpp"
+#include "upload.hpp"
 
 #include "global.hpp"
 extern Application* app;
 
 #include <stdexcept>
-
-#include <stb_image.h>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
 
 using namespace DATA;
 
 Graph::Graph(std::vector<GraphUserInput>& meshes, VkDevice backendDevice)
 {
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+    d_time_created = std::chrono::steady_clock::now();
     d_device = backendDevice;
+    d_vertex_format = app->GRAPH_VERTEX_FORMAT;
+	initUploads();
 	initTextures();
     convertInputMeshes(meshes);
-    createIndiceBuffers(meshes);
+    deduplicateGeometry(meshes);
+    optimizeMeshes(meshes);
+    createMeshlets(meshes);
+    createMeshLods(meshes);
+    // same order as the loader, vertex format and then the indice regions
     createVertexBuffers(meshes);
+    createIndiceBuffers(meshes);
+    createInstanceBatches();
+    createMaterials();
     createUniformBuffers();
     createDescriptorSets();
+	p_uploads->submit();
+
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "graph uploads: " + p_uploads->describe());}
 }
 
 Graph::~Graph()
 {
+	// decode tasks still queued skip their work
+	if(p_texture_stream)
+		p_texture_stream->cancelled = true;
+	// waits for uploads still in flight
+	delete p_uploads;
+	p_uploads = nullptr;
 	for(auto& node : d_nodes)
 	{
 		node->destroy();
@@ -31,51 +58,108 @@ Graph::~Graph()
 	}
 	for(auto& mesh : d_meshes)
 		delete mesh;
-    app->GetRenderer()->freeRenderCommandBuffers(d_commands);
+    freeRenderCommandBuffers();
 	for(auto& tex : d_unique_textures)
 		tex.destroy(d_device);
-	for(auto& buffer : d_ubo_buffers)
-        buffer.destroy(d_device);
-	for(auto& buffers : d_node_uniform_buffers)
-	{
-		for(auto& buffer : buffers)
-			buffer.destroy(d_device);
-	}
+	for(auto& sampler : d_samplers)
+		vkDestroySampler(d_device, sampler.second, nullptr);
+	d_frame_buffer.destroy(d_device);
     d_indice_buffer.destroy(d_device);
     d_vertex_buffer.destroy(d_device);
-	vkFreeDescriptorSets(d_device, d_descriptor_pool, static_cast<uint32_t>(d_descriptor_ubo.size()), d_descriptor_ubo.data());
-	for(auto& sets : d_descriptor_per_mesh)
-		vkFreeDescriptorSets(d_device, d_descriptor_pool, static_cast<uint32_t>(sets.size()), sets.data());
+	// frees the descriptor sets
 	vkDestroyDescriptorPool(d_device, d_descriptor_pool, nullptr);
 	vkDestroyDescriptorSetLayout(d_device, d_descriptor_layout, nullptr);
+	vkDestroyDescriptorSetLayout(d_device, d_material_layout, nullptr);
     d_device = VK_NULL_HANDLE;
 }
 
+void Graph::initUploads()
+{
+	BASE::Backend* backend = app->GetBackend();
+	uint32_t graphicsFamilyID = backend->getQueueFamilies(backend->d_physical_device).graphicsFamilyID;
+	// falls back to the graphics queue without a transfer queue
+	p_uploads = new UploadQueue(d_device, backend->d_graphics_queue, graphicsFamilyID,
+		backend->d_transfer_queue, backend->d_transfer_family_id, app->GRAPH_UPLOAD_RING_SIZE);
+}
+
 void Graph::initTextures()
 {
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
 	d_unique_textures.resize(0);
 	Texture emptyTexture;
 	VkDeviceSize emptyTextureSize = 1 * 1 * 4; // 4 channels
 	unsigned char pixels[] = {0, 0, 0, 0};
-	Buffer stagingBuffer = createBuffer(emptyTextureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	void* data;
-	vkMapMemory(d_device, stagingBuffer.mem, 0, emptyTextureSize, 0, &data);
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	unsigned char* data = p_uploads->stage(emptyTextureSize, 16, stagingBuffer, stagingOffset);
     memcpy(data, pixels, static_cast<size_t>(emptyTextureSize));
-    vkUnmapMemory(d_device, stagingBuffer.mem);
 	emptyTexture.image = createTextureImage(1, 1, 1, VK_FORMAT_R8G8B8A8_SRGB,
-    	VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, stagingBuffer.buf);
+    	VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		stagingBuffer, stagingOffset);
+	SamplerParams emptyParams;
+	emptyParams.filter = VK_FILTER_NEAREST;
+	emptyParams.mipmaps = false;
+	emptyParams.anisotropy = false;
+	emptyTexture.sampler = findSampler(emptyParams);
+	emptyTexture.allset = true;
+	d_unique_textures.push_back(emptyTexture);
+
+	// the cache stores pre-mipped textures, so the chains are built on the CPU along with decoding
+	// without the cache the mip chains are blitted on the GPU instead, unless the texture is compressed
+	d_texture_target = TextureTarget();
+	d_texture_target.mipmap = app->GRAPH_ENABLE_SCENE_CACHE;
+	d_texture_target.compress = app->GRAPH_COMPRESS_TEXTURES;
+	for(VkFormat format : getTextureBlockFormats())
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(app->GetBackend()->d_physical_device, format, &properties);
+		if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+			d_texture_target.blockFormats.push_back(format);
+	}
+	d_texture_bytes = d_texture_bytes_uncompressed = 0;
+	if(d_texture_target.compress)
+		if(myLogger){myLogger->AddMessage(myLoggerOwner, "texture block compression enabled, color textures are encoded lossily into BC1/BC3, data maps stay uncompressed");}
+}
+
+VkSampler Graph::findSampler(const SamplerParams& params)
+{
+	auto found = d_samplers.find(params);
+	if(found != d_samplers.end())
+		return found->second;
+
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = params.filter;
+	samplerInfo.minFilter = params.filter;
+	samplerInfo.addressModeU = params.addressMode;
+	samplerInfo.addressModeV = params.addressMode;
+	samplerInfo.addressModeW = params.addressMode;
+	samplerInfo.anisotropyEnable = params.anisotropy ? VK_TRUE : VK_FALSE;
+	samplerInfo.maxAnisotropy = params.anisotropy ? 16.0f : 1.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 1;
-	if (vkCreateSampler(d_device, &samplerInfo, nullptr, &emptyTexture.sampler) != VK_SUCCESS)
-		throw std::runtime_error("ERROR: failed to create empty Vulkan texture sampler!");
-	emptyTexture.allset = true;
-	stagingBuffer.destroy(d_device);
-	d_unique_textures.push_back(emptyTexture);
+	// no clamp, so textures with any number of levels can share the sampler
+	samplerInfo.maxLod = params.mipmaps ? VK_LOD_CLAMP_NONE : 0.0f;
+
+	VkSampler sampler;
+	if (vkCreateSampler(d_device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		throw std::runtime_error("ERROR: failed to create Vulkan texture sampler!");
+	d_samplers[params] = sampler;
+	return sampler;
+}
+
+std::string Graph::describeTextureMemory()
+{
+	std::stringstream ss;
+	ss << (d_texture_bytes >> 10) << " KB of texture memory (" << (d_texture_bytes_uncompressed >> 10) << " KB uncompressed)";
+	return ss.str();
 }
 
 void Graph::convertInputMeshes(std::vector<GraphUserInput>& meshes)
@@ -88,22 +172,18 @@ void Graph::convertInputMeshes(std::vector<GraphUserInput>& meshes)
 	uint32_t meshCount = 0;
 
 	// preload all unique textures
+	// IDs follow the set order, which is also the order textures are created in
 	std::map<std::string, size_t> texturePathMap;
 	texturePathMap[""] = 0;
 	std::set<std::string> texturePaths;
-	size_t textureID = 1; // 0 is saved for the empty texture
 	for(auto& mesh : meshes)
 	{
 		if(mesh.textureImagePath != "")
-		{
-			if(texturePaths.find(mesh.textureImagePath) == texturePaths.end())
-			{
-				texturePaths.insert(mesh.textureImagePath);
-				texturePathMap[mesh.textureImagePath] = textureID;
-				textureID += 1;
-			}
-		}
+			texturePaths.insert(mesh.textureImagePath);
 	}
+	size_t textureID = d_unique_textures.size(); // 0 is saved for the empty texture
+	for(auto& path : texturePaths)
+		texturePathMap[path] = textureID++;
 	createTexturesFromPaths(texturePaths);
 
 	d_meshes.resize(0);
@@ -127,6 +207,7 @@ void Graph::convertInputMeshes(std::vector<GraphUserInput>& meshes)
 			newMesh->indiceStart = 0;
 		}
 		newMesh->meshID = meshCount;
+		newMesh->geometryID = meshCount;
 		newMesh->nodeID = 0; // only one default node
 		newMesh->texBase = texturePathMap[mesh.textureImagePath];
 		d_meshes.push_back(newMesh);
@@ -146,37 +227,260 @@ void Graph::convertInputMeshes(std::vector<GraphUserInput>& meshes)
 	if(myLogger){myLogger->AddMessage(myLoggerOwner, "user input graph converted");}
 }
 
+void Graph::deduplicateGeometry(std::vector<GraphUserInput>& meshes)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+	// approximate GPU size of a mesh, indices are 16 bit for small meshes
+	size_t stride = getVertexFormatStride(d_vertex_format);
+	auto meshBytes = [stride](const GraphUserInput& mesh)
+	{
+		return mesh.vertices.size() * stride + mesh.indices.size() * (mesh.vertices.size() < 65536 ? sizeof(uint16_t) : sizeof(uint32_t));
+	};
+
+	// hash on the workers, compare on the calling thread
+	size_t uniqueCount = meshes.size();
+	std::vector<uint32_t> remap(meshes.size());
+	for(size_t i = 0; i < meshes.size(); i++) remap[i] = static_cast<uint32_t>(i);
+	if(app->GRAPH_DEDUPLICATE_GEOMETRY && meshes.size() > 1)
+	{
+		std::vector<uint64_t> hashes(meshes.size());
+		auto hashMesh = [&](size_t i)
+		{
+			uint64_t hash = FILES::hash_bytes(meshes[i].vertices.data(), sizeof(Vertex) * meshes[i].vertices.size());
+			hashes[i] = FILES::hash_bytes(meshes[i].indices.data(), sizeof(uint32_t) * meshes[i].indices.size(), hash);
+		};
+		UTILS::ThreadPool* pool = app->GetThreadPool();
+		if(pool) pool->parallelFor(meshes.size(), hashMesh);
+		else
+		{
+			for(size_t i = 0; i < meshes.size(); i++)
+				hashMesh(i);
+		}
+
+		// equal hashes are confirmed byte by byte
+		std::multimap<uint64_t, uint32_t> uniqueHashes;
+		std::vector<GraphUserInput> uniqueMeshes;
+		for(size_t i = 0; i < meshes.size(); i++)
+		{
+			const GraphUserInput& mesh = meshes[i];
+			bool merged = false;
+			auto range = uniqueHashes.equal_range(hashes[i]);
+			for(auto it = range.first; it != range.second && !merged; it++)
+			{
+				const GraphUserInput& other = uniqueMeshes[it->second];
+				if(other.vertices.size() == mesh.vertices.size() && other.indices.size() == mesh.indices.size() &&
+					memcmp(other.vertices.data(), mesh.vertices.data(), sizeof(Vertex) * mesh.vertices.size()) == 0 &&
+					memcmp(other.indices.data(), mesh.indices.data(), sizeof(uint32_t) * mesh.indices.size()) == 0)
+				{
+					remap[i] = it->second;
+					merged = true;
+				}
+			}
+			if(merged) continue;
+			remap[i] = static_cast<uint32_t>(uniqueMeshes.size());
+			uniqueHashes.insert(std::make_pair(hashes[i], remap[i]));
+			uniqueMeshes.push_back(std::move(meshes[i]));
+		}
+		meshes = std::move(uniqueMeshes);
+		for(Mesh* mesh : d_meshes)
+			mesh->geometryID = remap[mesh->geometryID];
+		layoutMeshes(meshes);
+	}
+
+	// memory of every mesh as if it had its own copy, against the shared data
+	size_t bytesShared = 0;
+	size_t bytesTotal = 0;
+	for(auto& mesh : meshes)
+		bytesShared += meshBytes(mesh);
+	for(Mesh* mesh : d_meshes)
+		bytesTotal += meshBytes(meshes[mesh->geometryID]);
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, std::to_string(d_meshes.size()) + " meshes share " + std::to_string(meshes.size()) +
+		" unique geometries (" + std::to_string(uniqueCount - meshes.size()) + " merged by content hash), saved " +
+		std::to_string(bytesTotal - bytesShared) + " bytes");}
+}
+
+void Graph::layoutMeshes(const std::vector<GraphUserInput>& meshes)
+{
+	// vertices and indices of unique data are stored back to back in the same order
+	std::vector<uint32_t> vertexStarts(meshes.size(), 0);
+	std::vector<uint32_t> indiceStarts(meshes.size(), 0);
+	for(size_t i = 1; i < meshes.size(); i++)
+	{
+		vertexStarts[i] = vertexStarts[i - 1] + static_cast<uint32_t>(meshes[i - 1].vertices.size());
+		indiceStarts[i] = indiceStarts[i - 1] + static_cast<uint32_t>(meshes[i - 1].indices.size());
+	}
+	for(Mesh* mesh : d_meshes)
+	{
+		const GraphUserInput& geometry = meshes[mesh->geometryID];
+		mesh->vertexStart = vertexStarts[mesh->geometryID];
+		mesh->vertexCount = static_cast<uint32_t>(geometry.vertices.size());
+		mesh->indiceStart = indiceStarts[mesh->geometryID];
+		mesh->indiceCount = static_cast<uint32_t>(geometry.indices.size());
+	}
+}
+
+void Graph::optimizeMeshes(std::vector<GraphUserInput>& meshes)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+	bool weld = app->GRAPH_WELD_MESHES;
+	bool optimize = app->GRAPH_OPTIMIZE_MESHES;
+	if(!weld && !optimize) return;
+	auto timeStart = std::chrono::steady_clock::now();
+
+	// approximate GPU size of a mesh, indices are 16 bit for small meshes
+	size_t stride = getVertexFormatStride(d_vertex_format);
+	auto meshBytes = [stride](const GraphUserInput& mesh)
+	{
+		return mesh.vertices.size() * stride + mesh.indices.size() * (mesh.vertices.size() < 65536 ? sizeof(uint16_t) : sizeof(uint32_t));
+	};
+	size_t bytesBefore = 0;
+	size_t verticesBefore = 0;
+	for(auto& mesh : meshes)
+	{
+		bytesBefore += meshBytes(mesh);
+		verticesBefore += mesh.vertices.size();
+	}
+
+	// meshes are independent, so they are processed on the workers
+	float epsilon = app->GRAPH_WELD_EPSILON;
+	std::vector<VertexCacheStatistics> before(meshes.size());
+	std::vector<VertexCacheStatistics> after(meshes.size());
+	auto process = [&](size_t i)
+	{
+		if(weld) weldVertices(meshes[i].vertices, meshes[i].indices, epsilon);
+		if(optimize) optimizeMesh(meshes[i], &before[i], &after[i]);
+	};
+	UTILS::ThreadPool* pool = app->GetThreadPool();
+	if(pool) pool->parallelFor(meshes.size(), process);
+	else
+	{
+		for(size_t i = 0; i < meshes.size(); i++)
+			process(i);
+	}
+
+	layoutMeshes(meshes);
+	size_t bytesAfter = 0;
+	size_t verticesAfter = 0;
+	for(auto& mesh : meshes)
+	{
+		bytesAfter += meshBytes(mesh);
+		verticesAfter += mesh.vertices.size();
+	}
+
+	if(myLogger)
+	{
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(3);
+		ss << "meshes processed in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - timeStart).count() << " ms";
+		myLogger->AddMessage(myLoggerOwner, ss.str());
+		if(weld)
+		{
+			ss.str("");
+			ss << "meshes welded, " << verticesBefore << " -> " << verticesAfter << " vertices, " << bytesBefore << " -> " << bytesAfter
+			   << " bytes (" << (bytesBefore >= bytesAfter ? "saved " : "added ") << (bytesBefore >= bytesAfter ? bytesBefore - bytesAfter : bytesAfter - bytesBefore) << " bytes)";
+			myLogger->AddMessage(myLoggerOwner, ss.str());
+		}
+		if(optimize)
+		{
+			VertexCacheStatistics totalBefore, totalAfter;
+			for(size_t i = 0; i < meshes.size(); i++)
+			{
+				totalBefore.add(before[i]);
+				totalAfter.add(after[i]);
+			}
+			ss.str("");
+			ss << "meshes optimized (" << totalBefore.triangles << " triangles), ACMR " << totalBefore.acmr() << " -> " << totalAfter.acmr()
+			   << ", ATVR " << totalBefore.atvr() << " -> " << totalAfter.atvr();
+			myLogger->AddMessage(myLoggerOwner, ss.str());
+		}
+	}
+}
+
 void Graph::createUniformBuffers()
 {
 	LOGGING::Logger* myLogger = app->GetLogger();
     LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-    VkDeviceSize bufferSize = sizeof(CameraUniform);
-	
 	size_t swapChainImagesCount = app->GetRenderer()->getSwapChainImagesCount();
 
-    d_ubo_buffers.resize(swapChainImagesCount);
-    for(size_t i = 0; i < swapChainImagesCount; i++)
-    {
-        d_ubo_buffers[i] = createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    }
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(app->GetBackend()->d_physical_device, &properties);
+	VkDeviceSize uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+	VkDeviceSize storageAlignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+	// slots never share a non-coherent atom, so flushing one does not touch its neighbours
+	VkDeviceSize slotAlignment = std::max(std::max(uniformAlignment, storageAlignment), std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1));
+	auto alignUp = [](VkDeviceSize offset, VkDeviceSize alignment) { return (offset + alignment - 1) / alignment * alignment; };
+
+	// linear sub-allocation of one slot, every mesh is drawn at most once per frame
+	VkDeviceSize offset = 0;
+	d_frame_camera_offset = offset;
+	offset += sizeof(CameraUniform);
+	d_frame_transform_offset = offset = alignUp(offset, storageAlignment);
+	offset += sizeof(NodeTransformData) * std::max<size_t>(d_nodes.size(), 1);
+	d_frame_instance_offset = offset = alignUp(offset, storageAlignment);
+	offset += sizeof(InstanceData) * std::max<size_t>(d_meshes.size(), 1);
+	d_frame_slot_size = alignUp(offset, slotAlignment);
+
+	// mapped once, the frame loop writes through the mapped pointer
+	d_frame_buffer = createBuffer(d_frame_slot_size * swapChainImagesCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	d_frame_transform_version.assign(swapChainImagesCount, 0);
+
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "frame buffer created, " + std::to_string(swapChainImagesCount) + " slots of " +
+		std::to_string(d_frame_slot_size) + " bytes");}
+}
+
+unsigned char* Graph::frameData(uint32_t imageID, VkDeviceSize offset)
+{
+	return d_frame_buffer.mem.mapped + d_frame_slot_size * imageID + offset;
+}
+
+void Graph::flushFrameData(uint32_t imageID, VkDeviceSize offset, VkDeviceSize size)
+{
+	d_frame_buffer.mem.allocator->flush(d_frame_buffer.mem, d_frame_slot_size * imageID + offset, size);
+}
+
+void Graph::updateFrameData(uint32_t imageID)
+{
+	memcpy(frameData(imageID, d_frame_camera_offset), &d_ubo_data, sizeof(CameraUniform));
+	flushFrameData(imageID, d_frame_camera_offset, sizeof(CameraUniform));
 
-	d_node_uniform_buffers.resize(d_nodes.size());
-	bufferSize = sizeof(NodeUniformData);
-	for(auto& buffers : d_node_uniform_buffers)
+	if(d_frame_transform_version[imageID] == d_node_transform_version) return;
+	NodeTransformData* transforms = reinterpret_cast<NodeTransformData*>(frameData(imageID, d_frame_transform_offset));
+	for(auto& node : d_nodes)
 	{
-		buffers.resize(swapChainImagesCount);
-		for(size_t i = 0; i < swapChainImagesCount; i++)
-    	{
-        	buffers[i] = createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    	}
+		glm::mat4 world = node->transformMat;
+		for(Node* ptr = node->parentNode; ptr; ptr = ptr->parentNode)
+			world = ptr->transformMat * world;
+		transforms[node->nodeID].world = world;
 	}
+	flushFrameData(imageID, d_frame_transform_offset, sizeof(NodeTransformData) * d_nodes.size());
+	d_frame_transform_version[imageID] = d_node_transform_version;
+}
 
-	d_node_uniform_buffers_need_update = true;
+void Graph::createMaterials()
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-	if(myLogger){myLogger->AddMessage(myLoggerOwner, "uniform buffers created");}
+	d_material_textures.clear();
+	d_mesh_materials.resize(d_meshes.size());
+	std::map<std::array<uint32_t, 5>, uint32_t> materials;
+	for(size_t i = 0; i < d_meshes.size(); i++)
+	{
+		const Mesh* mesh = d_meshes[i];
+		std::array<uint32_t, 5> textures = {{mesh->texBase, mesh->texRough, mesh->texNormal, mesh->texOcclusion, mesh->texEmissive}};
+		auto inserted = materials.insert(std::make_pair(textures, static_cast<uint32_t>(d_material_textures.size())));
+		if(inserted.second)
+			d_material_textures.push_back(textures);
+		d_mesh_materials[i] = inserted.first->second;
+	}
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "materials created, " + std::to_string(d_meshes.size()) + " meshes use " +
+		std::to_string(d_material_textures.size()) + " texture sets");}
 }
 
 void Graph::createDescriptorSets()
@@ -185,76 +489,83 @@ void Graph::createDescriptorSets()
     LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
 	size_t swapChainImagesCount = app->GetRenderer()->getSwapChainImagesCount();
+	size_t materialCount = std::max<size_t>(d_material_textures.size(), 1);
+	const uint32_t textureBindings = 5; // binding 2 to 6
 
-    std::array<VkDescriptorPoolSize, 2> poolSize{};
+	// one frame set per image and one texture set per material and image, independent of the node count
+    std::array<VkDescriptorPoolSize, 3> poolSize{};
 	poolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize[0].descriptorCount = static_cast<uint32_t>((1 + d_meshes.size()) * swapChainImagesCount);
+	poolSize[0].descriptorCount = static_cast<uint32_t>(swapChainImagesCount);
 	poolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSize[1].descriptorCount = static_cast<uint32_t>(d_unique_textures.size() * swapChainImagesCount);
+	poolSize[1].descriptorCount = static_cast<uint32_t>(textureBindings * materialCount * swapChainImagesCount);
+	poolSize[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize[2].descriptorCount = static_cast<uint32_t>(2 * swapChainImagesCount);
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
 	poolInfo.pPoolSizes = poolSize.data();
-	poolInfo.maxSets = static_cast<uint32_t>((d_meshes.size() + 1) * swapChainImagesCount);
+	poolInfo.maxSets = static_cast<uint32_t>((1 + materialCount) * swapChainImagesCount);
 
 	if (vkCreateDescriptorPool(d_device, &poolInfo, nullptr, &d_descriptor_pool) != VK_SUCCESS)
 		throw std::runtime_error("ERROR: failed to create Vulkan descriptor pool!");
     if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan descriptor pool created");}
 
-	std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
-
-	bindings[0].binding = 0;
-	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	bindings[0].descriptorCount = 1;
-	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	bindings[0].pImmutableSamplers = nullptr;
-
-	bindings[1].binding = 1;
-	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	bindings[1].descriptorCount = 1;
-	bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	bindings[1].pImmutableSamplers = nullptr;
-
-	bindings[2].binding = 2;
-	bindings[2].descriptorCount = 1;
-	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	bindings[2].pImmutableSamplers = nullptr;
-	bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	bindings[3].binding = 3;
-	bindings[3].descriptorCount = 1;
-	bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	bindings[3].pImmutableSamplers = nullptr;
-	bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	bindings[4].binding = 4;
-	bindings[4].descriptorCount = 1;
-	bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	bindings[4].pImmutableSamplers = nullptr;
-	bindings[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	bindings[5].binding = 5;
-	bindings[5].descriptorCount = 1;
-	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	bindings[5].pImmutableSamplers = nullptr;
-	bindings[5].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	bindings[6].binding = 6;
-	bindings[6].descriptorCount = 1;
-	bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	bindings[6].pImmutableSamplers = nullptr;
-	bindings[6].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	VkDescriptorSetLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
-
-	if (vkCreateDescriptorSetLayout(d_device, &layoutInfo, nullptr, &d_descriptor_layout) != VK_SUCCESS)
-		throw std::runtime_error("ERROR: failed to create Vulkan descriptor set layout!");
-
-    if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan descriptor set layout 0 created");}
+	// layouts outlive swap chain recreation, the pipeline layout is built from them
+	if(d_descriptor_layout == VK_NULL_HANDLE)
+	{
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[0].pImmutableSamplers = nullptr;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[1].pImmutableSamplers = nullptr;
+
+		bindings[2].binding = 7;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[2].pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(d_device, &layoutInfo, nullptr, &d_descriptor_layout) != VK_SUCCESS)
+			throw std::runtime_error("ERROR: failed to create Vulkan descriptor set layout!");
+
+		if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan descriptor set layout 0 created");}
+	}
+	if(d_material_layout == VK_NULL_HANDLE)
+	{
+		std::array<VkDescriptorSetLayoutBinding, textureBindings> bindings{};
+		for(uint32_t k = 0; k < textureBindings; k++)
+		{
+			bindings[k].binding = 2 + k;
+			bindings[k].descriptorCount = 1;
+			bindings[k].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[k].pImmutableSamplers = nullptr;
+			bindings[k].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(d_device, &layoutInfo, nullptr, &d_material_layout) != VK_SUCCESS)
+			throw std::runtime_error("ERROR: failed to create Vulkan descriptor set layout!");
+
+		if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan descriptor set layout 1 created");}
+	}
 
 	std::vector<VkDescriptorSetLayout> layouts(swapChainImagesCount, d_descriptor_layout);
 
@@ -264,179 +575,157 @@ void Graph::createDescriptorSets()
 	allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImagesCount);
 	allocInfo.pSetLayouts = layouts.data();
 
-	d_descriptor_ubo.resize(swapChainImagesCount);
-	if (vkAllocateDescriptorSets(d_device, &allocInfo, d_descriptor_ubo.data()) != VK_SUCCESS)
+	d_descriptor_frame.resize(swapChainImagesCount);
+	if (vkAllocateDescriptorSets(d_device, &allocInfo, d_descriptor_frame.data()) != VK_SUCCESS)
 		throw std::runtime_error("ERROR: failed to allocate Vulkan descriptor sets!");
 
-	d_descriptor_per_mesh.resize(d_meshes.size());
-    for(size_t i = 0; i < d_meshes.size(); i++)
-    {
-		d_descriptor_per_mesh[i].resize(swapChainImagesCount);
-		if (vkAllocateDescriptorSets(d_device, &allocInfo, d_descriptor_per_mesh[i].data()) != VK_SUCCESS)
-			throw std::runtime_error("ERROR: failed to allocate Vulkan descriptor sets!");
-
-		for(size_t j = 0; j < swapChainImagesCount; j++)
+	for(size_t j = 0; j < swapChainImagesCount; j++)
+	{
+		// ranges of the frame slot of the image
+		VkDeviceSize slot = d_frame_slot_size * j;
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+		// camera uniform
+		bufferInfos[0].buffer = d_frame_buffer.buf;
+		bufferInfos[0].offset = slot + d_frame_camera_offset;
+		bufferInfos[0].range = sizeof(CameraUniform);
+		// node transforms
+		bufferInfos[1].buffer = d_frame_buffer.buf;
+		bufferInfos[1].offset = slot + d_frame_transform_offset;
+		bufferInfos[1].range = d_frame_instance_offset - d_frame_transform_offset;
+		// instance data
+		bufferInfos[2].buffer = d_frame_buffer.buf;
+		bufferInfos[2].offset = slot + d_frame_instance_offset;
+		bufferInfos[2].range = d_frame_slot_size - d_frame_instance_offset;
+
+		const uint32_t bindings[] = {0, 1, 7};
+		std::array<VkWriteDescriptorSet, 3> descriptorWrite{};
+		for(size_t k = 0; k < descriptorWrite.size(); k++)
 		{
-			std::vector<VkWriteDescriptorSet> descriptorWrite;
+			descriptorWrite[k].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite[k].dstSet = d_descriptor_frame[j];
+			descriptorWrite[k].dstBinding = bindings[k];
+			descriptorWrite[k].dstArrayElement = 0;
+			descriptorWrite[k].descriptorType = k ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrite[k].descriptorCount = 1;
+			descriptorWrite[k].pBufferInfo = &bufferInfos[k];
+		}
+		vkUpdateDescriptorSets(d_device, static_cast<uint32_t>(descriptorWrite.size()), descriptorWrite.data(), 0, nullptr);
+	}
 
-			// camera uniform
-			{
-				VkDescriptorBufferInfo bufferInfo{};
-				bufferInfo.buffer = d_ubo_buffers[j].buf;
-				bufferInfo.offset = 0;
-				bufferInfo.range = sizeof(CameraUniform);
-
-				VkWriteDescriptorSet writeUniform;
-				writeUniform.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeUniform.dstSet = d_descriptor_per_mesh[i][j];
-				writeUniform.dstBinding = 0;
-				writeUniform.dstArrayElement = 0;
-				writeUniform.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				writeUniform.descriptorCount = 1;
-				writeUniform.pBufferInfo = &bufferInfo;
-				writeUniform.pImageInfo = nullptr;
-				writeUniform.pTexelBufferView = nullptr;
-				writeUniform.pNext = nullptr;
-
-				descriptorWrite.push_back(writeUniform);
-			}
+	layouts.assign(swapChainImagesCount, d_material_layout);
+	d_descriptor_per_material.resize(d_material_textures.size());
+	for(auto& sets : d_descriptor_per_material)
+	{
+		sets.resize(swapChainImagesCount);
+		if (vkAllocateDescriptorSets(d_device, &allocInfo, sets.data()) != VK_SUCCESS)
+			throw std::runtime_error("ERROR: failed to allocate Vulkan descriptor sets!");
+	}
+	d_descriptor_texture_version.assign(swapChainImagesCount, d_texture_version);
+	for(size_t j = 0; j < swapChainImagesCount; j++)
+		updateTextureDescriptorSets(static_cast<uint32_t>(j));
+    if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan descriptor sets created, " + std::to_string(swapChainImagesCount) + " frame sets and " +
+		std::to_string(d_descriptor_per_material.size() * swapChainImagesCount) + " texture sets");}
+}
 
-			// node data
-			{
-				VkDescriptorBufferInfo bufferInfo{};
-				bufferInfo.buffer = d_node_uniform_buffers[d_meshes[i]->nodeID][j].buf;
-				bufferInfo.offset = 0;
-				bufferInfo.range = sizeof(NodeUniformData);
-
-				VkWriteDescriptorSet writeUniform;
-				writeUniform.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeUniform.dstSet = d_descriptor_per_mesh[i][j];
-				writeUniform.dstBinding = 1;
-				writeUniform.dstArrayElement = 0;
-				writeUniform.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				writeUniform.descriptorCount = 1;
-				writeUniform.pBufferInfo = &bufferInfo;
-				writeUniform.pImageInfo = nullptr;
-				writeUniform.pTexelBufferView = nullptr;
-				writeUniform.pNext = nullptr;
-
-				descriptorWrite.push_back(writeUniform);
-			}
+void Graph::updateTextureDescriptorSets(uint32_t imageID)
+{
+	const uint32_t textureBindings = 5; // binding 2 to 6
+	std::vector<VkDescriptorImageInfo> imageInfos(d_material_textures.size() * textureBindings);
+	std::vector<VkWriteDescriptorSet> descriptorWrite(d_material_textures.size() * textureBindings);
+	for(size_t i = 0; i < d_material_textures.size(); i++)
+	{
+		for(uint32_t k = 0; k < textureBindings; k++)
+		{
+			const Texture& texture = findTexture(d_material_textures[i][k]);
+			VkDescriptorImageInfo& imageInfo = imageInfos[i * textureBindings + k];
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.imageView = texture.image.view;
+			imageInfo.sampler = texture.sampler;
+
+			VkWriteDescriptorSet& writeSampler = descriptorWrite[i * textureBindings + k];
+			writeSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeSampler.dstSet = d_descriptor_per_material[i][imageID];
+			writeSampler.dstBinding = 2 + k;
+			writeSampler.dstArrayElement = 0;
+			writeSampler.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writeSampler.descriptorCount = 1;
+			writeSampler.pImageInfo = &imageInfo;
+		}
+	}
+	if(descriptorWrite.size())
+		vkUpdateDescriptorSets(d_device, static_cast<uint32_t>(descriptorWrite.size()), descriptorWrite.data(), 0, nullptr);
+	d_descriptor_texture_version[imageID] = d_texture_version;
+}
 
-			// base color texture
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = d_unique_textures[d_meshes[i]->texBase].image.view;
-				imageInfo.sampler = d_unique_textures[d_meshes[i]->texBase].sampler;
-
-				VkWriteDescriptorSet writeSampler;
-				writeSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeSampler.dstSet = d_descriptor_per_mesh[i][j];
-				writeSampler.dstBinding = 2;
-				writeSampler.dstArrayElement = 0;
-				writeSampler.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				writeSampler.descriptorCount = 1;
-				writeSampler.pBufferInfo = nullptr;
-				writeSampler.pImageInfo = &imageInfo;
-				writeSampler.pTexelBufferView = nullptr;
-				writeSampler.pNext = nullptr;
-
-				descriptorWrite.push_back(writeSampler);
-			}
+const Texture& Graph::findTexture(uint32_t textureID)
+{
+	if(textureID < d_unique_textures.size() && d_unique_textures[textureID].allset)
+		return d_unique_textures[textureID];
+	return d_unique_textures[0];
+}
 
-			// rough texture
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = d_unique_textures[d_meshes[i]->texRough].image.view;
-				imageInfo.sampler = d_unique_textures[d_meshes[i]->texRough].sampler;
-
-				VkWriteDescriptorSet writeSampler;
-				writeSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeSampler.dstSet = d_descriptor_per_mesh[i][j];
-				writeSampler.dstBinding = 3;
-				writeSampler.dstArrayElement = 0;
-				writeSampler.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				writeSampler.descriptorCount = 1;
-				writeSampler.pBufferInfo = nullptr;
-				writeSampler.pImageInfo = &imageInfo;
-				writeSampler.pTexelBufferView = nullptr;
-				writeSampler.pNext = nullptr;
-
-				descriptorWrite.push_back(writeSampler);
-			}
+bool Graph::uploadStreamedTextures()
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-			// normal texture
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = d_unique_textures[d_meshes[i]->texNormal].image.view;
-				imageInfo.sampler = d_unique_textures[d_meshes[i]->texNormal].sampler;
-
-				VkWriteDescriptorSet writeSampler;
-				writeSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeSampler.dstSet = d_descriptor_per_mesh[i][j];
-				writeSampler.dstBinding = 4;
-				writeSampler.dstArrayElement = 0;
-				writeSampler.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				writeSampler.descriptorCount = 1;
-				writeSampler.pBufferInfo = nullptr;
-				writeSampler.pImageInfo = &imageInfo;
-				writeSampler.pTexelBufferView = nullptr;
-				writeSampler.pNext = nullptr;
-
-				descriptorWrite.push_back(writeSampler);
-			}
+	TextureStream& stream = *p_texture_stream;
+	bool keepPixels = !stream.cachePath.empty();
+	size_t budget = std::max<size_t>(1, app->GRAPH_STREAM_UPLOADS_PER_FRAME);
+	bool changed = false;
+	while(budget--)
+	{
+		size_t i;
+		{
+			std::lock_guard<std::mutex> lock(stream.mutex);
+			if(stream.decoded.empty()) break;
+			i = stream.decoded.front();
+			stream.decoded.pop_front();
+		}
+		TextureData& texture = stream.textures[i];
+		if(!stream.errors[i].empty())
+			if(myLogger){myLogger->AddMessage(myLoggerOwner, "failed to decode streamed texture " + std::to_string(i) + " (" + stream.errors[i] + "), using empty texture");}
+		d_unique_textures[stream.slots[i]] = createTextureFromData(texture, texture.pixels.data());
+		if(!keepPixels)
+			std::vector<unsigned char>().swap(texture.pixels);
+		stream.uploaded++;
+		changed = true;
+	}
+	if(changed)
+	{
+		// the draws submitted after this frame boundary see the textures
+		p_uploads->submit();
+		d_texture_version++;
+	}
 
-			// occlusion texture
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = d_unique_textures[d_meshes[i]->texOcclusion].image.view;
-				imageInfo.sampler = d_unique_textures[d_meshes[i]->texOcclusion].sampler;
-
-				VkWriteDescriptorSet writeSampler;
-				writeSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeSampler.dstSet = d_descriptor_per_mesh[i][j];
-				writeSampler.dstBinding = 5;
-				writeSampler.dstArrayElement = 0;
-				writeSampler.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				writeSampler.descriptorCount = 1;
-				writeSampler.pBufferInfo = nullptr;
-				writeSampler.pImageInfo = &imageInfo;
-				writeSampler.pTexelBufferView = nullptr;
-				writeSampler.pNext = nullptr;
-
-				descriptorWrite.push_back(writeSampler);
-			}
+	if(stream.uploaded == stream.textures.size())
+	{
+		if(myLogger){myLogger->AddMessage(myLoggerOwner, "graph fully loaded, all " + std::to_string(stream.uploaded) + " textures streamed in " +
+			std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - d_time_created).count()) + " ms, " +
+			describeTextureMemory());}
+		if(myLogger){myLogger->AddMessage(myLoggerOwner, "graph uploads: " + p_uploads->describe());}
+		if(keepPixels)
+			saveSceneCache(stream.cachePath, stream.vertexBlob, stream.indiceBlob, stream.textures, stream.dependencies);
+		p_texture_stream.reset();
+	}
+	return changed;
+}
 
-			// emissive texture
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = d_unique_textures[d_meshes[i]->texEmissive].image.view;
-				imageInfo.sampler = d_unique_textures[d_meshes[i]->texEmissive].sampler;
-
-				VkWriteDescriptorSet writeSampler;
-				writeSampler.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeSampler.dstSet = d_descriptor_per_mesh[i][j];
-				writeSampler.dstBinding = 6;
-				writeSampler.dstArrayElement = 0;
-				writeSampler.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				writeSampler.descriptorCount = 1;
-				writeSampler.pBufferInfo = nullptr;
-				writeSampler.pImageInfo = &imageInfo;
-				writeSampler.pTexelBufferView = nullptr;
-				writeSampler.pNext = nullptr;
-
-				descriptorWrite.push_back(writeSampler);
-			}
+void Graph::onFrameStart(uint32_t imageID)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-			vkUpdateDescriptorSets(d_device, static_cast<uint32_t>(descriptorWrite.size()), descriptorWrite.data(), 0, nullptr);
-		}
-    }
-    if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan descriptor sets created");}
+	if(!d_first_frame_started)
+	{
+		d_first_frame_started = true;
+		if(myLogger){myLogger->AddMessage(myLoggerOwner, "time to first frame " +
+			std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - d_time_created).count()) + " ms");}
+	}
+	if(p_texture_stream)
+		uploadStreamedTextures();
+	if(imageID < d_descriptor_texture_version.size() && d_descriptor_texture_version[imageID] != d_texture_version)
+		updateTextureDescriptorSets(imageID);
 }
 
 void Graph::createVertexBuffers(std::vector<GraphUserInput>& meshes)
@@ -444,36 +733,63 @@ void Graph::createVertexBuffers(std::vector<GraphUserInput>& meshes)
     LOGGING::Logger* myLogger = app->GetLogger();
     LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-    VkDeviceSize bufferSize = 0;
+	size_t vertexCount = 0;
 	for(auto& mesh : meshes)
-		bufferSize += (uint64_t)(sizeof(Vertex)) * mesh.vertices.size();
-
-	Buffer stagingBuffer = createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-	VkDeviceSize offset = 0;
-
-	void* data;
-    for(auto& mesh : meshes)
-    {
-        VkDeviceSize localSize = (uint64_t)(sizeof(Vertex)) * mesh.vertices.size();
-
-	    vkMapMemory(d_device, stagingBuffer.mem, offset, localSize, 0, &data);
-	    memcpy(data, mesh.vertices.data(), (size_t)localSize);
-	    vkUnmapMemory(d_device, stagingBuffer.mem);
+		vertexCount += mesh.vertices.size();
+	VkDeviceSize bufferSize = (uint64_t)getVertexFormatStride(d_vertex_format) * vertexCount;
+	if(!bufferSize) return;
 
-		offset += localSize;
-    }
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	writeVertexBuffer(meshes, p_uploads->stage(bufferSize, 4, stagingBuffer, stagingOffset));
 
 	Buffer vertexBuffer = createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	copyBufferToBuffer(stagingBuffer.buf, vertexBuffer.buf, bufferSize);
-    stagingBuffer.destroy(d_device);
+	copyBufferToBuffer(stagingBuffer, vertexBuffer.buf, bufferSize, stagingOffset);
 
 	d_vertex_buffer = vertexBuffer;
 
-    if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan graph vertex buffer created");}
+    if(myLogger)
+	{
+		myLogger->AddMessage(myLoggerOwner, "Vulkan graph vertex buffer created (" + std::to_string(vertexCount) + " vertices)");
+		// memory every format would take, for comparison
+		VertexFormats formats[] = {VERTEX_FORMAT_FULL, VERTEX_FORMAT_COMPACT, VERTEX_FORMAT_QUANTIZED};
+		for(VertexFormats format : formats)
+		{
+			size_t stride = getVertexFormatStride(format);
+			myLogger->AddMessage(myLoggerOwner, std::string("vertex format ") + getVertexFormatName(format) + ": " + std::to_string(stride) +
+				" bytes per vertex, " + std::to_string(stride * vertexCount) + " bytes total" + (format == d_vertex_format ? " (in use)" : ""));
+		}
+	}
+}
+
+void Graph::writeVertexBuffer(const std::vector<GraphUserInput>& meshes, unsigned char* dst)
+{
+	size_t stride = getVertexFormatStride(d_vertex_format);
+	std::vector<size_t> offsets(meshes.size(), 0);
+	for(size_t i = 1; i < meshes.size(); i++)
+		offsets[i] = offsets[i - 1] + meshes[i - 1].vertices.size() * stride;
+	std::vector<glm::vec3> offsetsQuantized(meshes.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> scalesQuantized(meshes.size(), glm::vec3(1.0f));
+	auto pack = [&](size_t i)
+	{
+		const std::vector<Vertex>& vertices = meshes[i].vertices;
+		if(d_vertex_format == VERTEX_FORMAT_QUANTIZED)
+			findVertexQuantization(vertices.data(), vertices.size(), offsetsQuantized[i], scalesQuantized[i]);
+		packVertices(vertices.data(), vertices.size(), d_vertex_format, offsetsQuantized[i], scalesQuantized[i], dst + offsets[i]);
+	};
+	UTILS::ThreadPool* pool = app->GetThreadPool();
+	if(pool && d_vertex_format != VERTEX_FORMAT_FULL) pool->parallelFor(meshes.size(), pack);
+	else for(size_t i = 0; i < meshes.size(); i++) pack(i);
+
+	// every mesh sharing the data dequantizes it the same way
+	for(size_t i = 0; i < d_meshes.size(); i++)
+	{
+		uint32_t geometryID = d_meshes[i]->geometryID;
+		d_mesh_constants[i].positionOffset = glm::vec4(offsetsQuantized[geometryID], 0.0f);
+		d_mesh_constants[i].positionScale = glm::vec4(scalesQuantized[geometryID], 1.0f);
+	}
 }
 
 void Graph::createIndiceBuffers(std::vector<GraphUserInput>& meshes)
@@ -481,147 +797,366 @@ void Graph::createIndiceBuffers(std::vector<GraphUserInput>& meshes)
     LOGGING::Logger* myLogger = app->GetLogger();
     LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-	VkDeviceSize bufferSize = 0;
-	for(auto& mesh : meshes)
-		bufferSize += (uint64_t)(sizeof(uint32_t)) * mesh.indices.size();
-
-	Buffer stagingBuffer = createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-	VkDeviceSize offset = 0;
-	uint32_t vertexCount = 0;
-
-	d_indice_count = 0;
-
-	void* data;
-    for(auto& mesh : meshes)
-    {
-		VkDeviceSize localSize = (uint64_t)(sizeof(uint32_t)) * mesh.indices.size();
-		d_indice_count += mesh.indices.size();
-
-		// update local indices to global
-		for(size_t i = 0; i < mesh.indices.size(); i++)
-			mesh.indices[i] += vertexCount;
-
-		if(localSize)
-		{
-	    	vkMapMemory(d_device, stagingBuffer.mem, offset, localSize, 0, &data);
-	    	memcpy(data, mesh.indices.data(), (size_t)localSize);
-	    	vkUnmapMemory(d_device, stagingBuffer.mem);
-			offset += localSize;
-		}
+	VkDeviceSize bufferSize = layoutIndiceBuffer(meshes);
+	if(!bufferSize) return;
 
-		vertexCount += mesh.vertices.size();
-    }
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	writeIndiceBuffer(meshes, p_uploads->stage(bufferSize, 4, stagingBuffer, stagingOffset));
 
 	Buffer indiceBuffer = createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	copyBufferToBuffer(stagingBuffer.buf, indiceBuffer.buf, bufferSize);
-    stagingBuffer.destroy(d_device);
+	copyBufferToBuffer(stagingBuffer, indiceBuffer.buf, bufferSize, stagingOffset);
 
 	d_indice_buffer = indiceBuffer;
 
-    if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan graph indice buffer created");}
+    if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan graph indice buffer created (" + std::to_string(d_indice_count) + " indices, " +
+		std::to_string(bufferSize) + " bytes, " + std::to_string(d_indice_offset_32 / sizeof(uint16_t)) + " stored as 16 bit)");}
 }
 
-void Graph::createRenderCommandBuffers()
+// vertex and indice count of every mesh
+std::vector<glm::uvec2> findGeometryCounts(const std::vector<GraphUserInput>& meshes)
 {
-	UTILS::UI* myUI = app->GetUI();
+	std::vector<glm::uvec2> counts(meshes.size());
+	for(size_t i = 0; i < meshes.size(); i++)
+		counts[i] = glm::uvec2(meshes[i].vertices.size(), meshes[i].indices.size());
+	return counts;
+}
 
-    size_t swapChainImagesCount = app->GetRenderer()->getSwapChainImagesCount();
-    d_commands = app->GetRenderer()->allocateRenderCommandBuffers(swapChainImagesCount);
-
-    for(size_t i = 0; i < swapChainImagesCount; i++)
-    {
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
-		if (vkBeginCommandBuffer(d_commands[i], &beginInfo) != VK_SUCCESS)
-			throw std::runtime_error("ERROR: failed to begin recording Vulkan command buffer!");
-
-		VkRenderPassBeginInfo renderPassInfo{};
-		app->GetRenderer()->fillRenderPassInfo(renderPassInfo, i);
-
-		std::vector<VkClearValue> clearValues{};
-		clearValues.resize(1);
-		clearValues[0].color = {
-			app->RENDER_CLEAR_VALUES[0], app->RENDER_CLEAR_VALUES[1],
-			app->RENDER_CLEAR_VALUES[2], app->RENDER_CLEAR_VALUES[3]
-		};
-		if(app->RENDER_ENABLE_MSAA)
+// index type and first index inside the region of that type for every geometry, counts are (vertices, indices)
+void findIndiceLayout(const std::vector<glm::uvec2>& counts, std::vector<VkIndexType>& types, std::vector<uint32_t>& starts,
+	uint32_t& count16, uint32_t& count32)
+{
+	types.resize(counts.size());
+	starts.resize(counts.size());
+	count16 = 0;
+	count32 = 0;
+	for(size_t i = 0; i < counts.size(); i++)
+	{
+		uint32_t indiceCount = counts[i].y;
+		if(counts[i].x < 65536)
 		{
-			clearValues.resize(clearValues.size()+1);
-			clearValues[clearValues.size()-1].color = {
-				app->RENDER_CLEAR_VALUES[0], app->RENDER_CLEAR_VALUES[1],
-				app->RENDER_CLEAR_VALUES[2], app->RENDER_CLEAR_VALUES[3]
-			};
+			types[i] = VK_INDEX_TYPE_UINT16;
+			starts[i] = count16;
+			count16 += indiceCount;
 		}
-		if(app->RENDER_ENABLE_DEPTH)
+		else
 		{
-			clearValues.resize(clearValues.size()+1);
-			clearValues[clearValues.size()-1].depthStencil = {1.0f, 0};
+			types[i] = VK_INDEX_TYPE_UINT32;
+			starts[i] = count32;
+			count32 += indiceCount;
 		}
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+	}
+}
 
-		vkCmdBeginRenderPass(d_commands[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+VkDeviceSize Graph::layoutIndiceBuffer(const std::vector<GraphUserInput>& meshes)
+{
+	return layoutIndiceBuffer(findGeometryCounts(meshes));
+}
 
-		VkPipelineLayout pipelineLayout = app->GetRenderer()->getGraphicsPipelineLayout();
-		vkCmdBindPipeline(d_commands[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->GetRenderer()->getGraphicsPipeline());
+VkDeviceSize Graph::layoutIndiceBuffer(const std::vector<glm::uvec2>& geometryCounts)
+{
+	std::vector<VkIndexType> types;
+	std::vector<uint32_t> starts;
+	uint32_t count16, count32;
+	findIndiceLayout(geometryCounts, types, starts, count16, count32);
+	d_indice_count = count16 + count32;
+	for(Mesh* mesh : d_meshes)
+	{
+		mesh->indiceType = types[mesh->geometryID];
+		mesh->indiceStart = starts[mesh->geometryID];
+	}
+	// 32 bit region has to start at a multiple of 4 bytes
+	d_indice_offset_32 = ((VkDeviceSize)count16 * sizeof(uint16_t) + 3) & ~(VkDeviceSize)3;
+	return d_indice_offset_32 + (VkDeviceSize)count32 * sizeof(uint32_t);
+}
 
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(d_commands[i], 0, 1, &d_vertex_buffer.buf, offsets);
+void Graph::writeIndiceBuffer(const std::vector<GraphUserInput>& meshes, unsigned char* dst)
+{
+	uint16_t* dst16 = reinterpret_cast<uint16_t*>(dst);
+	uint32_t* dst32 = reinterpret_cast<uint32_t*>(dst + d_indice_offset_32);
+	// zero the alignment padding first, real indices overwrite it when there is none
+	if(d_indice_offset_32 >= sizeof(uint16_t))
+		dst16[d_indice_offset_32 / sizeof(uint16_t) - 1] = 0;
+	std::vector<VkIndexType> types;
+	std::vector<uint32_t> starts;
+	uint32_t count16, count32;
+	findIndiceLayout(findGeometryCounts(meshes), types, starts, count16, count32);
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		const std::vector<uint32_t>& indices = meshes[i].indices;
+		if(types[i] == VK_INDEX_TYPE_UINT16)
+		{
+			uint16_t* out = dst16 + starts[i];
+			for(size_t k = 0; k < indices.size(); k++)
+				out[k] = static_cast<uint16_t>(indices[k]);
+		}
+		else if(indices.size())
+			memcpy(dst32 + starts[i], indices.data(), sizeof(uint32_t) * indices.size());
+	}
+}
 
-		if(d_indice_count)
-			vkCmdBindIndexBuffer(d_commands[i], d_indice_buffer.buf, 0, VK_INDEX_TYPE_UINT32);
+void Graph::beginGeometryStaging(const std::vector<glm::uvec2>& geometryCounts, GeometryStaging& staging)
+{
+	uint64_t vertexCount = 0;
+	for(auto& counts : geometryCounts)
+		vertexCount += counts.x;
+	staging.vertexCount = vertexCount;
+	staging.vertexSize = (VkDeviceSize)getVertexFormatStride(d_vertex_format) * vertexCount;
+	staging.indiceSize = layoutIndiceBuffer(geometryCounts);
+	uint32_t count16, count32;
+	findIndiceLayout(geometryCounts, staging.indiceTypes, staging.indiceStarts, count16, count32);
+	staging.indiceOffset = (staging.vertexSize + 3) & ~(VkDeviceSize)3;
+	staging.indiceOffset32 = d_indice_offset_32;
+	VkDeviceSize size = staging.indiceOffset + staging.indiceSize;
+	if(!size) return;
+
+	// one staging region for every geometry, the loader packs straight into it
+	staging.mapped = p_uploads->stage(size, 4, staging.buffer, staging.bufferOffset);
+	// zero the alignment padding of the indice regions, real indices overwrite it when there is none
+	if(d_indice_offset_32 >= sizeof(uint16_t))
+		memset(staging.mapped + staging.indiceOffset + d_indice_offset_32 - sizeof(uint16_t), 0, sizeof(uint16_t));
+	staging.vertexCopies.assign(staging.vertexSize ? 1 : 0, VkBufferCopy{0, 0, staging.vertexSize});
+	staging.indiceCopies.assign(staging.indiceSize ? 1 : 0, VkBufferCopy{0, 0, staging.indiceSize});
+	if(staging.keepCopy)
+	{
+		staging.vertexCopy.resize(static_cast<size_t>(staging.vertexSize));
+		staging.indiceCopy.assign(static_cast<size_t>(staging.indiceSize), 0);
+	}
+}
 
-		vkCmdBindDescriptorSets(d_commands[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &d_descriptor_ubo[i], 0, nullptr);
+void Graph::deduplicateStagedGeometry(GeometryStaging& staging, const std::vector<uint64_t>& hashes)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-		for(auto& node : d_nodes)
+	if(!staging.mapped) return;
+
+	// vertex range and indice count of every staged geometry, from the meshes using it
+	size_t stride = getVertexFormatStride(d_vertex_format);
+	std::vector<glm::uvec2> counts(hashes.size(), glm::uvec2(0));
+	std::vector<uint32_t> vertexStarts(hashes.size(), 0);
+	for(Mesh* mesh : d_meshes)
+	{
+		counts[mesh->geometryID] = glm::uvec2(mesh->vertexCount, mesh->indiceCount);
+		vertexStarts[mesh->geometryID] = mesh->vertexStart;
+	}
+	// equal hashes are confirmed byte by byte, the CPU copy is read if there is one
+	// mapped memory is usually write combined, then only geometries that are really merged are read back
+	const unsigned char* vertices = staging.keepCopy ? staging.vertexCopy.data() : staging.mapped;
+	const unsigned char* indices = staging.keepCopy ? staging.indiceCopy.data() : staging.mapped + staging.indiceOffset;
+	std::vector<VkDeviceSize> indiceBytes(hashes.size());
+	for(size_t i = 0; i < hashes.size(); i++)
+		indiceBytes[i] = (VkDeviceSize)counts[i].y * (staging.indiceTypes[i] == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+	std::multimap<uint64_t, uint32_t> uniqueHashes;
+	std::vector<uint32_t> remap(hashes.size());
+	std::vector<uint32_t> unique;
+	for(size_t i = 0; i < hashes.size(); i++)
+	{
+		bool merged = false;
+		auto range = app->GRAPH_DEDUPLICATE_GEOMETRY ? uniqueHashes.equal_range(hashes[i]) :
+			std::make_pair(uniqueHashes.end(), uniqueHashes.end());
+		for(auto it = range.first; it != range.second && !merged; it++)
 		{
-			if(!node->meshIDs.size()) continue;
-			for(size_t meshID : node->meshIDs)
+			uint32_t other = unique[it->second];
+			if(counts[other] == counts[i] &&
+				memcmp(vertices + (VkDeviceSize)vertexStarts[other] * stride, vertices + (VkDeviceSize)vertexStarts[i] * stride,
+					(size_t)counts[i].x * stride) == 0 &&
+				memcmp(indices + staging.indiceByteOffset(other), indices + staging.indiceByteOffset(i), static_cast<size_t>(indiceBytes[i])) == 0)
 			{
-				Mesh* mesh = d_meshes[meshID];
-				if(mesh->meshID < 0) continue;
-				vkCmdBindDescriptorSets(d_commands[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-					&d_descriptor_per_mesh[mesh->meshID][i], 0, nullptr);
-				vkCmdPushConstants(d_commands[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-					sizeof(MeshConstantData), &d_mesh_constants[meshID]);
-				if(mesh->indiceCount > 0)
-					vkCmdDrawIndexed(d_commands[i], mesh->indiceCount, 1, mesh->indiceStart, 0, 0);
-				else
-					vkCmdDraw(d_commands[i], mesh->vertexCount, 1, mesh->vertexStart, 0);
+				remap[i] = it->second;
+				merged = true;
 			}
 		}
+		if(merged) continue;
+		remap[i] = static_cast<uint32_t>(unique.size());
+		uniqueHashes.insert(std::make_pair(hashes[i], remap[i]));
+		unique.push_back(static_cast<uint32_t>(i));
+	}
+	// memory of every mesh as if it had its own copy, against the shared data
+	VkDeviceSize bytesShared = 0;
+	VkDeviceSize bytesTotal = 0;
+	for(uint32_t i : unique)
+		bytesShared += (VkDeviceSize)counts[i].x * stride + indiceBytes[i];
+	for(Mesh* mesh : d_meshes)
+		bytesTotal += (VkDeviceSize)counts[mesh->geometryID].x * stride + indiceBytes[mesh->geometryID];
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, std::to_string(d_meshes.size()) + " meshes share " + std::to_string(unique.size()) +
+		" unique geometries (" + std::to_string(hashes.size() - unique.size()) + " merged by content hash), saved " +
+		std::to_string(bytesTotal - bytesShared) + " bytes");}
+	if(unique.size() == hashes.size()) return;
+
+	// unique geometries keep their order, so every one moves to the same or a lower offset
+	std::vector<VkIndexType> oldTypes = staging.indiceTypes;
+	std::vector<VkDeviceSize> oldIndiceOffsets(unique.size());
+	std::vector<glm::uvec2> uniqueCounts(unique.size());
+	for(size_t u = 0; u < unique.size(); u++)
+	{
+		oldIndiceOffsets[u] = staging.indiceByteOffset(unique[u]);
+		uniqueCounts[u] = counts[unique[u]];
+	}
+	std::vector<uint32_t> uniqueVertexStarts(unique.size(), 0);
+	for(size_t u = 1; u < unique.size(); u++)
+		uniqueVertexStarts[u] = uniqueVertexStarts[u - 1] + uniqueCounts[u - 1].x;
+	for(Mesh* mesh : d_meshes)
+	{
+		mesh->geometryID = remap[mesh->geometryID];
+		mesh->vertexStart = uniqueVertexStarts[mesh->geometryID];
+	}
+	VkDeviceSize indiceSize = layoutIndiceBuffer(uniqueCounts);
+	uint32_t count16, count32;
+	findIndiceLayout(uniqueCounts, staging.indiceTypes, staging.indiceStarts, count16, count32);
+	staging.indiceOffset32 = d_indice_offset_32;
 
-		if(myUI) ImGui_ImplVulkan_RenderDrawData(myUI->recordUI(), d_commands[i]);
+	// one copy region per run of geometries that stayed back to back
+	auto addCopy = [](std::vector<VkBufferCopy>& copies, VkDeviceSize src, VkDeviceSize dst, VkDeviceSize size)
+	{
+		if(!size) return;
+		if(!copies.empty() && copies.back().srcOffset + copies.back().size == src && copies.back().dstOffset + copies.back().size == dst)
+			copies.back().size += size;
+		else copies.push_back(VkBufferCopy{src, dst, size});
+	};
+	staging.vertexCopies.clear();
+	staging.indiceCopies.clear();
+	uint64_t vertexCount = 0;
+	for(size_t u = 0; u < unique.size(); u++)
+	{
+		VkDeviceSize size = (VkDeviceSize)uniqueCounts[u].x * stride;
+		addCopy(staging.vertexCopies, (VkDeviceSize)vertexStarts[unique[u]] * stride, (VkDeviceSize)uniqueVertexStarts[u] * stride, size);
+		vertexCount += uniqueCounts[u].x;
+	}
+	// both index types keep their order, the 16 bit ones come first
+	VkIndexType types[] = {VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32};
+	for(VkIndexType type : types)
+	{
+		for(size_t u = 0; u < unique.size(); u++)
+		{
+			if(oldTypes[unique[u]] != type) continue;
+			addCopy(staging.indiceCopies, oldIndiceOffsets[u], staging.indiceByteOffset(static_cast<uint32_t>(u)), indiceBytes[unique[u]]);
+		}
+	}
+	staging.vertexCount = vertexCount;
+	staging.vertexSize = (VkDeviceSize)stride * vertexCount;
+	staging.indiceSize = indiceSize;
 
-		vkCmdEndRenderPass(d_commands[i]);
-		if (vkEndCommandBuffer(d_commands[i]) != VK_SUCCESS)
-			throw std::runtime_error("ERROR: failed to record Vulkan render command buffer!");
+	// the CPU copy is compacted the same way, the regions only move down so memmove in order is safe
+	if(staging.keepCopy)
+	{
+		for(const VkBufferCopy& copy : staging.vertexCopies)
+			memmove(staging.vertexCopy.data() + copy.dstOffset, staging.vertexCopy.data() + copy.srcOffset, static_cast<size_t>(copy.size));
+		staging.vertexCopy.resize(static_cast<size_t>(staging.vertexSize));
+		for(const VkBufferCopy& copy : staging.indiceCopies)
+			memmove(staging.indiceCopy.data() + copy.dstOffset, staging.indiceCopy.data() + copy.srcOffset, static_cast<size_t>(copy.size));
+		staging.indiceCopy.resize(static_cast<size_t>(staging.indiceSize));
+		if(d_indice_offset_32 >= sizeof(uint16_t) && count16 % 2)
+			memset(staging.indiceCopy.data() + d_indice_offset_32 - sizeof(uint16_t), 0, sizeof(uint16_t));
 	}
 }
 
+void Graph::endGeometryStaging(GeometryStaging& staging)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+	if(!staging.mapped) return;
+	staging.mapped = nullptr;
+	if(staging.vertexSize)
+	{
+		d_vertex_buffer = createBuffer(staging.vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		copyBufferToBuffer(staging.buffer, d_vertex_buffer.buf, staging.vertexCopies, staging.bufferOffset);
+	}
+	if(staging.indiceSize)
+	{
+		d_indice_buffer = createBuffer(staging.indiceSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		// the padding before the 32 bit region is not copied when geometries were merged, it is never read
+		copyBufferToBuffer(staging.buffer, d_indice_buffer.buf, staging.indiceCopies, staging.bufferOffset + staging.indiceOffset);
+	}
+
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan graph vertex and indice buffers streamed (" + std::to_string(staging.vertexCount) + " " +
+		getVertexFormatName(d_vertex_format) + " vertices, " + std::to_string(d_indice_count) + " indices, " +
+		std::to_string(staging.vertexSize + staging.indiceSize) + " bytes, " + std::to_string(d_indice_offset_32 / sizeof(uint16_t)) + " indices stored as 16 bit)");}
+}
+
+void Graph::bindIndiceBuffer(VkCommandBuffer commandBuffer, VkIndexType type)
+{
+	vkCmdBindIndexBuffer(commandBuffer, d_indice_buffer.buf, type == VK_INDEX_TYPE_UINT16 ? 0 : d_indice_offset_32, type);
+}
+
+void Graph::createRenderCommandBuffers()
+{
+    size_t swapChainImagesCount = app->GetRenderer()->getSwapChainImagesCount();
+    d_commands = app->GetRenderer()->allocateRenderCommandBuffers(swapChainImagesCount, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    d_scene_commands = app->GetRenderer()->allocateRenderCommandBuffers(swapChainImagesCount, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    d_ui_commands = app->GetRenderer()->allocateRenderCommandBuffers(swapChainImagesCount, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    // recorded before the first submit of each image
+    d_scene_commands_version.assign(swapChainImagesCount, UINT64_MAX);
+}
+
+void Graph::freeRenderCommandBuffers()
+{
+    app->GetRenderer()->freeRenderCommandBuffers(d_commands);
+    app->GetRenderer()->freeRenderCommandBuffers(d_scene_commands);
+    app->GetRenderer()->freeRenderCommandBuffers(d_ui_commands);
+    d_commands.clear();
+    d_scene_commands.clear();
+    d_ui_commands.clear();
+}
+
+// begin a secondary command buffer that continues the render pass on the framebuffer of imageID
+static void beginRenderPassCommands(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo& renderPassInfo)
+{
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPassInfo.renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("ERROR: failed to begin recording Vulkan command buffer!");
+}
+
 void Graph::updateRenderCommandBuffer(uint32_t imageID)
 {
-	if(imageID < 0 || imageID >= d_commands.size())
+	if(imageID >= d_commands.size())
 		throw std::runtime_error("ERROR: failed to update Vulkan command buffer, wrong image ID");
 
 	UTILS::UI* myUI = app->GetUI();
 
+	VkRenderPassBeginInfo renderPassInfo{};
+	app->GetRenderer()->fillRenderPassInfo(renderPassInfo, imageID);
+
+	// the scene draws are only recorded again when they depend on the camera or the texture descriptor sets changed
+	// the instance data written while recording stays in the frame slot of imageID until then
+	if(d_dynamic_draws || d_scene_commands_version[imageID] != d_descriptor_texture_version[imageID])
+	{
+		beginRenderPassCommands(d_scene_commands[imageID], renderPassInfo);
+		recordMeshDraws(d_scene_commands[imageID], imageID);
+		if (vkEndCommandBuffer(d_scene_commands[imageID]) != VK_SUCCESS)
+			throw std::runtime_error("ERROR: failed to record Vulkan render command buffer!");
+		d_scene_commands_version[imageID] = d_descriptor_texture_version[imageID];
+	}
+	// the UI changes every frame
+	if(myUI)
+	{
+		beginRenderPassCommands(d_ui_commands[imageID], renderPassInfo);
+		ImGui_ImplVulkan_RenderDrawData(myUI->recordUI(), d_ui_commands[imageID]);
+		if (vkEndCommandBuffer(d_ui_commands[imageID]) != VK_SUCCESS)
+			throw std::runtime_error("ERROR: failed to record Vulkan render command buffer!");
+	}
+
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = 0;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	beginInfo.pInheritanceInfo = nullptr;
 	if (vkBeginCommandBuffer(d_commands[imageID], &beginInfo) != VK_SUCCESS)
 		throw std::runtime_error("ERROR: failed to begin recording Vulkan command buffer!");
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	app->GetRenderer()->fillRenderPassInfo(renderPassInfo, imageID);
-
 	std::vector<VkClearValue> clearValues{};
 	clearValues.resize(1);
 	clearValues[0].color = {
@@ -644,106 +1179,400 @@ void Graph::updateRenderCommandBuffer(uint32_t imageID)
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(d_commands[imageID], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(d_commands[imageID], &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	VkCommandBuffer secondary[] = {d_scene_commands[imageID], d_ui_commands[imageID]};
+	vkCmdExecuteCommands(d_commands[imageID], myUI ? 2 : 1, secondary);
+	vkCmdEndRenderPass(d_commands[imageID]);
+	if (vkEndCommandBuffer(d_commands[imageID]) != VK_SUCCESS)
+		throw std::runtime_error("ERROR: failed to record Vulkan render command buffer!");
+}
 
+void Graph::recordMeshDraws(VkCommandBuffer commandBuffer, uint32_t imageID)
+{
 	VkPipelineLayout pipelineLayout = app->GetRenderer()->getGraphicsPipelineLayout();
-	vkCmdBindPipeline(d_commands[imageID], VK_PIPELINE_BIND_POINT_GRAPHICS, app->GetRenderer()->getGraphicsPipeline());
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->GetRenderer()->getGraphicsPipeline());
 
 	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(d_commands[imageID], 0, 1, &d_vertex_buffer.buf, offsets);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &d_vertex_buffer.buf, offsets);
+
+	// indice region is bound again whenever the index type changes
+	VkIndexType boundIndiceType = VK_INDEX_TYPE_MAX_ENUM;
 
-	if(d_indice_count)
-		vkCmdBindIndexBuffer(d_commands[imageID], d_indice_buffer.buf, 0, VK_INDEX_TYPE_UINT32);
+	// camera, transforms and instances stay bound for all draws
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &d_descriptor_frame[imageID], 0, nullptr);
+	uint32_t boundMaterial = UINT32_MAX;
 
-	vkCmdBindDescriptorSets(d_commands[imageID], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &d_descriptor_ubo[imageID], 0, nullptr);
+	if(d_dynamic_draws) prepareMeshDraws();
 
+	// visible meshes sorted by (batch, first index drawn), so instances drawing the same ranges end up next to each other
+	std::vector<std::pair<uint64_t, uint32_t>> visible;
+	visible.reserve(d_meshes.size());
 	for(auto& node : d_nodes)
 	{
-		if(!node->meshIDs.size()) continue;
-		for(size_t meshID : node->meshIDs)
+		for(uint32_t meshID : node->meshIDs)
 		{
 			Mesh* mesh = d_meshes[meshID];
-			if(mesh->meshID < 0) continue;
-			vkCmdBindDescriptorSets(d_commands[imageID], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-				&d_descriptor_per_mesh[mesh->meshID][imageID], 0, nullptr);
-			vkCmdPushConstants(d_commands[imageID], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-				sizeof(MeshConstantData), &d_mesh_constants[meshID]);
-			if(mesh->indiceCount > 0)
-				vkCmdDrawIndexed(d_commands[imageID], mesh->indiceCount, 1, mesh->indiceStart, 0, 0);
-			else
-				vkCmdDraw(d_commands[imageID], mesh->vertexCount, 1, mesh->vertexStart, 0);
+			bool dynamic = d_dynamic_draws && mesh->indiceCount > 0;
+			uint32_t first = 0;
+			if(dynamic)
+			{
+				const glm::uvec2& range = d_mesh_draw_ranges[meshID];
+				if(!range.y) continue;
+				first = d_draw_ranges[range.x].x;
+			}
+			visible.push_back(std::make_pair(((uint64_t)d_mesh_batches[meshID] << 32) | first, meshID));
 		}
 	}
+	std::sort(visible.begin(), visible.end());
 
-	if(myUI) ImGui_ImplVulkan_RenderDrawData(myUI->recordUI(), d_commands[imageID]);
+	// node of every instance, each run of equal keys reads a contiguous slice and the shader looks up its transform
+	if(visible.size())
+	{
+		InstanceData* instances = reinterpret_cast<InstanceData*>(frameData(imageID, d_frame_instance_offset));
+		for(size_t i = 0; i < visible.size(); i++)
+			instances[i].nodeID = d_meshes[visible[i].second]->nodeID;
+		flushFrameData(imageID, d_frame_instance_offset, sizeof(InstanceData) * visible.size());
+	}
 
-	vkCmdEndRenderPass(d_commands[imageID]);
-	if (vkEndCommandBuffer(d_commands[imageID]) != VK_SUCCESS)
-		throw std::runtime_error("ERROR: failed to record Vulkan render command buffer!");
+	uint32_t draws = 0;
+	for(size_t start = 0, end = 0; start < visible.size(); start = end)
+	{
+		end = start + 1;
+		while(end < visible.size() && visible[end].first == visible[start].first) end++;
+		uint32_t instanceCount = static_cast<uint32_t>(end - start);
+		uint32_t firstInstance = static_cast<uint32_t>(start);
+
+		// the first mesh stands for the whole run, they share geometry, textures and constants
+		uint32_t meshID = visible[start].second;
+		Mesh* mesh = d_meshes[meshID];
+		if(d_mesh_materials[meshID] != boundMaterial)
+		{
+			boundMaterial = d_mesh_materials[meshID];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1,
+				&d_descriptor_per_material[boundMaterial][imageID], 0, nullptr);
+		}
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+			sizeof(MeshConstantData), &d_mesh_constants[meshID]);
+		if(mesh->indiceCount > 0)
+		{
+			if(mesh->indiceType != boundIndiceType)
+			{
+				bindIndiceBuffer(commandBuffer, mesh->indiceType);
+				boundIndiceType = mesh->indiceType;
+			}
+			if(d_dynamic_draws)
+			{
+				const glm::uvec2& range = d_mesh_draw_ranges[meshID];
+				for(uint32_t i = range.x; i < range.x + range.y; i++)
+					vkCmdDrawIndexed(commandBuffer, d_draw_ranges[i].y, instanceCount, mesh->indiceStart + d_draw_ranges[i].x,
+						static_cast<int32_t>(mesh->vertexStart), firstInstance);
+				draws += range.y;
+			}
+			else
+			{
+				vkCmdDrawIndexed(commandBuffer, mesh->indiceCount, instanceCount, mesh->indiceStart, static_cast<int32_t>(mesh->vertexStart), firstInstance);
+				draws++;
+			}
+		}
+		else
+		{
+			vkCmdDraw(commandBuffer, mesh->vertexCount, instanceCount, mesh->vertexStart, firstInstance);
+			draws++;
+		}
+	}
+	app->RENDER_DRAW_STATISTICS.draws = draws;
+	app->RENDER_DRAW_STATISTICS.instances = static_cast<uint32_t>(visible.size());
 }
 
-void Graph::createTexturesFromPaths(const std::set<std::string> paths)
+void Graph::createInstanceBatches()
 {
 	LOGGING::Logger* myLogger = app->GetLogger();
     LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-	for(const auto& path : paths)
+	d_mesh_batches.resize(d_meshes.size());
+	d_batch_sizes.assign(d_meshes.size(), 0);
+	std::map<std::vector<uint32_t>, uint32_t> batches;
+	for(uint32_t i = 0; i < d_meshes.size(); i++)
 	{
-    	Texture newTexture;
+		d_mesh_batches[i] = i;
+		if(app->GRAPH_INSTANCE_MESHES)
+		{
+			// geometry, textures and constants have to match
+			const Mesh* mesh = d_meshes[i];
+			std::vector<uint32_t> key = {mesh->geometryID, mesh->texBase, mesh->texRough, mesh->texNormal, mesh->texOcclusion, mesh->texEmissive};
+			const uint32_t* constants = reinterpret_cast<const uint32_t*>(&d_mesh_constants[i]);
+			key.insert(key.end(), constants, constants + sizeof(MeshConstantData) / sizeof(uint32_t));
+			d_mesh_batches[i] = batches.insert(std::make_pair(key, i)).first->second;
+		}
+		d_batch_sizes[d_mesh_batches[i]]++;
+	}
 
-    	int texWidth, texHeight, texChannels;
-    	stbi_uc* pixels = stbi_load((std::string(GLOB_FILE_FOLDER) + "/" + path).c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    	VkDeviceSize imageSize = (uint64_t)texWidth * (uint64_t)texHeight * 4;
+	uint32_t batchCount = 0;
+	uint32_t instancedCount = 0;
+	for(uint32_t size : d_batch_sizes)
+	{
+		if(size) batchCount++;
+		if(size > 1) instancedCount += size;
+	}
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "instance batches created, " + std::to_string(d_meshes.size()) + " meshes in " +
+		std::to_string(batchCount) + " batches, " + std::to_string(instancedCount) + " meshes are instanced");}
+}
 
-    	if(!pixels)
-    	{
-    	    std::string message = "ERROR: failed to load image " + path + "!\nSTB failure reason: " + std::string(stbi_failure_reason());
-    	    throw std::runtime_error(message);
-    	}
+void Graph::prepareMeshDraws()
+{
+	DrawStatistics stats;
+	d_draw_ranges.clear();
+	d_mesh_draw_ranges.assign(d_meshes.size(), glm::uvec2(0));
+	uint32_t width, height;
+	app->GetRenderer()->getSwapChainImageExtent(width, height);
+	// pixels covered by one unit at distance one
+	float pixelsPerUnit = d_ubo_data.proj[1][1] * static_cast<float>(height) * 0.5f;
+	float allowedError = app->GRAPH_LOD_BIAS;
+	glm::mat4 viewModel = d_ubo_data.view * d_ubo_data.model;
+	for(auto& node : d_nodes)
+	{
+		if(!node->meshIDs.size()) continue;
+		glm::mat4 world = node->transformMat;
+		for(Node* ptr = node->parentNode; ptr; ptr = ptr->parentNode)
+			world = ptr->transformMat * world;
+
+		// tests run in mesh space, planes and back facing are kept by affine transforms
+		glm::mat4 toView = viewModel * world;
+		glm::mat4 toClip = d_ubo_data.proj * toView;
+		glm::vec4 planes[6];
+		for(int i = 0; i < 3; i++)
+		{
+			glm::vec4 row(toClip[0][i], toClip[1][i], toClip[2][i], toClip[3][i]);
+			glm::vec4 rowW(toClip[0][3], toClip[1][3], toClip[2][3], toClip[3][3]);
+			planes[i * 2 + 0] = rowW + row;
+			planes[i * 2 + 1] = rowW - row;
+		}
+		for(auto& plane : planes)
+		{
+			float length = glm::length(glm::vec3(plane));
+			if(length > 0.0f) plane /= length;
+		}
+		auto outside = [&planes](const glm::vec3& center, float radius)
+		{
+			for(int i = 0; i < 6; i++)
+				if(glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) return true;
+			return false;
+		};
+		glm::vec3 camera = glm::vec3(glm::inverse(toView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		// mirrored nodes swap front and back faces
+		bool coneCulling = glm::determinant(glm::mat3(toView)) > 0.0f;
+		// mesh space errors are scaled by the largest axis of the node
+		float scale = std::max(glm::length(glm::vec3(toView[0])), std::max(glm::length(glm::vec3(toView[1])), glm::length(glm::vec3(toView[2]))));
 
-    	Buffer stagingBuffer = createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		for(uint32_t meshID : node->meshIDs)
+		{
+			Mesh* mesh = d_meshes[meshID];
+			if(!mesh->indiceCount) continue;
+			glm::uvec2& meshRange = d_mesh_draw_ranges[meshID];
+			meshRange.x = static_cast<uint32_t>(d_draw_ranges.size());
+			stats.triangles += mesh->indiceCount / 3;
+
+			// coarsest level whose error stays below the allowed pixels
+			uint32_t level = 0;
+			if(mesh->lodCount)
+			{
+				glm::vec3 center = glm::vec3(toView * glm::vec4(mesh->boundsCenter, 1.0f));
+				float distance = glm::length(center) - mesh->boundsRadius * scale;
+				while(distance > 0.0f && level < mesh->lodCount &&
+					mesh->lods[level].error * scale * pixelsPerUnit / distance <= allowedError)
+					level++;
+			}
+
+			bool instanced = d_batch_sizes[d_mesh_batches[meshID]] > 1;
+			if(level > 0 || instanced)
+			{
+				if(outside(mesh->boundsCenter, mesh->boundsRadius))
+				{
+					stats.trianglesFrustumCulled += mesh->indiceCount / 3;
+					continue;
+				}
+				glm::uvec2 range(0, mesh->indiceCount);
+				if(level > 0) range = glm::uvec2(mesh->lods[level - 1].indiceOffset, mesh->lods[level - 1].indiceCount);
+				d_draw_ranges.push_back(range);
+				stats.trianglesSubmitted += range.y / 3;
+			}
+			else if(mesh->meshletCount)
+			{
+				for(uint32_t m = mesh->meshletStart; m < mesh->meshletStart + mesh->meshletCount; m++)
+				{
+					const Meshlet& meshlet = d_meshlets[m];
+					stats.meshlets++;
+					if(outside(meshlet.center, meshlet.radius))
+					{
+						stats.trianglesFrustumCulled += meshlet.triangleCount;
+						continue;
+					}
+					glm::vec3 view = meshlet.center - camera;
+					if(coneCulling && glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius)
+					{
+						stats.trianglesConeCulled += meshlet.triangleCount;
+						continue;
+					}
+					stats.meshletsVisible++;
+					stats.trianglesSubmitted += meshlet.triangleCount;
+					// neighbouring meshlets are merged into one draw
+					uint32_t count = meshlet.triangleCount * 3;
+					if(d_draw_ranges.size() > meshRange.x && d_draw_ranges.back().x + d_draw_ranges.back().y == meshlet.indiceStart)
+						d_draw_ranges.back().y += count;
+					else
+						d_draw_ranges.push_back(glm::uvec2(meshlet.indiceStart, count));
+				}
+			}
+			else
+			{
+				d_draw_ranges.push_back(glm::uvec2(0, mesh->indiceCount));
+				stats.trianglesSubmitted += mesh->indiceCount / 3;
+			}
+			meshRange.y = static_cast<uint32_t>(d_draw_ranges.size()) - meshRange.x;
+			if(meshRange.y) stats.meshLevels[level]++;
+		}
+	}
+	app->RENDER_DRAW_STATISTICS = stats;
+}
+
+void Graph::createMeshlets(const std::vector<GraphUserInput>& meshes)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+	d_meshlets.clear();
+	if(!app->GRAPH_CULL_MESHLETS) return;
+
+	std::vector<std::vector<Meshlet>> meshMeshlets(meshes.size());
+	auto build = [&](size_t i)
+	{
+		buildMeshlets(meshes[i].indices, meshes[i].vertices, meshMeshlets[i]);
+	};
+	UTILS::ThreadPool* pool = app->GetThreadPool();
+	if(pool) pool->parallelFor(meshes.size(), build);
+	else
+	{
+		for(size_t i = 0; i < meshes.size(); i++)
+			build(i);
+	}
+
+	size_t triangleCount = 0;
+	std::vector<uint32_t> meshletStarts(meshes.size());
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		meshletStarts[i] = static_cast<uint32_t>(d_meshlets.size());
+		d_meshlets.insert(d_meshlets.end(), meshMeshlets[i].begin(), meshMeshlets[i].end());
+		triangleCount += meshes[i].indices.size() / 3;
+	}
+	// meshes sharing data share its meshlets
+	for(Mesh* mesh : d_meshes)
+	{
+		mesh->meshletStart = meshletStarts[mesh->geometryID];
+		mesh->meshletCount = static_cast<uint32_t>(meshMeshlets[mesh->geometryID].size());
+	}
 
-    	void* data;
-    	vkMapMemory(d_device, stagingBuffer.mem, 0, imageSize, 0, &data);
-    	memcpy(data, pixels, static_cast<size_t>(imageSize));
-    	vkUnmapMemory(d_device, stagingBuffer.mem);
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "meshlets built, " + std::to_string(d_meshlets.size()) + " meshlets for " +
+		std::to_string(triangleCount) + " triangles");}
+}
 
-    	stbi_image_free(pixels);
+void Graph::createMeshLods(std::vector<GraphUserInput>& meshes)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-		uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+	auto timeStart = std::chrono::steady_clock::now();
+	bool generate = app->GRAPH_GENERATE_LODS;
 
-    	newTexture.image = createTextureImage(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), mipLevels, VK_FORMAT_R8G8B8A8_SRGB,
-    	    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, stagingBuffer.buf);
+	std::vector<std::vector<std::vector<uint32_t>>> meshLods(meshes.size());
+	std::vector<std::vector<float>> meshErrors(meshes.size());
+	std::vector<glm::vec3> boundsCenters(meshes.size());
+	std::vector<float> boundsRadii(meshes.size());
+	auto simplify = [&](size_t i)
+	{
+		findMeshBounds(meshes[i].vertices, boundsCenters[i], boundsRadii[i]);
+		if(generate && !meshes[i].indices.empty())
+			generateMeshLods(meshes[i].indices, meshes[i].vertices, MESH_MAX_LODS, meshLods[i], meshErrors[i]);
+	};
+	UTILS::ThreadPool* pool = app->GetThreadPool();
+	if(pool) pool->parallelFor(meshes.size(), simplify);
+	else
+	{
+		for(size_t i = 0; i < meshes.size(); i++)
+			simplify(i);
+	}
 
-    	VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = 16.0f;
-		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable = VK_FALSE;
-		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = static_cast<float>(mipLevels);
+	// levels follow the full level in the indices of the mesh
+	size_t levelCount = 0;
+	size_t fullIndices = 0;
+	size_t lodIndices = 0;
+	std::vector<std::vector<MeshLod>> levels(meshes.size());
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		fullIndices += meshes[i].indices.size();
+		for(size_t l = 0; l < meshLods[i].size(); l++)
+		{
+			MeshLod lod;
+			lod.indiceOffset = static_cast<uint32_t>(meshes[i].indices.size());
+			lod.indiceCount = static_cast<uint32_t>(meshLods[i][l].size());
+			lod.error = meshErrors[i][l];
+			levels[i].push_back(lod);
+			meshes[i].indices.insert(meshes[i].indices.end(), meshLods[i][l].begin(), meshLods[i][l].end());
+			lodIndices += meshLods[i][l].size();
+		}
+		levelCount += meshLods[i].size();
+	}
+	// meshes sharing data share its levels
+	for(Mesh* mesh : d_meshes)
+	{
+		uint32_t geometryID = mesh->geometryID;
+		mesh->boundsCenter = boundsCenters[geometryID];
+		mesh->boundsRadius = boundsRadii[geometryID];
+		mesh->lodCount = static_cast<uint32_t>(levels[geometryID].size());
+		for(size_t l = 0; l < levels[geometryID].size(); l++)
+			mesh->lods[l] = levels[geometryID][l];
+	}
+	d_dynamic_draws = !d_meshlets.empty() || levelCount > 0;
 
-		if (vkCreateSampler(d_device, &samplerInfo, nullptr, &newTexture.sampler) != VK_SUCCESS)
-			throw std::runtime_error("ERROR: failed to create Vulkan texture sampler!");
+	if(myLogger && generate){myLogger->AddMessage(myLoggerOwner, "mesh LODs generated in " +
+		std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - timeStart).count()) + " ms, " +
+		std::to_string(levelCount) + " levels adding " + std::to_string(lodIndices) + " indices to " + std::to_string(fullIndices));}
+}
 
-		newTexture.allset = true;
+void Graph::createTexturesFromPaths(const std::set<std::string> paths)
+{
+	LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-    	stagingBuffer.destroy(d_device);
-    	
-		d_unique_textures.push_back(newTexture);
+	// decode on the workers and upload each image here as soon as it is done
+	// textures keep the set order, slots are reserved up front
+	std::vector<std::string> texturePaths(paths.begin(), paths.end());
+	std::vector<TextureData> textures(texturePaths.size());
+	std::vector<std::string> errors(texturePaths.size());
+	size_t slotBase = d_unique_textures.size();
+	d_unique_textures.resize(slotBase + texturePaths.size());
+	auto decodeTexture = [&](size_t i)
+	{
+		if(!loadTextureData(texturePaths[i], textures[i], errors[i]))
+			throw std::runtime_error("ERROR: failed to load image " + texturePaths[i] + "!\nSTB failure reason: " + errors[i]);
+		prepareTextureData(textures[i], d_texture_target);
+	};
+	auto uploadTexture = [&](size_t i)
+	{
+		d_unique_textures[slotBase + i] = createTextureFromData(textures[i], textures[i].pixels.data());
+		// pixels are on the GPU now
+		std::vector<unsigned char>().swap(textures[i].pixels);
+	};
+	UTILS::ThreadPool* pool = app->GetThreadPool();
+	if(pool) pool->parallelPipeline(texturePaths.size(), decodeTexture, uploadTexture);
+	else
+	{
+		for(size_t i = 0; i < texturePaths.size(); i++)
+		{
+			decodeTexture(i);
+			uploadTexture(i);
+		}
 	}
-	if(myLogger){myLogger->AddMessage(myLoggerOwner, "textures created from local image paths");}
+	if(myLogger){myLogger->AddMessage(myLoggerOwner, "textures created from local image paths, " + describeTextureMemory());}
 }
 
 Buffer Graph::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
@@ -761,21 +1590,59 @@ Buffer Graph::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemory
     VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(d_device, newBuffer.buf, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = app->GetBackend()->findDeviceMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if(vkAllocateMemory(d_device, &allocInfo, nullptr, &newBuffer.mem) != VK_SUCCESS)
-        throw std::runtime_error("ERROR: failed to allocate Vulkan memory for buffer!");
-    
-    vkBindBufferMemory(d_device, newBuffer.buf, newBuffer.mem, 0);
+    // placed in a shared block, host visible memory stays mapped
+    newBuffer.mem = app->GetBackend()->p_allocator->allocate(memRequirements, properties, true);
+    vkBindBufferMemory(d_device, newBuffer.buf, newBuffer.mem.memory, newBuffer.mem.offset);
     newBuffer.allset = true;
     return newBuffer;
 }
 
+Buffer Graph::createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	memcpy(p_uploads->stage(size, 4, stagingBuffer, stagingOffset), data, static_cast<size_t>(size));
+
+	Buffer newBuffer = createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	copyBufferToBuffer(stagingBuffer, newBuffer.buf, size, stagingOffset);
+	return newBuffer;
+}
+
+Texture Graph::createTextureFromData(const TextureData& texture, const unsigned char* pixels)
+{
+	Texture newTexture;
+
+	VkDeviceSize imageSize = texture.levelOffsets[texture.levels - 1] +
+		getTextureLevelSize(texture.format, texture.width, texture.height, texture.levels - 1);
+
+	// 16 byte alignment suits every texel and block size
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	memcpy(p_uploads->stage(imageSize, 16, stagingBuffer, stagingOffset), pixels, static_cast<size_t>(imageSize));
+
+	// block compressed levels cannot be blitted, the image only gets the levels that came with it
+	bool compressed = isTextureFormatCompressed(texture.format);
+	uint32_t mipLevels = compressed ? texture.levels : getTextureMipLevels(texture.width, texture.height);
+	d_texture_bytes += compressed ? imageSize : getTextureSize(texture.format, texture.width, texture.height, mipLevels);
+	VkFormat uncompressedFormat = texture.format;
+	if(compressed)
+		uncompressedFormat = texture.format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || texture.format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+			texture.format == VK_FORMAT_BC3_SRGB_BLOCK || texture.format == VK_FORMAT_BC7_SRGB_BLOCK ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	d_texture_bytes_uncompressed += getTextureSize(uncompressedFormat, texture.width, texture.height, getTextureMipLevels(texture.width, texture.height));
+
+	newTexture.image = createTextureImage(texture.width, texture.height, mipLevels, texture.format,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		stagingBuffer, stagingOffset, texture.levels, texture.levelOffsets.data());
+
+	newTexture.sampler = findSampler(SamplerParams());
+
+	newTexture.allset = true;
+	return newTexture;
+}
+
 Image Graph::createTextureImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat imageFormat,
-	VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer stagingBuffer)
+	VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer stagingBuffer, VkDeviceSize stagingOffset,
+	uint32_t levels, const VkDeviceSize* levelOffsets)
 {
     Image newImage;
 
@@ -801,26 +1668,29 @@ Image Graph::createTextureImage(uint32_t width, uint32_t height, uint32_t mipLev
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(d_device, newImage.image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = app->GetBackend()->findDeviceMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(d_device, &allocInfo, nullptr, &newImage.mem) != VK_SUCCESS)
-		throw std::runtime_error("ERROR: failed to allocate Vulkan image memory!");
+	newImage.mem = app->GetBackend()->p_allocator->allocate(memRequirements, properties, false);
+	vkBindImageMemory(d_device, newImage.image, newImage.mem.memory, newImage.mem.offset);
 
-	vkBindImageMemory(d_device, newImage.image, newImage.mem, 0);
-
-    transitionTextureImageLayout(newImage.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-    copyBufferToImage(stagingBuffer, newImage.image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-	createTextureImageMipmaps(newImage.image, imageFormat, static_cast<int32_t>(width), static_cast<int32_t>(height), mipLevels);
-    // transitionTextureImageLayout(newImage.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+    transitionTextureImageLayout(newImage.image, imageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+	// pre-mipped data only needs copies, otherwise blit the chain from level 0
+	if(levels >= mipLevels && levelOffsets)
+	{
+		copyBufferToImage(stagingBuffer, stagingOffset, newImage.image, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels, levelOffsets);
+		p_uploads->transferImage(newImage.image, mipLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+	else
+	{
+		// blits need the graphics queue
+		copyBufferToImage(stagingBuffer, stagingOffset, newImage.image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+		p_uploads->transferImage(newImage.image, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		createTextureImageMipmaps(newImage.image, imageFormat, static_cast<int32_t>(width), static_cast<int32_t>(height), mipLevels);
+	}
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = newImage.image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	viewInfo.format = imageFormat;
 	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.levelCount = mipLevels;
@@ -847,7 +1717,7 @@ void Graph::createTextureImageMipmaps(VkImage& image, VkFormat imageFormat, int3
 	if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
 		throw std::runtime_error("ERROR: failed to create mipmaps for texture image!");
 
-	VkCommandBuffer commandBuffer = app->GetRenderer()->startSingleCommand();
+	VkCommandBuffer commandBuffer = p_uploads->recordGraphics();
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -911,12 +1781,11 @@ void Graph::createTextureImageMipmaps(VkImage& image, VkFormat imageFormat, int3
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
         0, nullptr, 0, nullptr, 1, &barrier);
 
-	app->GetRenderer()->stopSingleCommand(commandBuffer);
 }
 
 void Graph::transitionTextureImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-    VkCommandBuffer commandBuffer = app->GetRenderer()->startSingleCommand();
+    VkCommandBuffer commandBuffer = p_uploads->record();
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -956,52 +1825,65 @@ void Graph::transitionTextureImageLayout(VkImage image, VkFormat format, VkImage
 	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage,
 		0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-	app->GetRenderer()->stopSingleCommand(commandBuffer);
 }
 
-void Graph::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void Graph::copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height,
+	uint32_t levels, const VkDeviceSize* levelOffsets)
 {
-    VkCommandBuffer commandBuffer = app->GetRenderer()->startSingleCommand();
+    VkCommandBuffer commandBuffer = p_uploads->record();
 
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { width, height, 1 };
+	std::vector<VkBufferImageCopy> regions(levels);
+	for(uint32_t level = 0; level < levels; level++)
+	{
+		VkBufferImageCopy& region = regions[level];
+		region = {};
+		region.bufferOffset = bufferOffset + (levelOffsets ? levelOffsets[level] : 0);
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+	}
 
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
 
-	app->GetRenderer()->stopSingleCommand(commandBuffer);
 }
 
-void Graph::copyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void Graph::copyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset)
 {
-    VkCommandBuffer commandBuffer = app->GetRenderer()->startSingleCommand();
+    VkCommandBuffer commandBuffer = p_uploads->record();
 
 	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
+	copyRegion.srcOffset = srcOffset;
 	copyRegion.dstOffset = 0;
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	p_uploads->transferBuffer(dstBuffer);
+}
 
-	app->GetRenderer()->stopSingleCommand(commandBuffer);
+void Graph::copyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions, VkDeviceSize srcOffset)
+{
+	if(regions.empty()) return;
+    VkCommandBuffer commandBuffer = p_uploads->record();
+
+	std::vector<VkBufferCopy> copyRegions(regions);
+	for(VkBufferCopy& copyRegion : copyRegions)
+		copyRegion.srcOffset += srcOffset;
+	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+	p_uploads->transferBuffer(dstBuffer);
 }
 
 void Graph::onFrameSizeChangeStart()
 {
-	for(auto& buffer : d_ubo_buffers)
-		buffer.destroy(d_device);
-	for(auto& buffers : d_node_uniform_buffers)
-	{
-		for(auto& buffer : buffers)
-			buffer.destroy(d_device);
-	}
-	app->GetRenderer()->freeRenderCommandBuffers(d_commands);
+	d_frame_buffer.destroy(d_device);
+	// the layouts are kept, the pipeline is recreated with them
+	vkDestroyDescriptorPool(d_device, d_descriptor_pool, nullptr);
+	d_descriptor_pool = VK_NULL_HANDLE;
+	freeRenderCommandBuffers();
 }
 
 void Graph::onFrameSizeChangeEnd()
@@ -1,156 +1,1088 @@
 #include "data.hpp"
 #include "files.hpp"
+#include "convert.hpp"
+#include "texture.hpp"
+#include "meshopt.hpp"
+#include "upload.hpp"
 
 #define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 #define STB_IMAGE_IMPLEMENTATION
 #include <tiny_gltf.h>
 #include <stdexcept>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
 
 #include "global.hpp"
 extern Application* app;
 
 using namespace DATA;
 
+// found while streaming a primitive into the staging buffer, filled by createMeshLods and writeVertexBuffer otherwise
+struct TinyGLTFStreamedGeometry
+{
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    glm::vec3 positionOffset = glm::vec3(0.0f); // VERTEX_FORMAT_QUANTIZED dequantization
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    uint64_t hash = 0; // of the dequantization and the staged vertex and index bytes, for deduplication
+};
+
+// a primitive waiting to be decoded by the worker threads
+// every (mesh, primitive) pair is decoded once, geometryID is its index in the job list
+struct TinyGLTFPrimitiveJob
+{
+    const tinygltf::Primitive* primitive;
+    uint32_t source; // index of the model in the loaded sources
+    uint32_t geometryID;
+    uint32_t vertexStart;
+    uint32_t vertexCount;
+    uint32_t indiceStart;
+    uint32_t indiceCount;
+};
+
+// (mesh index, primitive index) to geometryID
+typedef std::map<std::pair<int, size_t>, uint32_t> TinyGLTFGeometryMap;
+
+// encoded image bytes kept by the deferred image loader, indexed by image
+// images inside buffer views are read from model.buffers instead
+struct TinyGLTFImageDeferral
+{
+    std::vector<std::vector<unsigned char>> encoded;
+};
+
+// one glTF file of the scene, parsed on a worker
+// messages are kept here and logged by the loading thread
+struct TinyGLTFSource
+{
+    tinygltf::Model model;
+    TinyGLTFImageDeferral deferral;
+    std::string warn;
+    std::string err;
+    // .glb files are mapped, the BIN chunk buffer is read in place instead of from model.buffers
+    FILES::MappedFile file;
+    int binBuffer = -1;
+    const unsigned char* binData = nullptr;
+    size_t binSize = 0;
+    double parseMs = 0.0;
+    // process resident memory around parsing, the difference shows what mapping the .glb saves
+    size_t parseMemoryBefore = 0;
+    size_t parseMemoryAfter = 0;
+    size_t compressedViews = 0;
+    size_t externalFiles = 0;
+    bool externalRing = false; // external files were read through io_uring
+    std::vector<uint32_t> textureSlots; // d_unique_textures slot of every texture, 0 if unused
+};
+
+// an image used by the materials of one of the sources
+struct TinyGLTFImageRef
+{
+    size_t source;
+    int image;
+    bool color; // only sampled as base color or emissive, data maps are never block compressed
+};
+
+// a buffer view compressed with EXT_meshopt_compression
+// the compressed bytes are read from source, the decoded ones are written into a new buffer
+struct TinyGLTFMeshoptView
+{
+    int source;
+    size_t sourceOffset;
+    size_t sourceSize;
+    int buffer;
+    size_t count;
+    size_t stride;
+    MeshoptModes mode;
+    MeshoptFilters filter;
+};
+
 // helper functions
-VkFormat findTinyGLTFImageFormat(tinygltf::Image& image);
-void loadTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* parentNode,
-    uint32_t& vertexCount, uint32_t& indiceCount, std::vector<MeshConstantData>& d_mesh_constants,
-    std::vector<Node*>& d_nodes, std::vector<Mesh*>& d_meshes, std::vector<GraphUserInput>& returned_meshes);
+void parseTinyGLTFsource(const std::string& modelPath, bool binary, UTILS::ThreadPool* pool, TinyGLTFSource& source);
+bool parseTinyGLTFmappedGLB(tinygltf::TinyGLTF& loader, const std::string& modelPath, TinyGLTFSource& source, FILES::ReadBatch& files);
+void prefetchTinyGLTFfiles(const std::string& modelPath, bool binary, FILES::ReadBatch& files);
+void queueTinyGLTFfiles(const std::string& modelPath, const nlohmann::json& document, FILES::ReadBatch& files);
+bool findTinyGLTFfile(const std::string& filePath, FILES::ReadBatch& files, size_t& id);
+bool existsTinyGLTFfile(const std::string& filePath, void* userData);
+std::string expandTinyGLTFpath(const std::string& filePath, void* userData);
+bool readTinyGLTFfile(std::vector<unsigned char>* out, std::string* err, const std::string& filePath, void* userData);
+bool patchTinyGLTFfallbackBuffers(const std::string& modelPath, bool binary, std::string& patched);
+bool patchTinyGLTFfallbackJSON(nlohmann::json& document);
+const unsigned char* findTinyGLTFBufferData(const TinyGLTFSource& source, int buffer, size_t& size);
+int findTinyGLTFMeshoptEnum(const tinygltf::Value& extension, const char* name, const char* fallback,
+    const std::vector<std::string>& values);
+size_t decompressTinyGLTFbufferViews(TinyGLTFSource& source, UTILS::ThreadPool* pool);
+bool deferTinyGLTFImage(tinygltf::Image* image, const int imageID, std::string* err, std::string* warn,
+    int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData);
+bool findTinyGLTFImageData(const TinyGLTFSource& source, int imageID, const unsigned char*& bytes, size_t& size);
+void decodeTinyGLTFimage(const unsigned char* bytes, size_t size, const TextureTarget& target, TextureData& texture, std::string& error);
+void collectTinyGLTFImages(const tinygltf::Model& model, const tinygltf::Node& node, uint32_t slotBase,
+    std::vector<uint32_t>& textureSlots, std::vector<uint32_t>& imageSlots, std::vector<int>& usedImages, std::vector<bool>& dataImages);
+size_t deduplicateTinyGLTFImages(std::vector<TinyGLTFSource>& sources, uint32_t slotBase, std::vector<TinyGLTFImageRef>& usedImages);
+void layoutTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* parentNode,
+    uint32_t& vertexCount, uint32_t& indiceCount, const std::vector<uint32_t>& textureSlots, std::vector<MeshConstantData>& d_mesh_constants,
+    std::vector<Node*>& d_nodes, std::vector<Mesh*>& d_meshes, TinyGLTFGeometryMap& geometryIDs, std::vector<TinyGLTFPrimitiveJob>& jobs);
+void decodeTinyGLTFprimitive(const TinyGLTFSource& source, const TinyGLTFPrimitiveJob& job, GraphUserInput& output);
+void streamTinyGLTFprimitive(const TinyGLTFSource& source, const TinyGLTFPrimitiveJob& job, VertexFormats format,
+    GeometryStaging& staging, TinyGLTFStreamedGeometry& output);
+void findTinyGLTFVertexSources(const TinyGLTFSource& source, const tinygltf::Primitive& primitive, AttributeSource* sources);
+template<typename T>
+void copyTinyGLTFindices(const TinyGLTFSource& source, const tinygltf::Primitive& primitive, T* indices, size_t count, size_t first = 0);
+const unsigned char* findTinyGLTFAccessorData(const TinyGLTFSource& source, const tinygltf::Accessor& accessor);
+bool findTinyGLTFAttribute(const TinyGLTFSource& source, const tinygltf::Primitive& primitive, const std::string& name, AttributeSource& src);
 
 Graph::Graph(const std::string modelPath, VkDevice backendDevice)
+    : Graph(std::vector<GraphModel>(1, GraphModel(modelPath)), backendDevice)
 {
+}
+
+Graph::Graph(const std::vector<GraphModel>& models, VkDevice backendDevice)
+{
+    LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
+
+    d_time_created = std::chrono::steady_clock::now();
     d_device = backendDevice;
+    d_vertex_format = app->GRAPH_VERTEX_FORMAT;
+    initUploads();
     initTextures();
-    std::vector<GraphUserInput> meshes;
-    std::string ext = FILES::get_file_extension(modelPath);
-    if(ext == "gltf")
-        meshes = loadModelGLTF(modelPath, false);
-    else if(ext == "glb")
-        meshes = loadModelGLTF(modelPath, true);
-    else
-        throw std::runtime_error("ERROR: unsupported model type for " + modelPath);
-    createVertexBuffers(meshes);
-    createIndiceBuffers(meshes);
+    if(models.empty())
+        throw std::runtime_error("ERROR: no model is set for the graph");
+    for(auto& model : models)
+    {
+        std::string ext = FILES::get_file_extension(model.path);
+        if(ext != "gltf" && ext != "glb")
+            throw std::runtime_error("ERROR: unsupported model type for " + model.path);
+    }
+
+    // cooked cache sits next to the model, e.g. scene.gltf -> scene.wcache
+    // composed scenes are not cached, their parts are placed by the application
+    std::string cachePath;
+    if(models.size() == 1 && models[0].transform == glm::mat4(1.0f))
+    {
+        const std::string& modelPath = models[0].path;
+        cachePath = modelPath.substr(0, modelPath.size() - FILES::get_file_extension(modelPath).size()) + "wcache";
+    }
+    bool cached = app->GRAPH_ENABLE_SCENE_CACHE && !cachePath.empty() && loadSceneCache(cachePath);
+    // geometry only has to stay on the CPU for the mesh passes, deduplication and the cache work on the staged bytes
+    bool streamGeometry = app->GRAPH_STREAM_GEOMETRY && !app->GRAPH_WELD_MESHES && !app->GRAPH_OPTIMIZE_MESHES &&
+        !app->GRAPH_CULL_MESHLETS && !app->GRAPH_GENERATE_LODS;
+    bool saveCache = app->GRAPH_ENABLE_SCENE_CACHE && !cachePath.empty();
+    if(!cached)
+    {
+        std::vector<TextureData> textures;
+        std::vector<std::string> dependencies;
+        std::vector<unsigned char> vertexBlob;
+        std::vector<unsigned char> indiceBlob;
+        if(streamGeometry)
+        {
+            GeometryStaging staging;
+            staging.keepCopy = saveCache;
+            loadModelGLTF(models, textures, dependencies, &staging);
+            vertexBlob.swap(staging.vertexCopy);
+            indiceBlob.swap(staging.indiceCopy);
+        }
+        else
+        {
+            std::vector<GraphUserInput> meshes = loadModelGLTF(models, textures, dependencies);
+            deduplicateGeometry(meshes);
+            optimizeMeshes(meshes);
+            createMeshlets(meshes);
+            createMeshLods(meshes);
+            createVertexBuffers(meshes);
+            createIndiceBuffers(meshes);
+            if(saveCache) packSceneGeometry(meshes, vertexBlob, indiceBlob);
+        }
+        if(saveCache)
+        {
+            // with streaming textures the cache is written once the last one is uploaded
+            if(p_texture_stream)
+            {
+                p_texture_stream->cachePath = cachePath;
+                p_texture_stream->vertexBlob.swap(vertexBlob);
+                p_texture_stream->indiceBlob.swap(indiceBlob);
+                p_texture_stream->dependencies = std::move(dependencies);
+            }
+            else saveSceneCache(cachePath, vertexBlob, indiceBlob, textures, dependencies);
+        }
+    }
+    createInstanceBatches();
+    createMaterials();
     createUniformBuffers();
     createDescriptorSets();
+    // the first frame is submitted after the uploads, nothing has to wait for them here
+    p_uploads->submit();
+
+    if(myLogger){myLogger->AddMessage(myLoggerOwner, std::string("graph created from ") + (cached ? "scene cache" : "source model") +
+        (models.size() > 1 ? " (" + std::to_string(models.size()) + " models)" : std::string()) + " in " +
+        std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - d_time_created).count()) + " ms" +
+        (p_texture_stream ? ", textures are streaming" : ""));}
+    if(myLogger){myLogger->AddMessage(myLoggerOwner, "graph uploads: " + p_uploads->describe());}
 }
 
 // reference: https://github.com/syoyo/tinygltf/blob/master/examples/basic/main.cpp
 // reference: https://github.com/SaschaWillems/Vulkan-glTF-PBR/blob/master/base/VulkanglTFModel.hpp
-std::vector<GraphUserInput> Graph::loadModelGLTF(const std::string modelPath, bool binary)
+std::vector<GraphUserInput> Graph::loadModelGLTF(const std::vector<GraphModel>& models,
+    std::vector<TextureData>& textures, std::vector<std::string>& dependencies, GeometryStaging* staging)
 {
     LOGGING::Logger* myLogger = app->GetLogger();
     LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_GRAPH;
 
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
+    // parse every model on the workers, each one also decodes its compressed buffer views
+    // a single model is parsed on this thread and spreads its own work instead
+    auto timeStart = std::chrono::steady_clock::now();
+    UTILS::ThreadPool* pool = app->GetThreadPool();
+    std::vector<TinyGLTFSource> sources(models.size());
+    auto parseSource = [&](size_t i)
+    {
+        std::string ext = FILES::get_file_extension(models[i].path);
+        parseTinyGLTFsource(models[i].path, ext == "glb", pool, sources[i]);
+    };
+    if(pool && sources.size() > 1) pool->parallelFor(sources.size(), parseSource);
+    else
+    {
+        for(size_t i = 0; i < sources.size(); i++)
+            parseSource(i);
+    }
+    auto timeParsed = std::chrono::steady_clock::now();
+
+    double largestMs = 0.0;
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        TinyGLTFSource& source = sources[i];
+        if(!source.warn.empty())
+            if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf warn " + source.warn);}
+        if(!source.err.empty())
+            if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf error " + source.err);}
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model " + models[i].path + " parsed (" + std::to_string(source.parseMs) + " ms)");}
+        // other models parse on the workers at the same time, load one model alone for an exact figure
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model resident memory " + std::to_string(source.parseMemoryBefore >> 20) + " MB before parsing, " +
+            std::to_string(source.parseMemoryAfter >> 20) + " MB after (" + (source.file.data() ? "glb mapped" : "read into memory") + ")");}
+        if(source.compressedViews)
+            if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf meshopt buffer views decoded (" + std::to_string(source.compressedViews) + " views)");}
+        if(source.externalFiles)
+            if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf external files read (" + std::to_string(source.externalFiles) + " files, " +
+                (source.externalRing ? "io_uring" : "thread pool") + ")");}
+        largestMs = std::max(largestMs, source.parseMs);
+
+        // collect every file the model reads, used to validate the scene cache
+        std::string folder = FILES::get_file_folder(models[i].path);
+        folder = folder.empty() ? "" : folder + "/";
+        dependencies.push_back(models[i].path);
+        for(auto& buffer : source.model.buffers)
+            if(!buffer.uri.empty() && !tinygltf::IsDataURI(buffer.uri))
+                dependencies.push_back(folder + tinygltf::dlib::urldecode(buffer.uri));
+        for(auto& image : source.model.images)
+            if(!image.uri.empty() && !tinygltf::IsDataURI(image.uri))
+                dependencies.push_back(folder + tinygltf::dlib::urldecode(image.uri));
+    }
+    if(sources.size() > 1)
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, std::to_string(sources.size()) + " gltf models parsed in " +
+            std::to_string(std::chrono::duration<double, std::milli>(timeParsed - timeStart).count()) + " ms (largest " +
+            std::to_string(largestMs) + " ms)");}
+
+    // find the images used by materials of the default scenes
+    // every used image gets one slot in d_unique_textures, textures sharing an image share the slot
+    uint32_t slotBase = static_cast<uint32_t>(d_unique_textures.size());
+    std::vector<TinyGLTFImageRef> usedImages;
+    size_t imageCount = 0;
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        tinygltf::Model& model = sources[i].model;
+        std::vector<uint32_t>& textureSlots = sources[i].textureSlots;
+        textureSlots.assign(model.textures.size(), 0);
+        std::vector<uint32_t> imageSlots(model.images.size(), 0);
+        std::vector<int> sourceImages;
+        std::vector<bool> dataImages(model.images.size(), false);
+        for(int nodeID : model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0].nodes)
+            collectTinyGLTFImages(model, model.nodes[nodeID], slotBase + static_cast<uint32_t>(usedImages.size()),
+                textureSlots, imageSlots, sourceImages, dataImages);
+        for(int image : sourceImages)
+            usedImages.push_back(TinyGLTFImageRef{i, image, !dataImages[image]});
+        imageCount += model.images.size();
+        // Basis Universal needs a transcoder, textures without a plain source image stay empty
+        size_t basisTextures = 0;
+        for(size_t t = 0; t < model.textures.size(); t++)
+            if(model.textures[t].source < 0 && model.textures[t].extensions.count("KHR_texture_basisu"))
+                basisTextures++;
+        if(basisTextures)
+            if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model " + models[i].path + " has " + std::to_string(basisTextures) +
+                " KHR_texture_basisu textures without a fallback source, Basis Universal is not supported");}
+    }
+    // different images with the same encoded bytes (copied files, repeated embedded images) share a slot too
+    size_t mergedImages = deduplicateTinyGLTFImages(sources, slotBase, usedImages);
+    if(mergedImages)
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model shares " + std::to_string(mergedImages) + " images with identical content");}
+
+    // mip chains and block compression are done on the workers along with decoding, see initTextures
+    // block compression is lossy, it is only used for color images
+    TextureTarget target = d_texture_target;
+    TextureTarget dataTarget = target;
+    dataTarget.compress = false;
+    std::vector<bool> colorImages(usedImages.size());
+    for(size_t i = 0; i < usedImages.size(); i++)
+        colorImages[i] = usedImages[i].color;
+    d_unique_textures.resize(slotBase + usedImages.size());
+    auto findImageData = [&sources](const TinyGLTFImageRef& ref, const unsigned char*& bytes, size_t& size)
+    {
+        return findTinyGLTFImageData(sources[ref.source], ref.image, bytes, size);
+    };
+    if(app->GRAPH_STREAM_TEXTURES && pool && usedImages.size())
+    {
+        // decode in the background, the graph is drawn with the empty texture in the meantime
+        // encoded bytes are copied since the model is released when loading returns
+        // decoding starts after the primitives, so that geometry gets all the workers first
+        std::shared_ptr<TextureStream> stream = std::make_shared<TextureStream>();
+        stream->encoded.resize(usedImages.size());
+        stream->textures.resize(usedImages.size());
+        stream->errors.resize(usedImages.size());
+        stream->slots.resize(usedImages.size());
+        for(size_t i = 0; i < usedImages.size(); i++)
+        {
+            const unsigned char* bytes;
+            size_t size;
+            if(findImageData(usedImages[i], bytes, size))
+                stream->encoded[i].assign(bytes, bytes + size);
+            stream->slots[i] = slotBase + static_cast<uint32_t>(i);
+        }
+        p_texture_stream = stream;
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model textures queued for streaming (" + std::to_string(usedImages.size()) + " of " +
+            std::to_string(imageCount) + " images used)");}
+    }
+    else
+    {
+        // decode used images on the workers, each one is uploaded here as soon as it is done
+        textures.resize(usedImages.size());
+        std::vector<std::string> textureErrors(usedImages.size());
+        auto decodeTexture = [&](size_t i)
+        {
+            const unsigned char* bytes = nullptr;
+            size_t size = 0;
+            findImageData(usedImages[i], bytes, size);
+            decodeTinyGLTFimage(bytes, size, colorImages[i] ? target : dataTarget, textures[i], textureErrors[i]);
+        };
+        auto uploadTexture = [&](size_t i)
+        {
+            if(!textureErrors[i].empty())
+                if(myLogger){myLogger->AddMessage(myLoggerOwner, "failed to decode gltf image " + std::to_string(usedImages[i].image) + " of " +
+                    models[usedImages[i].source].path + " (" + textureErrors[i] + "), using empty texture");}
+            d_unique_textures[slotBase + i] = createTextureFromData(textures[i], textures[i].pixels.data());
+        };
+        if(pool) pool->parallelPipeline(usedImages.size(), decodeTexture, uploadTexture);
+        else
+        {
+            for(size_t i = 0; i < usedImages.size(); i++)
+            {
+                decodeTexture(i);
+                uploadTexture(i);
+            }
+        }
+        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model textures decoded and uploaded (" + std::to_string(usedImages.size()) + " of " +
+            std::to_string(imageCount) + " images used, " +
+            std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - timeParsed).count()) + " ms), " +
+            describeTextureMemory());}
+    }
+    for(auto& source : sources)
+        source.deferral.encoded.clear();
+    auto timeTextures = std::chrono::steady_clock::now();
 
+    d_meshes.resize(0);
+    d_nodes.resize(0);
+    d_mesh_constants.resize(0);
+    uint32_t vertex_count = 0;
+    uint32_t indice_count = 0;
+
+    // phase 1: lay out node and mesh tables, reserve vertex and indice ranges
+    // nodes instancing the same glTF mesh share one range, all models share the tables
+    std::vector<TinyGLTFPrimitiveJob> jobs;
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        tinygltf::Model& model = sources[i].model;
+        // models placed by the application hang below a root node carrying their transform
+        Node* rootNode = nullptr;
+        if(models[i].transform != glm::mat4(1.0f))
+        {
+            rootNode = new Node;
+            rootNode->nodeID = static_cast<uint32_t>(d_nodes.size());
+            rootNode->transformMat = models[i].transform;
+            d_nodes.push_back(rootNode);
+        }
+        size_t firstJob = jobs.size();
+        TinyGLTFGeometryMap geometryIDs;
+        for(int nodeID : model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0].nodes)
+        {
+            tinygltf::Node& node = model.nodes[nodeID];
+            layoutTinyGLTFnodes(model, node, rootNode, vertex_count, indice_count, sources[i].textureSlots,
+                d_mesh_constants, d_nodes, d_meshes, geometryIDs, jobs);
+        }
+        for(size_t j = firstJob; j < jobs.size(); j++)
+            jobs[j].source = static_cast<uint32_t>(i);
+    }
+    auto timeLayout = std::chrono::steady_clock::now();
+
+    // phase 2: decode primitives of all models into pre-sized output slots
+    // when streaming the slots are in the mapped staging buffer and nothing but the copy for the scene cache stays on the CPU
+    // biggest primitives go first so that the tail of the work is balanced
+    std::vector<GraphUserInput> returned_meshes(staging ? 0 : jobs.size());
+    std::vector<TinyGLTFStreamedGeometry> streamed(staging ? jobs.size() : 0);
+    if(staging)
+    {
+        std::vector<glm::uvec2> geometryCounts(jobs.size());
+        for(auto& job : jobs)
+            geometryCounts[job.geometryID] = glm::uvec2(job.vertexCount, job.indiceCount);
+        beginGeometryStaging(geometryCounts, *staging);
+    }
+    VertexFormats vertexFormat = d_vertex_format;
+    std::vector<size_t> order(jobs.size());
+    for(size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&jobs](size_t a, size_t b){
+        return (jobs[a].vertexCount + jobs[a].indiceCount) > (jobs[b].vertexCount + jobs[b].indiceCount);
+    });
+    std::atomic<long long> decodeWork(0);
+    auto decodeJob = [&](size_t i)
+    {
+        auto jobStart = std::chrono::steady_clock::now();
+        const TinyGLTFPrimitiveJob& job = jobs[order[i]];
+        if(staging) streamTinyGLTFprimitive(sources[job.source], job, vertexFormat, *staging, streamed[job.geometryID]);
+        else decodeTinyGLTFprimitive(sources[job.source], job, returned_meshes[job.geometryID]);
+        decodeWork += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - jobStart).count();
+    };
+    size_t threadCount = 1;
+    if(pool)
+    {
+        threadCount = pool->size() + 1;
+        pool->parallelFor(jobs.size(), decodeJob);
+    }
+    else
+    {
+        for(size_t i = 0; i < jobs.size(); i++)
+            decodeJob(i);
+    }
+    auto timeDecode = std::chrono::steady_clock::now();
+    if(staging)
+    {
+        std::vector<uint64_t> hashes(streamed.size());
+        for(size_t i = 0; i < streamed.size(); i++)
+            hashes[i] = streamed[i].hash;
+        // meshes sharing a geometry share its bounds and dequantization, merged geometries are equal in both
+        for(size_t i = 0; i < d_meshes.size(); i++)
+        {
+            const TinyGLTFStreamedGeometry& geometry = streamed[d_meshes[i]->geometryID];
+            d_meshes[i]->boundsCenter = geometry.boundsCenter;
+            d_meshes[i]->boundsRadius = geometry.boundsRadius;
+            d_mesh_constants[i].positionOffset = glm::vec4(geometry.positionOffset, 0.0f);
+            d_mesh_constants[i].positionScale = glm::vec4(geometry.positionScale, 1.0f);
+        }
+        deduplicateStagedGeometry(*staging, hashes);
+        endGeometryStaging(*staging);
+    }
+
+    if(myLogger)
+    {
+        double layoutMs = std::chrono::duration<double, std::milli>(timeLayout - timeTextures).count();
+        double decodeMs = std::chrono::duration<double, std::milli>(timeDecode - timeLayout).count();
+        double workMs = decodeWork.load() / 1000.0;
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "gltf layout pass " << layoutMs << " ms (" << d_nodes.size() << " nodes, " << d_meshes.size() << " primitives, "
+           << jobs.size() << " unique)";
+        myLogger->AddMessage(myLoggerOwner, ss.str());
+        ss.str("");
+        // summed job time is not a single threaded run, jobs sharing the cores take longer each
+        ss << "gltf decode pass " << decodeMs << " ms wall time on " << threadCount << " threads, " << workMs << " ms summed over jobs";
+        myLogger->AddMessage(myLoggerOwner, ss.str());
+        // the per model resident memory around parsing shows what mapping .glb files saves, this is the whole load
+        ss.str("");
+        ss << "gltf model successfully loaded, peak memory " << (LOGGING::getPeakMemoryUsage() >> 20) << " MB"
+           << (app->GRAPH_MAP_GLB ? " (glb files mapped)" : "");
+        myLogger->AddMessage(myLoggerOwner, ss.str());
+    }
+
+    // start streaming textures now that the geometry is decoded
+    if(p_texture_stream)
+    {
+        std::shared_ptr<TextureStream> stream = p_texture_stream;
+        for(size_t i = 0; i < stream->textures.size(); i++)
+        {
+            const TextureTarget& imageTarget = colorImages[i] ? target : dataTarget;
+            pool->submit([stream, i, imageTarget]()
+            {
+                if(stream->cancelled) return;
+                std::vector<unsigned char>& encoded = stream->encoded[i];
+                decodeTinyGLTFimage(encoded.data(), encoded.size(), imageTarget, stream->textures[i], stream->errors[i]);
+                std::vector<unsigned char>().swap(encoded);
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                stream->decoded.push_back(i);
+            });
+        }
+    }
+
+    return returned_meshes;
+}
+
+
+// helper functions
+
+// parse a model and decode its compressed buffer views, runs on a worker when models are loaded together
+void parseTinyGLTFsource(const std::string& modelPath, bool binary, UTILS::ThreadPool* pool, TinyGLTFSource& source)
+{
+    tinygltf::Model& model = source.model;
+    tinygltf::TinyGLTF loader;
     std::string path = std::string(GLOB_FILE_FOLDER) + "/" + modelPath;
 
-    if(binary)
+    // keep images encoded while parsing, only the used ones are decoded later
+    loader.SetImageLoader(deferTinyGLTFImage, &source.deferral);
+    // external buffers and images are read in one batch, tinygltf takes them from it instead of opening each file
+    FILES::ReadBatch files(pool);
+    tinygltf::FsCallbacks callbacks = {existsTinyGLTFfile, expandTinyGLTFpath, readTinyGLTFfile, tinygltf::WriteWholeFile, &files};
+    loader.SetFsCallbacks(callbacks);
+
+    auto timeStart = std::chrono::steady_clock::now();
+    source.parseMemoryBefore = LOGGING::getMemoryUsage();
+    std::string patched;
+    bool mapped = binary && app->GRAPH_MAP_GLB;
+    if(!mapped) prefetchTinyGLTFfiles(modelPath, binary, files);
+    if(mapped)
     {
-        if(!loader.LoadBinaryFromFile(&model, &err, &warn, path))
+        if(!parseTinyGLTFmappedGLB(loader, modelPath, source, files))
+            throw std::runtime_error("ERROR: failed to load gltf model " + path);
+    }
+    else if(patchTinyGLTFfallbackBuffers(modelPath, binary, patched))
+    {
+        bool loaded = binary ?
+            loader.LoadBinaryFromMemory(&model, &source.err, &source.warn, reinterpret_cast<const unsigned char*>(patched.data()),
+                static_cast<unsigned int>(patched.size()), tinygltf::GetBaseDir(path)) :
+            loader.LoadASCIIFromString(&model, &source.err, &source.warn, patched.data(),
+                static_cast<unsigned int>(patched.size()), tinygltf::GetBaseDir(path));
+        if(!loaded)
+            throw std::runtime_error("ERROR: failed to load gltf model " + path);
+        std::string().swap(patched);
+    }
+    else if(binary)
+    {
+        if(!loader.LoadBinaryFromFile(&model, &source.err, &source.warn, path))
             throw std::runtime_error("ERROR: failed to load gltf model " + path);
     }
     else
     {
-        if(!loader.LoadASCIIFromFile(&model, &err, &warn, path))
+        if(!loader.LoadASCIIFromFile(&model, &source.err, &source.warn, path))
             throw std::runtime_error("ERROR: failed to load gltf model " + path);
     }
 
-    if(!warn.empty())
-        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf warn " + warn);}
-    if(!err.empty())
-        if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf error " + err);}
+    if(model.scenes.empty())
+        throw std::runtime_error("ERROR: no scene found in gltf model " + path);
+    const tinygltf::Scene& scene = model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0];
+    for(int nodeID : scene.nodes)
+        if(nodeID < 0 || nodeID >= (int)model.nodes.size()) throw std::runtime_error("ERROR: failed to load gltf model " + path);
+
+    source.externalFiles = files.size();
+    source.externalRing = files.usesIOUring();
+    source.parseMemoryAfter = LOGGING::getMemoryUsage();
 
-    // first load all textures (pre-load)
-    for(size_t i = 0; i < model.textures.size(); i++)
+    // decode compressed vertex and index data before anything reads the accessors
+    source.compressedViews = decompressTinyGLTFbufferViews(source, pool);
+    source.parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - timeStart).count();
+}
+
+// EXT_meshopt_compression fallback buffers have no uri, which tinygltf cannot parse
+// they get a stub data uri in a copy of the model, their views are decoded from the compressed buffers instead
+// returns false if the model has none and can be loaded from the file as is
+bool patchTinyGLTFfallbackBuffers(const std::string& modelPath, bool binary, std::string& patched)
+{
+    FILES::MappedFile file;
+    if(!file.open(modelPath) || !file.size()) return false;
+    const unsigned char* bytes = file.data();
+    size_t jsonOffset = 0;
+    size_t jsonSize = file.size();
+    if(binary)
     {
-        tinygltf::Texture& tex = model.textures[i];
-        // TODO: Add support for sampler information as well
-        if(tex.source < 0) continue;
-        tinygltf::Image& image = model.images[tex.source];
-        std::vector<unsigned char>& pixels = image.image;
-        if(pixels.empty()) continue;
+        // 12 byte header followed by the JSON chunk
+        uint32_t chunkSize = 0;
+        if(file.size() < 20) return false;
+        memcpy(&chunkSize, bytes + 12, sizeof(chunkSize));
+        if(20 + static_cast<size_t>(chunkSize) > file.size()) return false;
+        jsonOffset = 20;
+        jsonSize = chunkSize;
+    }
+    const char* text = reinterpret_cast<const char*>(bytes + jsonOffset);
+    const char extension[] = "EXT_meshopt_compression";
+    if(std::search(text, text + jsonSize, extension, extension + sizeof(extension) - 1) == text + jsonSize) return false;
 
-        Texture newTexture;
+    nlohmann::json document = nlohmann::json::parse(text, text + jsonSize, nullptr, false);
+    if(document.is_discarded()) return false;
+    bool found = patchTinyGLTFfallbackJSON(document);
+    if(!found) return false;
 
-        VkDeviceSize imageSize = (uint64_t)image.height * (uint64_t)image.width * image.component;
+    std::string json = document.dump();
+    if(!binary)
+    {
+        patched = std::move(json);
+        return true;
+    }
+    // rebuild the container around the new JSON chunk, chunks stay 4 byte aligned
+    json.resize((json.size() + 3) & ~static_cast<size_t>(3), ' ');
+    size_t rest = file.size() - jsonOffset - jsonSize;
+    uint32_t header[5];
+    memcpy(header, bytes, 12);
+    header[2] = static_cast<uint32_t>(20 + json.size() + rest);
+    header[3] = static_cast<uint32_t>(json.size());
+    memcpy(&header[4], bytes + 16, sizeof(uint32_t));
+    patched.resize(header[2]);
+    memcpy(&patched[0], header, sizeof(header));
+    memcpy(&patched[20], json.data(), json.size());
+    if(rest) memcpy(&patched[20 + json.size()], bytes + jsonOffset + jsonSize, rest);
+    return true;
+}
 
-        Buffer stagingBuffer = createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+// parse only the JSON chunk of a mapped .glb, the BIN chunk stays in the mapping and is never copied
+// the BIN buffer and images in buffer views get stub data uris for tinygltf, the image views are restored after parsing
+bool parseTinyGLTFmappedGLB(tinygltf::TinyGLTF& loader, const std::string& modelPath, TinyGLTFSource& source, FILES::ReadBatch& files)
+{
+    FILES::MappedFile& file = source.file;
+    if(!file.open(modelPath) || file.size() < 20)
+    {
+        source.err += "cannot map " + modelPath + "\n";
+        return false;
+    }
+    // 12 byte header, JSON chunk, optional BIN chunk, chunk headers are length and type
+    const unsigned char* bytes = file.data();
+    uint32_t header[5];
+    memcpy(header, bytes, sizeof(header));
+    if(memcmp(bytes, "glTF", 4) != 0 || header[1] != 2 || memcmp(bytes + 16, "JSON", 4) != 0 ||
+        20 + static_cast<size_t>(header[3]) > file.size())
+    {
+        source.err += "invalid glb container " + modelPath + "\n";
+        return false;
+    }
+    const char* text = reinterpret_cast<const char*>(bytes + 20);
+    size_t binOffset = (20 + static_cast<size_t>(header[3]) + 3) & ~static_cast<size_t>(3);
+    if(binOffset + 8 <= file.size() && memcmp(bytes + binOffset + 4, "BIN\0", 4) == 0)
+    {
+        uint32_t binSize;
+        memcpy(&binSize, bytes + binOffset, sizeof(binSize));
+        if(binOffset + 8 + static_cast<size_t>(binSize) > file.size())
+        {
+            source.err += "invalid glb BIN chunk " + modelPath + "\n";
+            return false;
+        }
+        source.binData = bytes + binOffset + 8;
+        source.binSize = binSize;
+    }
 
-    	void* data;
-    	vkMapMemory(d_device, stagingBuffer.mem, 0, imageSize, 0, &data);
-    	memcpy(data, pixels.data(), static_cast<size_t>(imageSize));
-    	vkUnmapMemory(d_device, stagingBuffer.mem);
+    nlohmann::json document = nlohmann::json::parse(text, text + header[3], nullptr, false);
+    if(document.is_discarded())
+    {
+        source.err += "invalid glb JSON chunk " + modelPath + "\n";
+        return false;
+    }
+    queueTinyGLTFfiles(modelPath, document, files);
+    patchTinyGLTFfallbackJSON(document);
+    const char stub[] = "data:application/octet-stream;base64,AAAA";
+    // the first buffer without uri is the BIN chunk
+    auto buffers = document.find("buffers");
+    if(source.binData && buffers != document.end() && buffers->is_array() && !buffers->empty())
+    {
+        nlohmann::json& buffer = (*buffers)[0];
+        if(buffer.is_object() && buffer.find("uri") == buffer.end())
+        {
+            auto byteLength = buffer.find("byteLength");
+            if(byteLength == buffer.end() || !byteLength->is_number() || byteLength->get<size_t>() > source.binSize)
+            {
+                source.err += "glb BIN chunk is smaller than its buffer " + modelPath + "\n";
+                return false;
+            }
+            buffer["uri"] = stub;
+            buffer["byteLength"] = 3;
+            source.binBuffer = 0;
+        }
+    }
+    std::vector<std::pair<int, int>> imageViews;
+    auto images = document.find("images");
+    if(images != document.end() && images->is_array())
+    {
+        for(size_t i = 0; i < images->size(); i++)
+        {
+            nlohmann::json& image = (*images)[i];
+            auto view = image.find("bufferView");
+            if(!image.is_object() || view == image.end() || !view->is_number_integer()) continue;
+            imageViews.push_back(std::make_pair(static_cast<int>(i), view->get<int>()));
+            image.erase("bufferView");
+            image["uri"] = stub;
+        }
+    }
+
+    std::string json = document.dump();
+    std::string path = std::string(GLOB_FILE_FOLDER) + "/" + modelPath;
+    if(!loader.LoadASCIIFromString(&source.model, &source.err, &source.warn, json.data(),
+        static_cast<unsigned int>(json.size()), tinygltf::GetBaseDir(path)))
+        return false;
+    for(auto& imageView : imageViews)
+    {
+        if(imageView.second < 0 || imageView.second >= (int)source.model.bufferViews.size()) return false;
+        source.model.images[imageView.first].bufferView = imageView.second;
+        if(imageView.first < (int)source.deferral.encoded.size())
+            std::vector<unsigned char>().swap(source.deferral.encoded[imageView.first]);
+    }
+    return true;
+}
+
+// start reading the external files of a model before tinygltf parses it
+// the JSON is parsed an extra time for this, skipped if no uri can reference a file
+void prefetchTinyGLTFfiles(const std::string& modelPath, bool binary, FILES::ReadBatch& files)
+{
+    FILES::MappedFile file;
+    if(!file.open(modelPath) || !file.size()) return;
+    const unsigned char* bytes = file.data();
+    size_t jsonOffset = 0;
+    size_t jsonSize = file.size();
+    if(binary)
+    {
+        uint32_t chunkSize = 0;
+        if(file.size() < 20) return;
+        memcpy(&chunkSize, bytes + 12, sizeof(chunkSize));
+        if(20 + static_cast<size_t>(chunkSize) > file.size()) return;
+        jsonOffset = 20;
+        jsonSize = chunkSize;
+    }
+    const char* text = reinterpret_cast<const char*>(bytes + jsonOffset);
+    const char key[] = "\"uri\"";
+    if(std::search(text, text + jsonSize, key, key + sizeof(key) - 1) == text + jsonSize) return;
+    nlohmann::json document = nlohmann::json::parse(text, text + jsonSize, nullptr, false);
+    if(document.is_discarded()) return;
+    queueTinyGLTFfiles(modelPath, document, files);
+}
+
+// add the buffer and image uris that are not data uris to the batch and submit it
+// paths are relative to GLOB_FILE_FOLDER like the cache dependencies
+void queueTinyGLTFfiles(const std::string& modelPath, const nlohmann::json& document, FILES::ReadBatch& files)
+{
+    std::string folder = FILES::get_file_folder(modelPath);
+    folder = folder.empty() ? "" : folder + "/";
+    const char* lists[] = {"buffers", "images"};
+    for(const char* name : lists)
+    {
+        auto list = document.find(name);
+        if(list == document.end() || !list->is_array()) continue;
+        for(const nlohmann::json& item : *list)
+        {
+            if(!item.is_object()) continue;
+            auto uri = item.find("uri");
+            if(uri == item.end() || !uri->is_string()) continue;
+            std::string value = uri->get<std::string>();
+            if(value.empty() || tinygltf::IsDataURI(value)) continue;
+            files.add(folder + tinygltf::dlib::urldecode(value));
+        }
+    }
+    files.submit();
+}
 
-        VkFormat imageFormat = findTinyGLTFImageFormat(image);
+// tinygltf asks for GLOB_FILE_FOLDER/<model folder>/<decoded uri>, returns the batch id of that path
+bool findTinyGLTFfile(const std::string& filePath, FILES::ReadBatch& files, size_t& id)
+{
+    std::string root = std::string(GLOB_FILE_FOLDER) + "/";
+    if(filePath.compare(0, root.size(), root) != 0) return false;
+    return files.find(filePath.substr(root.size()), id);
+}
 
-        uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(image.width, image.height)))) + 1;
+// file system callbacks of tinygltf, files outside the batch use the defaults
+bool existsTinyGLTFfile(const std::string& filePath, void* userData)
+{
+    size_t id;
+    if(findTinyGLTFfile(filePath, *static_cast<FILES::ReadBatch*>(userData), id)) return true;
+    return tinygltf::FileExists(filePath, nullptr);
+}
 
-    	newTexture.image = createTextureImage(static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height), mipLevels, imageFormat,
-    	    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, stagingBuffer.buf);
+std::string expandTinyGLTFpath(const std::string& filePath, void* userData)
+{
+    size_t id;
+    if(findTinyGLTFfile(filePath, *static_cast<FILES::ReadBatch*>(userData), id)) return filePath;
+    return tinygltf::ExpandFilePath(filePath, nullptr);
+}
 
-    	VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = 16.0f;
-		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable = VK_FALSE;
-		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = static_cast<float>(mipLevels);
+bool readTinyGLTFfile(std::vector<unsigned char>* out, std::string* err, const std::string& filePath, void* userData)
+{
+    FILES::ReadBatch& files = *static_cast<FILES::ReadBatch*>(userData);
+    size_t id;
+    if(!findTinyGLTFfile(filePath, files, id)) return tinygltf::ReadWholeFile(out, err, filePath, nullptr);
+    files.wait(id);
+    if(files.failed(id))
+    {
+        if(err) (*err) += "failed to read " + filePath + "\n";
+        return false;
+    }
+    // the first reference takes the bytes, a file referenced again is read again
+    if(files.data(id).empty()) return tinygltf::ReadWholeFile(out, err, filePath, nullptr);
+    out->swap(files.data(id));
+    return true;
+}
 
-		if (vkCreateSampler(d_device, &samplerInfo, nullptr, &newTexture.sampler) != VK_SUCCESS)
-			throw std::runtime_error("ERROR: failed to create Vulkan texture sampler!");
+// bytes of a buffer, the BIN chunk of a mapped .glb is read from the mapping
+const unsigned char* findTinyGLTFBufferData(const TinyGLTFSource& source, int buffer, size_t& size)
+{
+    if(buffer == source.binBuffer)
+    {
+        size = source.binSize;
+        return source.binData;
+    }
+    const std::vector<unsigned char>& data = source.model.buffers[buffer].data;
+    size = data.size();
+    return data.data();
+}
 
-		newTexture.allset = true;
-    	stagingBuffer.destroy(d_device);
-        d_unique_textures.push_back(newTexture);
+// gives the EXT_meshopt_compression fallback buffers of a parsed document a stub data uri
+// returns false if there are none
+bool patchTinyGLTFfallbackJSON(nlohmann::json& document)
+{
+    const char extension[] = "EXT_meshopt_compression";
+    if(document.find("buffers") == document.end()) return false;
+    bool found = false;
+    for(nlohmann::json& buffer : document["buffers"])
+    {
+        if(!buffer.is_object() || buffer.find("uri") != buffer.end()) continue;
+        auto extensions = buffer.find("extensions");
+        if(extensions == buffer.end() || extensions->find(extension) == extensions->end()) continue;
+        const nlohmann::json& meshopt = (*extensions)[extension];
+        auto fallback = meshopt.find("fallback");
+        if(fallback == meshopt.end() || !fallback->is_boolean() || !fallback->get<bool>()) continue;
+        buffer["uri"] = "data:application/octet-stream;base64,AAAA";
+        buffer["byteLength"] = 3;
+        found = true;
     }
-    if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model textures successfully loaded");}
+    return found;
+}
 
-    d_meshes.resize(0);
-    d_nodes.resize(0);
-    d_mesh_constants.resize(0);
-    std::vector<GraphUserInput> returned_meshes;
-    uint32_t vertex_count = 0;
-    uint32_t indice_count = 0;
+// reads an EXT_meshopt_compression string property, returns -1 for unknown values
+int findTinyGLTFMeshoptEnum(const tinygltf::Value& extension, const char* name, const char* fallback,
+    const std::vector<std::string>& values)
+{
+    std::string value = fallback;
+    if(extension.Has(name) && extension.Get(name).IsString())
+        value = extension.Get(name).Get<std::string>();
+    for(size_t i = 0; i < values.size(); i++)
+        if(values[i] == value) return static_cast<int>(i);
+    return -1;
+}
 
-    returned_meshes.resize(0);
-    const tinygltf::Scene& scene = model.scenes[model.defaultScene];
-    for(int nodeID : scene.nodes)
+// decodes the buffer views compressed with EXT_meshopt_compression into new buffers
+// and points the views at them, so accessors read the decoded data like any other
+// returns the number of decoded views
+size_t decompressTinyGLTFbufferViews(TinyGLTFSource& source, UTILS::ThreadPool* pool)
+{
+    tinygltf::Model& model = source.model;
+    std::vector<TinyGLTFMeshoptView> views;
+    for(size_t i = 0; i < model.bufferViews.size(); i++)
     {
-        if(nodeID < 0 || nodeID >= (int)model.nodes.size()) throw std::runtime_error("ERROR: failed to load gltf model " + path);
-        tinygltf::Node& node = model.nodes[nodeID];
-        loadTinyGLTFnodes(model, node, nullptr, vertex_count, indice_count,
-            d_mesh_constants, d_nodes, d_meshes, returned_meshes);
+        tinygltf::BufferView& bufferView = model.bufferViews[i];
+        auto found = bufferView.extensions.find("EXT_meshopt_compression");
+        if(found == bufferView.extensions.end()) continue;
+        const tinygltf::Value& extension = found->second;
+        if(!extension.Has("buffer") || !extension.Has("byteLength") || !extension.Has("byteStride") || !extension.Has("count"))
+            throw std::runtime_error("ERROR: invalid EXT_meshopt_compression buffer view in gltf model");
+
+        TinyGLTFMeshoptView view;
+        view.source = extension.Get("buffer").GetNumberAsInt();
+        view.sourceOffset = extension.Has("byteOffset") ? static_cast<size_t>(extension.Get("byteOffset").GetNumberAsInt()) : 0;
+        view.sourceSize = static_cast<size_t>(extension.Get("byteLength").GetNumberAsInt());
+        view.stride = static_cast<size_t>(extension.Get("byteStride").GetNumberAsInt());
+        view.count = static_cast<size_t>(extension.Get("count").GetNumberAsInt());
+        int mode = findTinyGLTFMeshoptEnum(extension, "mode", "", {"ATTRIBUTES", "TRIANGLES", "INDICES"});
+        int filter = findTinyGLTFMeshoptEnum(extension, "filter", "NONE", {"NONE", "OCTAHEDRAL", "QUATERNION", "EXPONENTIAL"});
+        if(mode < 0 || filter < 0)
+            throw std::runtime_error("ERROR: unsupported EXT_meshopt_compression mode or filter in gltf model");
+        view.mode = static_cast<MeshoptModes>(mode);
+        view.filter = static_cast<MeshoptFilters>(filter);
+        size_t sourceSize = 0;
+        if(view.source >= 0 && view.source < (int)model.buffers.size())
+            findTinyGLTFBufferData(source, view.source, sourceSize);
+        if(view.source < 0 || view.source >= (int)model.buffers.size() ||
+           view.sourceOffset + view.sourceSize > sourceSize ||
+           view.count * view.stride > bufferView.byteLength)
+            throw std::runtime_error("ERROR: invalid EXT_meshopt_compression buffer view in gltf model");
+
+        // every view gets its own buffer, so that the workers never share an output
+        view.buffer = static_cast<int>(model.buffers.size());
+        model.buffers.emplace_back();
+        model.buffers.back().data.resize(bufferView.byteLength);
+        bufferView.buffer = view.buffer;
+        bufferView.byteOffset = 0;
+        if(view.mode == MESHOPT_MODE_ATTRIBUTES)
+            bufferView.byteStride = view.stride;
+        views.push_back(view);
     }
 
-    if(myLogger){myLogger->AddMessage(myLoggerOwner, "gltf model successfully loaded");}
+    auto decodeView = [&](size_t i)
+    {
+        const TinyGLTFMeshoptView& view = views[i];
+        size_t sourceSize;
+        const unsigned char* src = findTinyGLTFBufferData(source, view.source, sourceSize) + view.sourceOffset;
+        unsigned char* dst = model.buffers[view.buffer].data.data();
+        if(!decodeMeshoptBuffer(dst, view.count, view.stride, src, view.sourceSize, view.mode, view.filter))
+            throw std::runtime_error("ERROR: failed to decode EXT_meshopt_compression buffer view in gltf model");
+    };
+    if(pool) pool->parallelFor(views.size(), decodeView);
+    else
+    {
+        for(size_t i = 0; i < views.size(); i++)
+            decodeView(i);
+    }
+    return views.size();
+}
 
-    return returned_meshes;
+// keeps the encoded bytes so that decoding can be skipped or moved to the workers
+bool deferTinyGLTFImage(tinygltf::Image* image, const int imageID, std::string*, std::string*,
+    int, int, const unsigned char* bytes, int size, void* userData)
+{
+    // buffer view data stays alive in model.buffers
+    if(image->bufferView >= 0 || imageID < 0) return true;
+    TinyGLTFImageDeferral* deferral = static_cast<TinyGLTFImageDeferral*>(userData);
+    if(deferral->encoded.size() <= static_cast<size_t>(imageID))
+        deferral->encoded.resize(imageID + 1);
+    deferral->encoded[imageID].assign(bytes, bytes + size);
+    return true;
+}
+
+// finds the encoded bytes of an image, returns false if there are none
+bool findTinyGLTFImageData(const TinyGLTFSource& source, int imageID, const unsigned char*& bytes, size_t& size)
+{
+    const tinygltf::Model& model = source.model;
+    const TinyGLTFImageDeferral& deferral = source.deferral;
+    bytes = nullptr;
+    size = 0;
+    const tinygltf::Image& image = model.images[imageID];
+    if(image.bufferView >= 0)
+    {
+        const tinygltf::BufferView& view = model.bufferViews[image.bufferView];
+        size_t bufferSize;
+        const unsigned char* buffer = findTinyGLTFBufferData(source, view.buffer, bufferSize);
+        if(view.byteOffset + view.byteLength > bufferSize) return false;
+        bytes = buffer + view.byteOffset;
+        size = view.byteLength;
+    }
+    else if(imageID < (int)deferral.encoded.size())
+    {
+        bytes = deferral.encoded[imageID].data();
+        size = deferral.encoded[imageID].size();
+    }
+    return size > 0;
 }
 
+// runs on worker threads, failures are reported through error and never thrown
+void decodeTinyGLTFimage(const unsigned char* bytes, size_t size, const TextureTarget& target, TextureData& texture, std::string& error)
+{
+    try
+    {
+        if(!decodeTextureData(bytes, size, texture, error))
+        {
+            // fall back to a transparent black pixel, same as the empty texture
+            texture.width = texture.height = 1;
+            texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+            texture.pixels.assign(4, 0);
+        }
+        prepareTextureData(texture, target);
+    }
+    catch(const std::exception& e)
+    {
+        error = e.what();
+        texture = TextureData();
+        texture.width = texture.height = 1;
+        texture.pixels.assign(4, 0);
+    }
+}
 
+// walks the same primitives as layoutTinyGLTFnodes and assigns texture slots in first use order
+// images sampled as normal, metallic roughness or occlusion maps are marked in dataImages
+void collectTinyGLTFImages(const tinygltf::Model& model, const tinygltf::Node& node, uint32_t slotBase,
+    std::vector<uint32_t>& textureSlots, std::vector<uint32_t>& imageSlots, std::vector<int>& usedImages, std::vector<bool>& dataImages)
+{
+    if(node.mesh >= 0 && node.mesh < (int)model.meshes.size())
+    {
+        for(const tinygltf::Primitive& primitive : model.meshes[node.mesh].primitives)
+        {
+            if(primitive.attributes.find("POSITION") == primitive.attributes.end()) continue;
+            if(primitive.material < 0 || primitive.material >= (int)model.materials.size()) continue;
+            const tinygltf::Material& material = model.materials[primitive.material];
+            int used[] = {
+                material.pbrMetallicRoughness.baseColorTexture.index,
+                material.pbrMetallicRoughness.metallicRoughnessTexture.index,
+                material.normalTexture.index,
+                material.occlusionTexture.index,
+                material.emissiveTexture.index,
+            };
+            for(size_t u = 0; u < sizeof(used) / sizeof(used[0]); u++)
+            {
+                int textureID = used[u];
+                if(textureID < 0 || textureID >= (int)model.textures.size()) continue;
+                int imageID = model.textures[textureID].source;
+                if(imageID < 0 || imageID >= (int)model.images.size()) continue;
+                if(u >= 1 && u <= 3) dataImages[imageID] = true;
+                if(textureSlots[textureID]) continue;
+                if(!imageSlots[imageID])
+                {
+                    imageSlots[imageID] = slotBase + static_cast<uint32_t>(usedImages.size());
+                    usedImages.push_back(imageID);
+                }
+                textureSlots[textureID] = imageSlots[imageID];
+            }
+        }
+    }
+    for(int id : node.children)
+        if(id >= 0 && id < (int)model.nodes.size())
+            collectTinyGLTFImages(model, model.nodes[id], slotBase, textureSlots, imageSlots, usedImages, dataImages);
+}
 
-// helper functions
+// merges used images of all sources by a hash of their encoded bytes
+// compacts usedImages and remaps the texture slots of every source to match, returns the number of images merged
+size_t deduplicateTinyGLTFImages(std::vector<TinyGLTFSource>& sources, uint32_t slotBase, std::vector<TinyGLTFImageRef>& usedImages)
+{
+    auto findImageData = [&sources](const TinyGLTFImageRef& ref, const unsigned char*& bytes, size_t& size)
+    {
+        return findTinyGLTFImageData(sources[ref.source], ref.image, bytes, size);
+    };
+    std::vector<TinyGLTFImageRef> uniqueImages;
+    std::vector<uint32_t> remap(usedImages.size());
+    std::map<uint64_t, std::vector<size_t>> imagesByHash;
+    for(size_t i = 0; i < usedImages.size(); i++)
+    {
+        const unsigned char* bytes;
+        size_t size;
+        remap[i] = static_cast<uint32_t>(uniqueImages.size());
+        if(findImageData(usedImages[i], bytes, size))
+        {
+            // equal hashes are compared byte by byte before merging
+            std::vector<size_t>& candidates = imagesByHash[FILES::hash_bytes(bytes, size)];
+            bool merged = false;
+            for(size_t unique : candidates)
+            {
+                const unsigned char* otherBytes;
+                size_t otherSize;
+                findImageData(uniqueImages[unique], otherBytes, otherSize);
+                if(otherSize == size && memcmp(otherBytes, bytes, size) == 0)
+                {
+                    remap[i] = static_cast<uint32_t>(unique);
+                    uniqueImages[unique].color = uniqueImages[unique].color && usedImages[i].color;
+                    merged = true;
+                    break;
+                }
+            }
+            if(merged) continue;
+            candidates.push_back(uniqueImages.size());
+        }
+        uniqueImages.push_back(usedImages[i]);
+    }
+    size_t mergedCount = usedImages.size() - uniqueImages.size();
+    if(!mergedCount) return 0;
+    for(auto& source : sources)
+        for(auto& slot : source.textureSlots)
+            if(slot) slot = slotBase + remap[slot - slotBase];
+    usedImages.swap(uniqueImages);
+    return mergedCount;
+}
 
-void loadTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* parentNode,
-    uint32_t& vertexCount, uint32_t& indiceCount, std::vector<MeshConstantData>& d_mesh_constants,
-    std::vector<Node*>& d_nodes, std::vector<Mesh*>& d_meshes, std::vector<GraphUserInput>& returned_meshes)
+void layoutTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* parentNode,
+    uint32_t& vertexCount, uint32_t& indiceCount, const std::vector<uint32_t>& textureSlots, std::vector<MeshConstantData>& d_mesh_constants,
+    std::vector<Node*>& d_nodes, std::vector<Mesh*>& d_meshes, TinyGLTFGeometryMap& geometryIDs, std::vector<TinyGLTFPrimitiveJob>& jobs)
 {
     Node* newNode = new Node;
     newNode->parentNode = parentNode;
@@ -179,142 +1111,61 @@ void loadTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* paren
     }
     newNode->transformMat = localTransformation;
 
-    // load mesh data
+    // reserve mesh data, actual decoding happens later
     if(node.mesh >= 0 && node.mesh < (int)model.meshes.size())
     {
         tinygltf::Mesh& mesh = model.meshes[node.mesh];
         for(size_t i = 0; i < mesh.primitives.size(); i++)
         {
-            GraphUserInput newMeshInput;
+            tinygltf::Primitive& primitive = mesh.primitives[i];
+
+            // primitives without positions cannot be drawn
+            if(primitive.attributes.find("POSITION") == primitive.attributes.end()) continue;
+
             Mesh *newMesh = new Mesh;
             newMesh->nodeID = newNode->nodeID;
             newMesh->meshID = d_meshes.size();
             newNode->meshIDs.push_back(newMesh->meshID);
-            std::vector<Vertex> vertices;
-            vertices.resize(0);
-            std::vector<uint32_t> indices;
-            indices.resize(0);
 
-            tinygltf::Primitive& primitive = mesh.primitives[i];
-
-            // first find vertices
-            if(primitive.attributes.find("POSITION") == primitive.attributes.end()) return;
-            tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-            tinygltf::BufferView& posBufferView = model.bufferViews[posAccessor.bufferView];
-            const float* bufferPos = reinterpret_cast<const float*>(&(model.buffers[posBufferView.buffer].data[posAccessor.byteOffset + posBufferView.byteOffset]));
-            int posByteStride = posAccessor.ByteStride(posBufferView) ? posAccessor.ByteStride(posBufferView) / sizeof(float) : 3;
-
-            // next try to find normal
-            const float* bufferNormal = nullptr;
-            int normByteStride;
-            if(primitive.attributes.find("NORMAL") != primitive.attributes.end())
+            // only the first reference of a primitive reserves its data
+            std::pair<int, size_t> key(node.mesh, i);
+            auto found = geometryIDs.find(key);
+            if(found == geometryIDs.end())
             {
-                tinygltf::Accessor& normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                tinygltf::BufferView& normBufferView = model.bufferViews[normAccessor.bufferView];
-                bufferNormal = reinterpret_cast<const float*>(&(model.buffers[normBufferView.buffer].data[normAccessor.byteOffset + normBufferView.byteOffset]));
-                normByteStride = normAccessor.ByteStride(normBufferView) ? normAccessor.ByteStride(normBufferView) / sizeof(float) : 3;
-            }
+                TinyGLTFPrimitiveJob job;
+                job.primitive = &primitive;
+                job.geometryID = static_cast<uint32_t>(jobs.size());
 
-            // next try to find tangent
-            const float* bufferTangent = nullptr;
-            int tangByteStride;
-            if(primitive.attributes.find("TANGENT") != primitive.attributes.end())
-            {
-                tinygltf::Accessor& tangAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-                tinygltf::BufferView& tangBufferView = model.bufferViews[tangAccessor.bufferView];
-                bufferTangent = reinterpret_cast<const float*>(&(model.buffers[tangBufferView.buffer].data[tangAccessor.byteOffset + tangBufferView.byteOffset]));
-                tangByteStride = tangAccessor.ByteStride(tangBufferView) ? tangAccessor.ByteStride(tangBufferView) / sizeof(float) : 4;
-            }
-
-            // next try to find first texture coordinate
-            const float* bufferCoord0 = nullptr;
-            int coord0ByteStride;
-            if(primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end())
-            {
-                tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                tinygltf::BufferView& uvBufferView = model.bufferViews[uvAccessor.bufferView];
-                bufferCoord0 = reinterpret_cast<const float*>(&(model.buffers[uvBufferView.buffer].data[uvAccessor.byteOffset + uvBufferView.byteOffset]));
-                coord0ByteStride = uvAccessor.ByteStride(uvBufferView) ? uvAccessor.ByteStride(uvBufferView) / sizeof(float) : 2;
-            }
-
-            // finally try to find color
-            const float* bufferColor = nullptr;
-            int colorByteStride;
-            if(primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-            {
-                tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-                tinygltf::BufferView& colorBufferView = model.bufferViews[colorAccessor.bufferView];
-                bufferColor = reinterpret_cast<const float*>(&(model.buffers[colorBufferView.buffer].data[colorAccessor.byteOffset + colorBufferView.byteOffset]));
-                int defaultStride = colorAccessor.type == TINYGLTF_TYPE_VEC3 ? 3 : 4;
-                colorByteStride = colorAccessor.ByteStride(colorBufferView) ? colorAccessor.ByteStride(colorBufferView) / sizeof(float) : defaultStride;
-            }
-
-            // TODO: add joints and weight for skeleton in the future
-            for (size_t v = 0; v < posAccessor.count; v++)
-            {
-	    		Vertex vert{};
-	    		vert.pos = glm::make_vec3(&bufferPos[v * posByteStride]);
-	    		vert.normal = glm::normalize(glm::vec3(bufferNormal ? glm::make_vec3(&bufferNormal[v * normByteStride]) : glm::vec3(0.0f)));
-                vert.tangent = bufferTangent ? glm::vec4(glm::make_vec4(&bufferTangent[v * tangByteStride])) : glm::vec4(0.0f);
-	    		vert.coord = bufferCoord0 ? glm::make_vec2(&bufferCoord0[v * coord0ByteStride]) : glm::vec2(0.0f);
-                if(bufferColor && colorByteStride == 4)
-                    vert.color = glm::make_vec4(&bufferColor[v * colorByteStride]);
-                else if(bufferColor && colorByteStride == 3)
-                    vert.color = glm::vec4(glm::make_vec3(&bufferColor[v * colorByteStride]), 1.0f); // auto set alpha to 1
-                else
-                    vert.color = glm::vec4(0.0f);
-    
-	    		vertices.push_back(vert);
-	    	}
-            newMeshInput.vertices = vertices;
-            newMesh->vertexCount = vertices.size();
-            newMesh->vertexStart = vertexCount;
-            vertexCount += vertices.size();
-
-            // next try to find indices
-            if(primitive.indices > -1)
-            {
-                tinygltf::Accessor& accessor = model.accessors[primitive.indices];
-                tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-                tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+                tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+                job.vertexCount = static_cast<uint32_t>(posAccessor.count);
+                job.vertexStart = vertexCount;
+                vertexCount += job.vertexCount;
 
-                indices.resize(accessor.count);
-                const void *dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-
-                switch(accessor.componentType)
+                job.indiceCount = 0;
+                job.indiceStart = 0;
+                if(primitive.indices > -1)
                 {
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                    {
-                        const uint32_t* buf = static_cast<const uint32_t*>(dataPtr);
-                        for(size_t i = 0; i < accessor.count; i++)
-                            indices[i] = buf[i];
-                        break;
-                    }
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                    {
-                        const uint16_t* buf = static_cast<const uint16_t*>(dataPtr);
-                        for(size_t i = 0; i < accessor.count; i++)
-                            indices[i] = static_cast<uint32_t>(buf[i]);
-                        break;
-                    }
-                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    tinygltf::Accessor& accessor = model.accessors[primitive.indices];
+                    if(accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT &&
+                       accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+                       accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+                        throw std::runtime_error("ERROR: unsupported indice type failed to load gltf model");
+                    if(accessor.count)
                     {
-                        const uint8_t* buf = static_cast<const uint8_t*>(dataPtr);
-                        for(size_t i = 0; i < accessor.count; i++)
-                            indices[i] = static_cast<uint32_t>(buf[i]);
-                        break;
+                        job.indiceCount = static_cast<uint32_t>(accessor.count);
+                        job.indiceStart = indiceCount;
+                        indiceCount += job.indiceCount;
                     }
-                    default:
-                        throw std::runtime_error("ERROR: unsupported indice type failed to load gltf model");
                 }
+                found = geometryIDs.insert(std::make_pair(key, job.geometryID)).first;
+                jobs.push_back(job);
             }
-            newMeshInput.indices = indices;
-            if(indices.size())
-            {
-                newMesh->indiceCount = indices.size();
-                newMesh->indiceStart = indiceCount;
-                indiceCount += indices.size();
-            }
+            const TinyGLTFPrimitiveJob& geometry = jobs[found->second];
+            newMesh->geometryID = geometry.geometryID;
+            newMesh->vertexStart = geometry.vertexStart;
+            newMesh->vertexCount = geometry.vertexCount;
+            newMesh->indiceStart = geometry.indiceStart;
+            newMesh->indiceCount = geometry.indiceCount;
 
             // TODO: update when structure changed
             MeshConstantData meshConstantData{};
@@ -322,43 +1173,43 @@ void loadTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* paren
             // next try to get the corresponding texture
             // TODO: add support for emissive factor
             // TODO: add support for alpha mode
-            tinygltf::Material& material = model.materials[primitive.material];
-            tinygltf::TextureInfo& info_base = material.pbrMetallicRoughness.baseColorTexture;
-            tinygltf::TextureInfo& info_rough = material.pbrMetallicRoughness.metallicRoughnessTexture;
-            tinygltf::NormalTextureInfo& info_normal = material.normalTexture;
-            tinygltf::OcclusionTextureInfo& info_occlusion = material.occlusionTexture;
-            tinygltf::TextureInfo& info_emissive = material.emissiveTexture;
-
-            if(info_base.index >= 0 && info_base.index < (int)model.textures.size())
-            {
-                newMesh->texBase = info_base.index + 1;
-                meshConstantData.hasBase = 1.0f;
-            }
-            if(info_rough.index >= 0 && info_rough.index < (int)model.textures.size())
-            {
-                newMesh->texRough = info_rough.index + 1;
-                meshConstantData.hasRough = 1.0f;
-            }
-            if(info_normal.index >= 0 && info_normal.index < (int)model.textures.size())
+            if(primitive.material >= 0 && primitive.material < (int)model.materials.size())
             {
-                newMesh->texNormal = info_normal.index + 1;
-                meshConstantData.hasNormal = 1.0f;
-            }
-            if(info_occlusion.index >= 0 && info_occlusion.index < (int)model.textures.size())
-            {
-                newMesh->texOcclusion = info_occlusion.index + 1;
-                meshConstantData.hasOcclusion = 1.0f;
-            }
-            if(info_emissive.index >= 0 && info_emissive.index < (int)model.textures.size())
-            {
-                newMesh->texEmissive = info_emissive.index + 1;
-                meshConstantData.hasEmissive = 1.0f;
+                tinygltf::Material& material = model.materials[primitive.material];
+                tinygltf::TextureInfo& info_base = material.pbrMetallicRoughness.baseColorTexture;
+                tinygltf::TextureInfo& info_rough = material.pbrMetallicRoughness.metallicRoughnessTexture;
+                tinygltf::NormalTextureInfo& info_normal = material.normalTexture;
+                tinygltf::OcclusionTextureInfo& info_occlusion = material.occlusionTexture;
+                tinygltf::TextureInfo& info_emissive = material.emissiveTexture;
+
+                if(info_base.index >= 0 && info_base.index < (int)textureSlots.size() && textureSlots[info_base.index])
+                {
+                    newMesh->texBase = textureSlots[info_base.index];
+                    meshConstantData.hasBase = 1.0f;
+                }
+                if(info_rough.index >= 0 && info_rough.index < (int)textureSlots.size() && textureSlots[info_rough.index])
+                {
+                    newMesh->texRough = textureSlots[info_rough.index];
+                    meshConstantData.hasRough = 1.0f;
+                }
+                if(info_normal.index >= 0 && info_normal.index < (int)textureSlots.size() && textureSlots[info_normal.index])
+                {
+                    newMesh->texNormal = textureSlots[info_normal.index];
+                    meshConstantData.hasNormal = 1.0f;
+                }
+                if(info_occlusion.index >= 0 && info_occlusion.index < (int)textureSlots.size() && textureSlots[info_occlusion.index])
+                {
+                    newMesh->texOcclusion = textureSlots[info_occlusion.index];
+                    meshConstantData.hasOcclusion = 1.0f;
+                }
+                if(info_emissive.index >= 0 && info_emissive.index < (int)textureSlots.size() && textureSlots[info_emissive.index])
+                {
+                    newMesh->texEmissive = textureSlots[info_emissive.index];
+                    meshConstantData.hasEmissive = 1.0f;
+                }
             }
 
             d_mesh_constants.push_back(meshConstantData);
-
-            newMeshInput.textureImagePath = "";
-            returned_meshes.push_back(newMeshInput);
             d_meshes.push_back(newMesh);
         }
     }
@@ -369,38 +1220,214 @@ void loadTinyGLTFnodes(tinygltf::Model& model, tinygltf::Node& node, Node* paren
     for(int id : node.children)
     {
         tinygltf::Node& childNode = model.nodes[id];
-        loadTinyGLTFnodes(model, childNode, newNode, vertexCount, indiceCount,
-            d_mesh_constants, d_nodes, d_meshes, returned_meshes);
+        layoutTinyGLTFnodes(model, childNode, newNode, vertexCount, indiceCount, textureSlots,
+            d_mesh_constants, d_nodes, d_meshes, geometryIDs, jobs);
     }
 }
 
-VkFormat findTinyGLTFImageFormat(tinygltf::Image& image)
+// runs on worker threads, only touches its own output slot
+void decodeTinyGLTFprimitive(const TinyGLTFSource& source, const TinyGLTFPrimitiveJob& job, GraphUserInput& output)
 {
-    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
-    if(image.component == 1)
+    const tinygltf::Primitive& primitive = *job.primitive;
+    std::vector<Vertex>& vertices = output.vertices;
+    std::vector<uint32_t>& indices = output.indices;
+    vertices.resize(job.vertexCount);
+    indices.resize(job.indiceCount);
+    output.textureImagePath = "";
+
+    // convert every attribute in bulk into the interleaved vertices
+    // missing attributes are written as zero
+    AttributeSource sources[VERTEX_ATTRIBUTE_COUNT];
+    findTinyGLTFVertexSources(source, primitive, sources);
+    convertVertices(vertices.data(), vertices.size(), sources);
+
+    // next try to find indices
+    copyTinyGLTFindices(source, primitive, indices.data(), indices.size());
+}
+
+// runs on worker threads, packs a primitive straight into its slots of the mapped staging buffer
+// vertices and indices are converted in chunks that stay in cache, the mapped memory is only written, never read back
+// the chunks are hashed for deduplication before they are copied out, and also copied to the CPU copy if the staging keeps one
+// a first pass over the positions finds the bounds needed before packing
+void streamTinyGLTFprimitive(const TinyGLTFSource& source, const TinyGLTFPrimitiveJob& job, VertexFormats format,
+    GeometryStaging& staging, TinyGLTFStreamedGeometry& output)
+{
+    const tinygltf::Primitive& primitive = *job.primitive;
+    AttributeSource sources[VERTEX_ATTRIBUTE_COUNT];
+    findTinyGLTFVertexSources(source, primitive, sources);
+
+    const size_t chunkSize = 1024;
+    std::vector<Vertex> chunk(std::min<size_t>(chunkSize, job.vertexCount));
+    // sources of the chunk starting at vertex first
+    auto chunkSources = [&sources](size_t first, AttributeSource* shifted)
     {
-        if(image.bits == 8) format = VK_FORMAT_R8_SRGB;
-        else if(image.bits == 16) format = VK_FORMAT_R16_UNORM;
-        else throw std::runtime_error("ERROR: unsupported tinygltf image bits");
+        for(uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++)
+        {
+            shifted[a] = sources[a];
+            if(!sources[a].data) continue;
+            if(sources[a].count <= first)
+            {
+                shifted[a].data = nullptr;
+                shifted[a].count = 0;
+                continue;
+            }
+            shifted[a].data += first * sources[a].stride;
+            shifted[a].count -= first;
+        }
+    };
+
+    // same bounds as findMeshBounds and findVertexQuantization, only the positions are converted
+    glm::vec3 minPos(0.0f), maxPos(0.0f);
+    size_t positionCount = sources[VERTEX_POSITION].data ? std::min<size_t>(job.vertexCount, sources[VERTEX_POSITION].count) : 0;
+    for(size_t first = 0; first < positionCount; first += chunkSize)
+    {
+        size_t count = std::min(chunkSize, positionCount - first);
+        AttributeSource shifted[VERTEX_ATTRIBUTE_COUNT];
+        chunkSources(first, shifted);
+        convertVertexAttribute(chunk.data(), count, VERTEX_POSITION, shifted[VERTEX_POSITION]);
+        if(!first) minPos = maxPos = chunk[0].pos;
+        for(size_t i = 0; i < count; i++)
+        {
+            minPos = glm::min(minPos, chunk[i].pos);
+            maxPos = glm::max(maxPos, chunk[i].pos);
+        }
+    }
+    output.boundsCenter = (minPos + maxPos) * 0.5f;
+    if(format == VERTEX_FORMAT_QUANTIZED && job.vertexCount)
+    {
+        output.positionOffset = minPos;
+        output.positionScale = maxPos - minPos;
+    }
+    // equal bytes only mean equal vertices with the same dequantization
+    uint64_t hash = FILES::hash_bytes(&output.positionOffset, sizeof(glm::vec3));
+    hash = FILES::hash_bytes(&output.positionScale, sizeof(glm::vec3), hash);
+
+    // packed chunk, copied to the mapped memory in one go
+    size_t stride = getVertexFormatStride(format);
+    std::vector<unsigned char> packed(std::min<size_t>(chunkSize, std::max<size_t>(job.vertexCount, job.indiceCount)) * stride);
+    auto copyOut = [&](VkDeviceSize offset, size_t size)
+    {
+        hash = FILES::hash_bytes(packed.data(), size, hash);
+        memcpy(staging.mapped + offset, packed.data(), size);
+    };
+    VkDeviceSize vertexOffset = (VkDeviceSize)job.vertexStart * stride;
+    float radius2 = 0.0f;
+    for(size_t first = 0; first < job.vertexCount; first += chunkSize)
+    {
+        size_t count = std::min(chunkSize, job.vertexCount - first);
+        AttributeSource shifted[VERTEX_ATTRIBUTE_COUNT];
+        chunkSources(first, shifted);
+        convertVertices(chunk.data(), count, shifted);
+        for(size_t i = 0; i < count; i++)
+            radius2 = std::max(radius2, glm::dot(chunk[i].pos - output.boundsCenter, chunk[i].pos - output.boundsCenter));
+        packVertices(chunk.data(), count, format, output.positionOffset, output.positionScale, packed.data());
+        copyOut(vertexOffset + first * stride, count * stride);
+        if(staging.keepCopy)
+            memcpy(staging.vertexCopy.data() + vertexOffset + first * stride, packed.data(), count * stride);
     }
-    else if(image.component == 2)
+    output.boundsRadius = std::sqrt(radius2);
+
+    // the stride is at least 4 bytes, so a chunk of indices fits into packed
+    bool indices16 = staging.indiceTypes[job.geometryID] == VK_INDEX_TYPE_UINT16;
+    size_t indiceSize = indices16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    VkDeviceSize indiceOffset = staging.indiceByteOffset(job.geometryID);
+    for(size_t first = 0; first < job.indiceCount; first += chunkSize)
     {
-        if(image.bits == 8) format = VK_FORMAT_R8G8_SRGB;
-        else if(image.bits == 16) format = VK_FORMAT_R16G16_UNORM;
-        else throw std::runtime_error("ERROR: unsupported tinygltf image bits");
+        size_t count = std::min<size_t>(chunkSize, job.indiceCount - first);
+        if(indices16) copyTinyGLTFindices(source, primitive, reinterpret_cast<uint16_t*>(packed.data()), count, first);
+        else copyTinyGLTFindices(source, primitive, reinterpret_cast<uint32_t*>(packed.data()), count, first);
+        copyOut(staging.indiceOffset + indiceOffset + first * indiceSize, count * indiceSize);
+        if(staging.keepCopy)
+            memcpy(staging.indiceCopy.data() + indiceOffset + first * indiceSize, packed.data(), count * indiceSize);
     }
-    else if(image.component == 3)
+    output.hash = hash;
+}
+
+// strided attribute sources of a primitive, indexed by VertexAttributes
+// TODO: add joints and weight for skeleton in the future
+void findTinyGLTFVertexSources(const TinyGLTFSource& source, const tinygltf::Primitive& primitive, AttributeSource* sources)
+{
+    findTinyGLTFAttribute(source, primitive, "POSITION", sources[VERTEX_POSITION]);
+    findTinyGLTFAttribute(source, primitive, "NORMAL", sources[VERTEX_NORMAL]);
+    findTinyGLTFAttribute(source, primitive, "TANGENT", sources[VERTEX_TANGENT]);
+    findTinyGLTFAttribute(source, primitive, "TEXCOORD_0", sources[VERTEX_COORD]);
+    findTinyGLTFAttribute(source, primitive, "COLOR_0", sources[VERTEX_COLOR]);
+}
+
+// write count indices of a primitive starting at index first into indices, T is uint16_t only if every index fits
+template<typename T>
+void copyTinyGLTFindices(const TinyGLTFSource& source, const tinygltf::Primitive& primitive, T* indices, size_t count, size_t first)
+{
+    if(!count) return;
+    const tinygltf::Accessor& accessor = source.model.accessors[primitive.indices];
+    const void *dataPtr = findTinyGLTFAccessorData(source, accessor);
+
+    switch(accessor.componentType)
+    {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        {
+            const uint32_t* buf = static_cast<const uint32_t*>(dataPtr) + first;
+            for(size_t i = 0; i < count; i++)
+                indices[i] = static_cast<T>(buf[i]);
+            break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            const uint16_t* buf = static_cast<const uint16_t*>(dataPtr) + first;
+            for(size_t i = 0; i < count; i++)
+                indices[i] = static_cast<T>(buf[i]);
+            break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        {
+            const uint8_t* buf = static_cast<const uint8_t*>(dataPtr) + first;
+            for(size_t i = 0; i < count; i++)
+                indices[i] = static_cast<T>(buf[i]);
+            break;
+        }
+        default:
+            throw std::runtime_error("ERROR: unsupported indice type failed to load gltf model");
+    }
+}
+
+const unsigned char* findTinyGLTFAccessorData(const TinyGLTFSource& source, const tinygltf::Accessor& accessor)
+{
+    const tinygltf::BufferView& bufferView = source.model.bufferViews[accessor.bufferView];
+    size_t size;
+    return findTinyGLTFBufferData(source, bufferView.buffer, size) + accessor.byteOffset + bufferView.byteOffset;
+}
+
+bool findTinyGLTFAttribute(const TinyGLTFSource& source, const tinygltf::Primitive& primitive, const std::string& name, AttributeSource& src)
+{
+    const tinygltf::Model& model = source.model;
+    auto it = primitive.attributes.find(name);
+    if(it == primitive.attributes.end()) return false;
+    const tinygltf::Accessor& accessor = model.accessors[it->second];
+    if(accessor.bufferView < 0) return false;
+
+    // integer types other than the normalized colors come from KHR_mesh_quantization
+    bool normalized = accessor.normalized;
+    switch(accessor.componentType)
     {
-        if(image.bits == 8) format = VK_FORMAT_R8G8B8_SRGB;
-        else if(image.bits == 16) format = VK_FORMAT_R16G16B16_UNORM;
-        else throw std::runtime_error("ERROR: unsupported tinygltf image bits");
+        case TINYGLTF_COMPONENT_TYPE_FLOAT: src.type = ATTRIBUTE_FLOAT; break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: src.type = normalized ? ATTRIBUTE_UNORM8 : ATTRIBUTE_UINT8; break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: src.type = normalized ? ATTRIBUTE_UNORM16 : ATTRIBUTE_UINT16; break;
+        case TINYGLTF_COMPONENT_TYPE_BYTE: src.type = normalized ? ATTRIBUTE_SNORM8 : ATTRIBUTE_SINT8; break;
+        case TINYGLTF_COMPONENT_TYPE_SHORT: src.type = normalized ? ATTRIBUTE_SNORM16 : ATTRIBUTE_SINT16; break;
+        default: throw std::runtime_error("ERROR: unsupported component type for gltf attribute " + name);
     }
-    else if(image.component == 4)
+    switch(accessor.type)
     {
-        if(image.bits == 8) format = VK_FORMAT_R8G8B8A8_SRGB;
-        else if(image.bits == 16) format = VK_FORMAT_R16G16B16A16_UNORM;
-        else throw std::runtime_error("ERROR: unsupported tinygltf image bits");
+        case TINYGLTF_TYPE_VEC2: src.components = 2; break;
+        case TINYGLTF_TYPE_VEC3: src.components = 3; break;
+        case TINYGLTF_TYPE_VEC4: src.components = 4; break;
+        default: throw std::runtime_error("ERROR: unsupported type for gltf attribute " + name);
     }
-    else throw std::runtime_error("ERROR: unsupported tinygltf image component");
-    return format;
+    int stride = accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+    if(stride <= 0)
+        throw std::runtime_error("ERROR: invalid byte stride for gltf attribute " + name);
+    src.data = findTinyGLTFAccessorData(source, accessor);
+    src.count = accessor.count;
+    src.stride = static_cast<size_t>(stride);
+    return true;
 }
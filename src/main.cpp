@@ -21,9 +21,12 @@ int main()
     app->WINDOW_RESIZABLE = true;
     app->LOGGER_SAVE_LOG = true;
 
+    // set vertex format, compact and quantized vertices use their own vertex shader
+    app->GRAPH_VERTEX_FORMAT = DATA::VERTEX_FORMAT_FULL;
+
     // set shader resources
     DATA::ShaderSourceDetails details;
-    details.names.push_back("simple.vert.spv");
+    details.names.push_back(app->GRAPH_VERTEX_FORMAT == DATA::VERTEX_FORMAT_FULL ? "simple.vert.spv" : "compact.vert.spv");
     details.types.push_back(DATA::SHADER_VERTEX);
     details.names.push_back("simple.frag.spv");
     details.types.push_back(DATA::SHADER_FRAGMENT);
@@ -63,6 +66,7 @@ int main()
     app->CAMERA_ZOOM_SCALE = 0.01f;
     app->CAMERA_SPEED = 10.0f;
     app->StartCamera();
+    app->StartThreadPool();
 
     app->GRAPH_MODEL_PATH = "resources/wasteland_sword/scene.gltf";
 
@@ -0,0 +1,334 @@
+#include "memory.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <sstream>
+
+using namespace DATA;
+
+// helper functions
+uint32_t findMemoryOrder(VkDeviceSize size);
+
+void MemoryAllocation::free()
+{
+    if(allocator)
+        allocator->free(*this);
+}
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize)
+{
+    d_device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &d_memory_properties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    d_buffer_image_granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    d_non_coherent_atom_size = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+    d_max_allocations = properties.limits.maxMemoryAllocationCount;
+
+    // pool 2 * type holds buffers, 2 * type + 1 optimal images
+    // both kinds only share blocks if they cannot end up on the same granularity page
+    d_pools.resize(2 * d_memory_properties.memoryTypeCount);
+    d_statistics.resize(d_memory_properties.memoryTypeCount);
+    for(uint32_t type = 0; type < d_memory_properties.memoryTypeCount; type++)
+    {
+        // an eighth of the heap at most, so small heaps are not taken by one block
+        VkDeviceSize heapSize = d_memory_properties.memoryHeaps[d_memory_properties.memoryTypes[type].heapIndex].size;
+        VkDeviceSize limit = std::min<VkDeviceSize>(blockSize, heapSize / 8);
+        uint32_t blockOrder = MIN_BUDDY_ORDER + 1;
+        while((VkDeviceSize(2) << blockOrder) <= limit) blockOrder++;
+        for(uint32_t kind = 0; kind < 2; kind++)
+        {
+            Pool& pool = d_pools[2 * type + kind];
+            pool.memoryType = type;
+            pool.blockOrder = blockOrder;
+            pool.freeSlots.resize(MIN_BUDDY_ORDER - MIN_CLASS_ORDER);
+        }
+    }
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    for(auto& pool : d_pools)
+        for(auto& block : pool.blocks)
+            if(block.memory != VK_NULL_HANDLE)
+                freeDeviceMemory(block.memory);
+    d_pools.clear();
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    MemoryAllocation allocation;
+    uint32_t type = findMemoryType(requirements.memoryTypeBits, properties);
+    VkMemoryPropertyFlags flags = d_memory_properties.memoryTypes[type].propertyFlags;
+    VkDeviceSize size = requirements.size;
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+    // ranges flushed by the atom must not reach into a neighbour
+    if((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        alignment = std::max(alignment, d_non_coherent_atom_size);
+        size = (size + d_non_coherent_atom_size - 1) / d_non_coherent_atom_size * d_non_coherent_atom_size;
+    }
+    uint32_t kind = (!linear && d_buffer_image_granularity > 1) ? 1 : 0;
+    Pool& pool = d_pools[2 * type + kind];
+    TypeStatistics& statistics = d_statistics[type];
+
+    allocation.allocator = this;
+    allocation.pool = 2 * type + kind;
+    if(dedicated || size > (VkDeviceSize(1) << (pool.blockOrder - 1)))
+    {
+        allocation.memory = allocateDeviceMemory(type, size, &allocation.mapped);
+        allocation.size = size;
+        allocation.order = 0;
+        statistics.dedicated++;
+        statistics.dedicatedBytes += size;
+        statistics.allocations++;
+        return allocation;
+    }
+
+    // every range is aligned to its own size, which covers the alignment as both are powers of 2
+    uint32_t order = std::max(findMemoryOrder(std::max(size, alignment)), uint32_t(MIN_CLASS_ORDER));
+    if(order < MIN_BUDDY_ORDER)
+    {
+        // size class slot, slabs of MIN_BUDDY_ORDER are carved into equal slots
+        std::set<std::pair<uint32_t, VkDeviceSize>>& slots = pool.freeSlots[order - MIN_CLASS_ORDER];
+        if(slots.empty())
+        {
+            uint32_t block;
+            VkDeviceSize slab;
+            allocateRange(pool, MIN_BUDDY_ORDER, block, slab);
+            for(VkDeviceSize slot = 0; slot < (VkDeviceSize(1) << MIN_BUDDY_ORDER); slot += VkDeviceSize(1) << order)
+                slots.insert(std::make_pair(block, slab + slot));
+            pool.slabUsed[std::make_pair(block, slab)] = 0;
+        }
+        std::pair<uint32_t, VkDeviceSize> slot = *slots.begin();
+        slots.erase(slots.begin());
+        VkDeviceSize slab = slot.second & ~((VkDeviceSize(1) << MIN_BUDDY_ORDER) - 1);
+        pool.slabUsed[std::make_pair(slot.first, slab)]++;
+        allocation.block = slot.first;
+        allocation.offset = slot.second;
+    }
+    else
+        allocateRange(pool, order, allocation.block, allocation.offset);
+
+    Block& block = pool.blocks[allocation.block];
+    allocation.memory = block.memory;
+    allocation.size = VkDeviceSize(1) << order;
+    allocation.order = order;
+    allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+    statistics.allocations++;
+    statistics.reservedBytes += allocation.size;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if(allocation.allocator != this) return;
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    Pool& pool = d_pools[allocation.pool];
+    TypeStatistics& statistics = d_statistics[pool.memoryType];
+    statistics.allocations--;
+    if(!allocation.order)
+    {
+        freeDeviceMemory(allocation.memory);
+        statistics.dedicated--;
+        statistics.dedicatedBytes -= allocation.size;
+    }
+    else if(allocation.order < MIN_BUDDY_ORDER)
+    {
+        std::set<std::pair<uint32_t, VkDeviceSize>>& slots = pool.freeSlots[allocation.order - MIN_CLASS_ORDER];
+        slots.insert(std::make_pair(allocation.block, allocation.offset));
+        VkDeviceSize slab = allocation.offset & ~((VkDeviceSize(1) << MIN_BUDDY_ORDER) - 1);
+        auto used = pool.slabUsed.find(std::make_pair(allocation.block, slab));
+        // empty slabs go back to the buddy allocator, so size classes do not hold memory forever
+        if(!--used->second)
+        {
+            pool.slabUsed.erase(used);
+            for(VkDeviceSize slot = 0; slot < (VkDeviceSize(1) << MIN_BUDDY_ORDER); slot += VkDeviceSize(1) << allocation.order)
+                slots.erase(std::make_pair(allocation.block, slab + slot));
+            freeRange(pool, allocation.block, slab, MIN_BUDDY_ORDER);
+        }
+        statistics.reservedBytes -= allocation.size;
+    }
+    else
+    {
+        freeRange(pool, allocation.block, allocation.offset, allocation.order);
+        statistics.reservedBytes -= allocation.size;
+    }
+    allocation = MemoryAllocation();
+}
+
+void MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    if(!allocation.allocator || !size) return;
+    VkMemoryPropertyFlags flags = d_memory_properties.memoryTypes[d_pools[allocation.pool].memoryType].propertyFlags;
+    if(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+
+    // allocations of non-coherent memory start and end on an atom
+    VkDeviceSize begin = (allocation.offset + offset) / d_non_coherent_atom_size * d_non_coherent_atom_size;
+    VkDeviceSize end = std::min(allocation.offset + offset + size + d_non_coherent_atom_size - 1, allocation.offset + allocation.size);
+    end = std::max(begin, end / d_non_coherent_atom_size * d_non_coherent_atom_size);
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end - begin;
+    vkFlushMappedMemoryRanges(d_device, 1, &range);
+}
+
+std::vector<std::string> MemoryAllocator::describe()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    std::vector<std::string> lines;
+    uint64_t allocations = 0;
+    for(uint32_t type = 0; type < d_statistics.size(); type++)
+    {
+        const TypeStatistics& statistics = d_statistics[type];
+        allocations += statistics.allocations;
+        if(!statistics.blocks && !statistics.dedicated) continue;
+        VkMemoryPropertyFlags flags = d_memory_properties.memoryTypes[type].propertyFlags;
+        std::stringstream ss;
+        ss << "memory type " << type << " (" << ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "device local" : "host")
+           << ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? ((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) ? ", coherent" : ", non-coherent") : "")
+           << "): " << statistics.allocations << " allocations, " << statistics.blocks << " blocks of " << (statistics.blockBytes >> 10)
+           << " KB with " << (statistics.reservedBytes >> 10) << " KB in use, " << statistics.dedicated << " dedicated of "
+           << (statistics.dedicatedBytes >> 10) << " KB";
+        lines.push_back(ss.str());
+    }
+    std::stringstream ss;
+    ss << allocations << " resources placed in " << d_device_allocations << " device memory allocations (limit " << d_max_allocations << ")";
+    lines.push_back(ss.str());
+    return lines;
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    for(uint32_t i = 0; i < d_memory_properties.memoryTypeCount; i++)
+    {
+        if((typeFilter & (1 << i)) &&
+            ((d_memory_properties.memoryTypes[i].propertyFlags & properties) == properties))
+        {
+            return i;
+        }
+    }
+    throw std::runtime_error("ERROR: failed to find suitable Vulkan device memory type!");
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, unsigned char** mapped)
+{
+    if(d_device_allocations >= d_max_allocations)
+        throw std::runtime_error("ERROR: Vulkan device memory allocation limit reached (" + std::to_string(d_max_allocations) + ")!");
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if(vkAllocateMemory(d_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        throw std::runtime_error("ERROR: failed to allocate Vulkan device memory!");
+    d_device_allocations++;
+
+    *mapped = nullptr;
+    if(d_memory_properties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void* data;
+        if(vkMapMemory(d_device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to map Vulkan device memory!");
+        *mapped = static_cast<unsigned char*>(data);
+    }
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory)
+{
+    // freeing unmaps too
+    vkFreeMemory(d_device, memory, nullptr);
+    d_device_allocations--;
+}
+
+void MemoryAllocator::allocateRange(Pool& pool, uint32_t order, uint32_t& block, VkDeviceSize& offset)
+{
+    // smallest free range that fits, in the first block having one
+    for(uint32_t i = 0; i < pool.blocks.size(); i++)
+    {
+        Block& candidate = pool.blocks[i];
+        if(candidate.memory == VK_NULL_HANDLE) continue;
+        for(uint32_t found = order; found <= pool.blockOrder; found++)
+        {
+            std::set<VkDeviceSize>& ranges = candidate.freeRanges[found - MIN_BUDDY_ORDER];
+            if(ranges.empty()) continue;
+            offset = *ranges.begin();
+            ranges.erase(ranges.begin());
+            // split down to the order asked for, keeping the upper halves free
+            while(found > order)
+            {
+                found--;
+                candidate.freeRanges[found - MIN_BUDDY_ORDER].insert(offset + (VkDeviceSize(1) << found));
+            }
+            candidate.used += VkDeviceSize(1) << order;
+            block = i;
+            return;
+        }
+    }
+
+    // new block, reusing the slot of a released one
+    uint32_t i = 0;
+    while(i < pool.blocks.size() && pool.blocks[i].memory != VK_NULL_HANDLE) i++;
+    if(i == pool.blocks.size()) pool.blocks.push_back(Block());
+    Block& newBlock = pool.blocks[i];
+    VkDeviceSize blockSize = VkDeviceSize(1) << pool.blockOrder;
+    newBlock.memory = allocateDeviceMemory(pool.memoryType, blockSize, &newBlock.mapped);
+    newBlock.freeRanges.assign(pool.blockOrder - MIN_BUDDY_ORDER + 1, std::set<VkDeviceSize>());
+    newBlock.freeRanges[pool.blockOrder - MIN_BUDDY_ORDER].insert(0);
+    newBlock.used = 0;
+    d_statistics[pool.memoryType].blocks++;
+    d_statistics[pool.memoryType].blockBytes += blockSize;
+    allocateRange(pool, order, block, offset);
+}
+
+void MemoryAllocator::freeRange(Pool& pool, uint32_t block, VkDeviceSize offset, uint32_t order)
+{
+    Block& freed = pool.blocks[block];
+    freed.used -= VkDeviceSize(1) << order;
+    while(order < pool.blockOrder)
+    {
+        VkDeviceSize buddy = offset ^ (VkDeviceSize(1) << order);
+        std::set<VkDeviceSize>& ranges = freed.freeRanges[order - MIN_BUDDY_ORDER];
+        auto found = ranges.find(buddy);
+        if(found == ranges.end()) break;
+        ranges.erase(found);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    freed.freeRanges[order - MIN_BUDDY_ORDER].insert(offset);
+
+    // keep one block of every pool around, so loading and unloading a scene does not allocate again
+    if(!freed.used)
+    {
+        size_t liveBlocks = 0;
+        for(auto& other : pool.blocks)
+            if(other.memory != VK_NULL_HANDLE) liveBlocks++;
+        if(liveBlocks > 1)
+        {
+            freeDeviceMemory(freed.memory);
+            freed = Block();
+            d_statistics[pool.memoryType].blocks--;
+            d_statistics[pool.memoryType].blockBytes -= VkDeviceSize(1) << pool.blockOrder;
+        }
+    }
+}
+
+
+// helper functions
+
+// log2 of the smallest power of 2 not below size
+uint32_t findMemoryOrder(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while((VkDeviceSize(1) << order) < size) order++;
+    return order;
+}
@@ -0,0 +1,682 @@
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DATA;
+
+// FIFO cache simulation, a vertex is cached if it was one of the last cacheSize misses
+struct MeshCacheSimulation
+{
+    std::vector<size_t> stamps;
+    size_t time;
+    size_t cacheSize;
+
+    MeshCacheSimulation(size_t vertexCount, size_t size) : stamps(vertexCount, 0), time(size + 1), cacheSize(size) {}
+    // returns true on miss
+    bool access(uint32_t v)
+    {
+        if(time - stamps[v] <= cacheSize) return false;
+        stamps[v] = time++;
+        return true;
+    }
+    // empty the cache
+    void flush() { time += cacheSize + 1; }
+};
+
+// number of 32 bit words compared by the welding pass
+const size_t MESH_WELD_KEY_SIZE = sizeof(Vertex) / sizeof(uint32_t);
+
+// words a vertex is compared by, raw bits or grid cells of epsilon
+void findWeldKey(const Vertex& vertex, float epsilon, uint32_t* key)
+{
+    const float* values = reinterpret_cast<const float*>(&vertex);
+    if(epsilon > 0.0f)
+    {
+        for(size_t k = 0; k < MESH_WELD_KEY_SIZE; k++)
+        {
+            // clamp so that huge values stay in range of the cast
+            double cell = std::floor((double)values[k] / epsilon + 0.5);
+            cell = std::max(-2147483648.0, std::min(2147483647.0, cell));
+            key[k] = static_cast<uint32_t>(static_cast<int32_t>(cell));
+        }
+    }
+    else memcpy(key, values, sizeof(Vertex));
+}
+
+// FNV-1a over the key words
+uint32_t hashWeldKey(const uint32_t* key)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t k = 0; k < MESH_WELD_KEY_SIZE; k++)
+    {
+        hash ^= key[k];
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+size_t DATA::weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float epsilon)
+{
+    static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "Vertex has to be made of 32 bit words");
+    size_t vertexCount = vertices.size();
+    if(!vertexCount) return 0;
+    for(uint32_t index : indices)
+        if(index >= vertexCount) return 0;
+
+    // open addressing table of unique vertex ids, at most half full
+    size_t tableSize = 1;
+    while(tableSize < vertexCount * 2) tableSize <<= 1;
+    const uint32_t empty = ~0u;
+    std::vector<uint32_t> table(tableSize, empty);
+    std::vector<uint32_t> keys;
+    keys.reserve(vertexCount * MESH_WELD_KEY_SIZE);
+    std::vector<uint32_t> remap(vertexCount);
+    uint32_t key[MESH_WELD_KEY_SIZE];
+    uint32_t uniqueCount = 0;
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        findWeldKey(vertices[v], epsilon, key);
+        size_t slot = hashWeldKey(key) & (tableSize - 1);
+        while(table[slot] != empty && memcmp(&keys[table[slot] * MESH_WELD_KEY_SIZE], key, sizeof(key)) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+        if(table[slot] == empty)
+        {
+            table[slot] = uniqueCount;
+            keys.insert(keys.end(), key, key + MESH_WELD_KEY_SIZE);
+            // unique vertices are compacted in place, the first one of each group is kept
+            vertices[uniqueCount++] = vertices[v];
+        }
+        remap[v] = table[slot];
+    }
+    if(uniqueCount == vertexCount) return 0;
+
+    if(indices.empty())
+    {
+        indices.resize(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++)
+            indices[v] = remap[v];
+    }
+    else
+    {
+        for(uint32_t& index : indices)
+            index = remap[index];
+    }
+    vertices.resize(uniqueCount);
+    vertices.shrink_to_fit();
+    return vertexCount - uniqueCount;
+}
+
+VertexCacheStatistics DATA::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize)
+{
+    VertexCacheStatistics stats;
+    stats.triangles = indices.size() / 3;
+    stats.vertices = vertexCount;
+    MeshCacheSimulation cache(vertexCount, cacheSize);
+    for(size_t i = 0; i < stats.triangles * 3; i++)
+        if(cache.access(indices[i])) stats.transformed++;
+    return stats;
+}
+
+void DATA::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount < 2 || !vertexCount) return;
+
+    // triangles around every vertex, packed by vertex
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+        offsets[indices[i] + 1]++;
+    std::vector<uint32_t> live(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        live[v] = offsets[v + 1];
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<size_t> stamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t fanning = 0;
+    while(fanning >= 0)
+    {
+        // emit all remaining triangles around the fanning vertex
+        uint32_t f = static_cast<uint32_t>(fanning);
+        candidates.clear();
+        for(uint32_t i = offsets[f]; i < offsets[f + 1]; i++)
+        {
+            uint32_t t = adjacency[i];
+            if(emitted[t]) continue;
+            for(size_t k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(time - stamps[v] > cacheSize) stamps[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex is the candidate that stays in cache the longest while its fan is emitted
+        fanning = -1;
+        int64_t bestPriority = -1;
+        for(uint32_t v : candidates)
+        {
+            if(!live[v]) continue;
+            int64_t priority = 0;
+            if(time - stamps[v] + 2 * live[v] <= cacheSize)
+                priority = static_cast<int64_t>(time - stamps[v]);
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+        if(fanning >= 0) continue;
+
+        // dead end, go back to recently used vertices first, then to the next vertex in input order
+        while(!deadEnd.empty() && fanning < 0)
+        {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if(live[v]) fanning = v;
+        }
+        while(cursor < vertexCount && fanning < 0)
+        {
+            if(live[cursor]) fanning = static_cast<int64_t>(cursor);
+            cursor++;
+        }
+    }
+    indices.swap(result);
+}
+
+void DATA::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold, size_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount < 2 || vertices.empty()) return;
+
+    // hard boundaries are where the cache optimizer jumped, all three vertices missed
+    std::vector<uint32_t> hardClusters;
+    size_t totalMisses = 0;
+    {
+        MeshCacheSimulation cache(vertices.size(), cacheSize);
+        for(size_t t = 0; t < triangleCount; t++)
+        {
+            size_t misses = 0;
+            for(size_t k = 0; k < 3; k++)
+                if(cache.access(indices[t * 3 + k])) misses++;
+            if(t == 0 || misses == 3) hardClusters.push_back(static_cast<uint32_t>(t));
+            totalMisses += misses;
+        }
+    }
+    float meshACMR = (float)totalMisses / (float)triangleCount;
+
+    // soft boundaries split hard clusters further wherever the part so far is as cache friendly as the whole mesh
+    std::vector<uint32_t> clusters;
+    {
+        MeshCacheSimulation cache(vertices.size(), cacheSize);
+        for(size_t c = 0; c < hardClusters.size(); c++)
+        {
+            size_t start = hardClusters[c];
+            size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+            size_t clusterStart = start;
+            size_t misses = 0;
+            cache.flush();
+            clusters.push_back(static_cast<uint32_t>(start));
+            for(size_t t = start; t < end; t++)
+            {
+                for(size_t k = 0; k < 3; k++)
+                    if(cache.access(indices[t * 3 + k])) misses++;
+                if(t + 1 < end && (float)misses / (float)(t + 1 - clusterStart) <= threshold * meshACMR)
+                {
+                    clusterStart = t + 1;
+                    misses = 0;
+                    cache.flush();
+                    clusters.push_back(static_cast<uint32_t>(clusterStart));
+                }
+            }
+        }
+    }
+    if(clusters.size() < 2) return;
+
+    // area weighted centroid and normal of every cluster
+    std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+    std::vector<float> areas(clusters.size(), 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        glm::vec3 centroidSum(0.0f);
+        for(size_t t = clusters[c]; t < end; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(cross);
+            centroidSum += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += cross;
+            areas[c] += area;
+        }
+        centroids[c] = areas[c] > 0.0f ? centroidSum / areas[c] : glm::vec3(0.0f);
+        float normalLength = glm::length(normals[c]);
+        if(normalLength > 0.0f) normals[c] /= normalLength;
+        meshCentroid += centroidSum;
+        meshArea += areas[c];
+    }
+    if(meshArea <= 0.0f) return;
+    meshCentroid /= meshArea;
+
+    // clusters facing away from the center occlude the others, draw them first
+    std::vector<float> sortKeys(clusters.size());
+    std::vector<uint32_t> order(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b){return sortKeys[a] > sortKeys[b];});
+
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    for(uint32_t c : order)
+    {
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(result);
+}
+
+void DATA::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    uint32_t next = 0;
+    for(uint32_t& index : indices)
+    {
+        if(remap[index] == unused) remap[index] = next++;
+        index = remap[index];
+    }
+    for(size_t v = 0; v < vertices.size(); v++)
+        if(remap[v] == unused) remap[v] = next++;
+    std::vector<Vertex> result(vertices.size());
+    for(size_t v = 0; v < vertices.size(); v++)
+        result[remap[v]] = vertices[v];
+    vertices.swap(result);
+}
+
+void DATA::optimizeMesh(GraphUserInput& mesh, VertexCacheStatistics* before, VertexCacheStatistics* after)
+{
+    bool valid = !mesh.indices.empty() && mesh.indices.size() % 3 == 0;
+    for(size_t i = 0; valid && i < mesh.indices.size(); i++)
+        valid = mesh.indices[i] < mesh.vertices.size();
+    if(valid && before) *before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    if(valid)
+    {
+        optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        optimizeOverdraw(mesh.indices, mesh.vertices);
+        optimizeVertexFetch(mesh.vertices, mesh.indices);
+    }
+    if(valid && after) *after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+}
+
+void DATA::buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, std::vector<Meshlet>& meshlets,
+    size_t maxVertices, size_t maxTriangles)
+{
+    size_t triangleCount = indices.size() / 3;
+    if(!triangleCount || vertices.empty()) return;
+
+    // vertices are stamped with the meshlet they were last counted in
+    std::vector<uint32_t> stamps(vertices.size(), 0);
+    uint32_t stamp = 1;
+    size_t start = 0;
+    size_t vertexCount = 0;
+    auto finish = [&](size_t end)
+    {
+        Meshlet meshlet{};
+        meshlet.indiceStart = static_cast<uint32_t>(start * 3);
+        meshlet.triangleCount = static_cast<uint32_t>(end - start);
+        meshlet.vertexCount = static_cast<uint32_t>(vertexCount);
+        findMeshletBounds(indices.data() + start * 3, end - start, vertices, meshlet);
+        meshlets.push_back(meshlet);
+        start = end;
+        vertexCount = 0;
+        stamp++;
+    };
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        const uint32_t* tri = &indices[t * 3];
+        size_t added = (stamps[tri[0]] != stamp) + (stamps[tri[1]] != stamp && tri[1] != tri[0]) +
+            (stamps[tri[2]] != stamp && tri[2] != tri[0] && tri[2] != tri[1]);
+        if(t > start && (vertexCount + added > maxVertices || t - start + 1 > maxTriangles))
+        {
+            finish(t);
+            added = (tri[1] != tri[0]) + (tri[2] != tri[0] && tri[2] != tri[1]) + 1;
+        }
+        for(size_t k = 0; k < 3; k++)
+            stamps[tri[k]] = stamp;
+        vertexCount += added;
+    }
+    finish(triangleCount);
+}
+
+void DATA::findMeshletBounds(const uint32_t* indices, size_t count, const std::vector<Vertex>& vertices, Meshlet& meshlet)
+{
+    // sphere around the box center, good enough for small clusters
+    glm::vec3 minPos(vertices[indices[0]].pos);
+    glm::vec3 maxPos(minPos);
+    for(size_t i = 0; i < count * 3; i++)
+    {
+        minPos = glm::min(minPos, vertices[indices[i]].pos);
+        maxPos = glm::max(maxPos, vertices[indices[i]].pos);
+    }
+    meshlet.center = (minPos + maxPos) * 0.5f;
+    float radius2 = 0.0f;
+    for(size_t i = 0; i < count * 3; i++)
+    {
+        glm::vec3 d = vertices[indices[i]].pos - meshlet.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    meshlet.radius = std::sqrt(radius2);
+
+    // cone around the average of the unit triangle normals
+    std::vector<glm::vec3> normals;
+    normals.reserve(count);
+    glm::vec3 axis(0.0f);
+    for(size_t t = 0; t < count; t++)
+    {
+        const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+        const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+        const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if(length <= 0.0f) continue;
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if(normals.empty() || axisLength <= 0.0f) return;
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for(const glm::vec3& normal : normals)
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    meshlet.coneAxis = axis;
+    // normals spread over a half space or more can never be all back facing
+    if(minDot > 0.0f) meshlet.coneCutoff = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+}
+
+// area weighted sum of squared plane distances, divided by weight when evaluated
+struct MeshQuadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+    double weight = 0.0;
+
+    void addPlane(const glm::vec3& n, float d, float w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+        b0 += w * d * n.x; b1 += w * d * n.y; b2 += w * d * n.z;
+        c += w * d * d;
+        weight += w;
+    }
+    void add(const MeshQuadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+        weight += q.weight;
+    }
+    // mean squared distance of p to the planes
+    double evaluate(const glm::vec3& p) const
+    {
+        if(weight <= 0.0) return 0.0;
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+            2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(0.0, r / weight);
+    }
+};
+
+// a vertex collapsing onto a neighbour
+struct MeshCollapse
+{
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+float DATA::simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount,
+    float maxError, std::vector<uint32_t>& result)
+{
+    result = indices;
+    size_t vertexCount = vertices.size();
+    if(indices.size() <= targetIndexCount || !vertexCount || indices.size() % 3) return 0.0f;
+    for(uint32_t index : indices)
+        if(index >= vertexCount) return 0.0f;
+
+    // vertices split by attributes share a position
+    std::vector<uint32_t> order(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++) order[v] = static_cast<uint32_t>(v);
+    auto samePosition = [&vertices](uint32_t a, uint32_t b){return memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(glm::vec3)) == 0;};
+    std::sort(order.begin(), order.end(), [&vertices](uint32_t a, uint32_t b){
+        return memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(glm::vec3)) < 0;
+    });
+    std::vector<uint32_t> positionIDs(vertexCount);
+    std::vector<bool> positionLocked;
+    for(size_t i = 0; i < vertexCount; i++)
+    {
+        bool shared = i > 0 && samePosition(order[i], order[i - 1]);
+        if(shared) positionLocked.back() = true;
+        else positionLocked.push_back(false);
+        positionIDs[order[i]] = static_cast<uint32_t>(positionLocked.size() - 1);
+    }
+
+    // positions on edges that are not shared by exactly two triangles are borders or non manifold
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for(size_t t = 0; t < indices.size(); t += 3)
+    {
+        for(size_t k = 0; k < 3; k++)
+        {
+            uint64_t a = positionIDs[indices[t + k]];
+            uint64_t b = positionIDs[indices[t + (k + 1) % 3]];
+            if(a != b) edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for(size_t i = 0; i < edges.size();)
+    {
+        size_t j = i;
+        while(j < edges.size() && edges[j] == edges[i]) j++;
+        if(j - i != 2)
+        {
+            positionLocked[edges[i] >> 32] = true;
+            positionLocked[edges[i] & 0xffffffffu] = true;
+        }
+        i = j;
+    }
+    std::vector<bool> locked(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+        locked[v] = positionLocked[positionIDs[v]];
+
+    std::vector<MeshQuadric> quadrics(vertexCount);
+    for(size_t t = 0; t < indices.size(); t += 3)
+    {
+        const glm::vec3& p0 = vertices[indices[t + 0]].pos;
+        const glm::vec3& p1 = vertices[indices[t + 1]].pos;
+        const glm::vec3& p2 = vertices[indices[t + 2]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if(length <= 0.0f) continue;
+        normal /= length;
+        for(size_t k = 0; k < 3; k++)
+            quadrics[indices[t + k]].addPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+    }
+
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint32_t> offsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<MeshCollapse> collapses;
+    std::vector<bool> touched(vertexCount);
+    std::vector<uint32_t> next;
+    double limit = (double)maxError * maxError;
+    double resultCost = 0.0;
+    while(result.size() > targetIndexCount)
+    {
+        // triangles around every vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for(uint32_t index : result) offsets[index + 1]++;
+        for(size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+        // cheapest neighbour of every vertex that is free to move
+        collapses.clear();
+        for(size_t v = 0; v < vertexCount; v++)
+        {
+            if(locked[v] || offsets[v] == offsets[v + 1]) continue;
+            MeshCollapse best = {static_cast<uint32_t>(v), static_cast<uint32_t>(v), 0.0};
+            for(uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+            {
+                for(size_t k = 0; k < 3; k++)
+                {
+                    uint32_t b = result[adjacency[i] * 3 + k];
+                    if(b == v) continue;
+                    double cost = quadrics[v].evaluate(vertices[b].pos);
+                    if(best.to == v || cost < best.cost)
+                    {
+                        best.to = b;
+                        best.cost = cost;
+                    }
+                }
+            }
+            if(best.to != v) collapses.push_back(best);
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const MeshCollapse& x, const MeshCollapse& y){
+            return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+        });
+
+        // collapse the cheapest edges, vertices touched once wait for the next pass
+        for(size_t v = 0; v < vertexCount; v++) remap[v] = static_cast<uint32_t>(v);
+        std::fill(touched.begin(), touched.end(), false);
+        size_t goal = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        size_t collapsed = 0;
+        for(const MeshCollapse& collapse : collapses)
+        {
+            if(removed >= goal || collapse.cost > limit) break;
+            uint32_t a = collapse.from;
+            uint32_t b = collapse.to;
+            if(touched[a] || touched[b]) continue;
+
+            // triangles around a must not flip when a moves onto b
+            bool valid = true;
+            size_t degenerate = 0;
+            for(uint32_t i = offsets[a]; i < offsets[a + 1] && valid; i++)
+            {
+                const uint32_t* tri = &result[adjacency[i] * 3];
+                if(tri[0] == b || tri[1] == b || tri[2] == b)
+                {
+                    degenerate++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for(size_t k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[tri[k]].pos;
+                    q[k] = tri[k] == a ? vertices[b].pos : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                valid = glm::dot(before, after) > 0.0f;
+            }
+            if(!valid) continue;
+
+            remap[a] = b;
+            quadrics[b].add(quadrics[a]);
+            resultCost = std::max(resultCost, collapse.cost);
+            for(uint32_t i = offsets[a]; i < offsets[a + 1]; i++)
+                for(size_t k = 0; k < 3; k++)
+                    touched[result[adjacency[i] * 3 + k]] = true;
+            removed += degenerate;
+            collapsed++;
+        }
+        if(!collapsed) break;
+
+        next.clear();
+        for(size_t t = 0; t < result.size(); t += 3)
+        {
+            uint32_t a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+            if(a == b || b == c || a == c) continue;
+            next.push_back(a);
+            next.push_back(b);
+            next.push_back(c);
+        }
+        result.swap(next);
+    }
+    return static_cast<float>(std::sqrt(resultCost));
+}
+
+void DATA::generateMeshLods(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t maxLods,
+    std::vector<std::vector<uint32_t>>& lods, std::vector<float>& errors)
+{
+    lods.clear();
+    errors.clear();
+    glm::vec3 center;
+    float radius;
+    findMeshBounds(vertices, center, radius);
+    lods.reserve(maxLods);
+    const std::vector<uint32_t>* source = &indices;
+    float error = 0.0f;
+    for(size_t level = 0; level < maxLods; level++)
+    {
+        size_t triangleCount = source->size() / 3;
+        if(triangleCount < MESH_LOD_MIN_TRIANGLES) break;
+        std::vector<uint32_t> lod;
+        float lodError = simplifyMesh(*source, vertices, (triangleCount / 2) * 3, MESH_LOD_MAX_ERROR * radius, lod);
+        // levels that barely shrink are not worth a switch
+        if(lod.size() * 10 > source->size() * 9) break;
+        optimizeVertexCache(lod, vertices.size());
+        error += lodError;
+        lods.push_back(std::move(lod));
+        errors.push_back(error);
+        source = &lods.back();
+    }
+}
+
+void DATA::findMeshBounds(const std::vector<Vertex>& vertices, glm::vec3& center, float& radius)
+{
+    center = glm::vec3(0.0f);
+    radius = 0.0f;
+    if(vertices.empty()) return;
+    glm::vec3 minPos(vertices[0].pos);
+    glm::vec3 maxPos(minPos);
+    for(const Vertex& vertex : vertices)
+    {
+        minPos = glm::min(minPos, vertex.pos);
+        maxPos = glm::max(maxPos, vertex.pos);
+    }
+    center = (minPos + maxPos) * 0.5f;
+    float radius2 = 0.0f;
+    for(const Vertex& vertex : vertices)
+        radius2 = std::max(radius2, glm::dot(vertex.pos - center, vertex.pos - center));
+    radius = std::sqrt(radius2);
+}
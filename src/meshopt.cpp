@@ -0,0 +1,508 @@
+#include "meshopt.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHOPT_ENABLE_SSE2
+#endif
+
+using namespace DATA;
+
+// layout constants of the codecs, see EXT_meshopt_compression
+const unsigned char MESHOPT_VERTEX_HEADER = 0xa0;
+const unsigned char MESHOPT_INDEX_HEADER = 0xe0;
+const unsigned char MESHOPT_SEQUENCE_HEADER = 0xd0;
+const size_t MESHOPT_BYTE_GROUP_SIZE = 16;
+const size_t MESHOPT_BYTE_GROUP_DECODE_LIMIT = 24; // largest group with its escapes
+const size_t MESHOPT_VERTEX_BLOCK_SIZE_BYTES = 8192;
+const size_t MESHOPT_VERTEX_BLOCK_MAX_SIZE = 256;
+const size_t MESHOPT_TAIL_MAX_SIZE = 32;
+
+// vertices per block, blocks are a multiple of the byte group size
+static size_t getVertexBlockSize(size_t stride)
+{
+    size_t result = (MESHOPT_VERTEX_BLOCK_SIZE_BYTES / stride) & ~(MESHOPT_BYTE_GROUP_SIZE - 1);
+    return result < MESHOPT_VERTEX_BLOCK_MAX_SIZE ? result : MESHOPT_VERTEX_BLOCK_MAX_SIZE;
+}
+
+// 16 values of 0, 2, 4 or 8 bits, the largest 2 and 4 bit value means the byte follows the packed bits
+static const unsigned char* decodeBytesGroup(const unsigned char* data, unsigned char* buffer, int bitslog2)
+{
+    switch(bitslog2)
+    {
+        case 0:
+            memset(buffer, 0, MESHOPT_BYTE_GROUP_SIZE);
+            return data;
+        case 1:
+        {
+            const unsigned char* escapes = data + 4;
+            for(size_t i = 0; i < MESHOPT_BYTE_GROUP_SIZE; i++)
+            {
+                unsigned char code = (data[i / 4] >> (6 - (i % 4) * 2)) & 3;
+                buffer[i] = code == 3 ? *escapes : code;
+                escapes += code == 3;
+            }
+            return escapes;
+        }
+        case 2:
+        {
+            const unsigned char* escapes = data + 8;
+            for(size_t i = 0; i < MESHOPT_BYTE_GROUP_SIZE; i++)
+            {
+                unsigned char code = (data[i / 2] >> (4 - (i % 2) * 4)) & 15;
+                buffer[i] = code == 15 ? *escapes : code;
+                escapes += code == 15;
+            }
+            return escapes;
+        }
+        default:
+            memcpy(buffer, data, MESHOPT_BYTE_GROUP_SIZE);
+            return data + MESHOPT_BYTE_GROUP_SIZE;
+    }
+}
+
+// one byte of every vertex in a block, count is a multiple of the group size
+static const unsigned char* decodeBytes(const unsigned char* data, const unsigned char* dataEnd, unsigned char* buffer, size_t count)
+{
+    // 2 bit group modes, four to a byte
+    const unsigned char* header = data;
+    size_t headerSize = (count / MESHOPT_BYTE_GROUP_SIZE + 3) / 4;
+    if(static_cast<size_t>(dataEnd - data) < headerSize) return nullptr;
+    data += headerSize;
+    for(size_t i = 0; i < count; i += MESHOPT_BYTE_GROUP_SIZE)
+    {
+        if(static_cast<size_t>(dataEnd - data) < MESHOPT_BYTE_GROUP_DECODE_LIMIT) return nullptr;
+        size_t group = i / MESHOPT_BYTE_GROUP_SIZE;
+        int bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = decodeBytesGroup(data, buffer + i, bitslog2);
+    }
+    return data;
+}
+
+// zigzag deltas of a byte column into values, previous is the value before the first one
+// count is rounded up to the group size, extra values are garbage
+static unsigned char decodeDeltas(unsigned char* column, size_t count, unsigned char previous)
+{
+#ifdef MESHOPT_ENABLE_SSE2
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low = _mm_set1_epi8(0x7f);
+    const __m128i zero = _mm_setzero_si128();
+    for(size_t i = 0; i < count; i += MESHOPT_BYTE_GROUP_SIZE)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + i));
+        v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low), _mm_sub_epi8(zero, _mm_and_si128(v, one)));
+        // prefix sum over the 16 lanes
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(previous)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(column + i), v);
+        previous = column[i + MESHOPT_BYTE_GROUP_SIZE - 1];
+    }
+#else
+    for(size_t i = 0; i < count; i++)
+    {
+        unsigned char delta = static_cast<unsigned char>(-(column[i] & 1) ^ (column[i] >> 1));
+        previous = static_cast<unsigned char>(previous + delta);
+        column[i] = previous;
+    }
+#endif
+    return previous;
+}
+
+static const unsigned char* decodeVertexBlock(const unsigned char* data, const unsigned char* dataEnd, unsigned char* dst,
+    size_t count, size_t stride, unsigned char* lastVertex)
+{
+    unsigned char column[MESHOPT_VERTEX_BLOCK_MAX_SIZE];
+    size_t countAligned = (count + MESHOPT_BYTE_GROUP_SIZE - 1) & ~(MESHOPT_BYTE_GROUP_SIZE - 1);
+    for(size_t k = 0; k < stride; k++)
+    {
+        data = decodeBytes(data, dataEnd, column, countAligned);
+        if(!data) return nullptr;
+        decodeDeltas(column, countAligned, lastVertex[k]);
+        for(size_t i = 0; i < count; i++)
+            dst[i * stride + k] = column[i];
+        lastVertex[k] = column[count - 1];
+    }
+    return data;
+}
+
+bool DATA::decodeMeshoptVertices(unsigned char* dst, size_t count, size_t stride, const unsigned char* src, size_t size)
+{
+    if(!stride || stride > 256 || stride % 4 != 0) return false;
+    if(size < 1 + stride) return false;
+    const unsigned char* data = src;
+    const unsigned char* dataEnd = src + size;
+    if((*data & 0xf0) != MESHOPT_VERTEX_HEADER || (*data & 0x0f) > 0) return false;
+    data++;
+
+    // the stream ends with the first vertex, which is the baseline of the first deltas
+    unsigned char lastVertex[256];
+    memcpy(lastVertex, dataEnd - stride, stride);
+
+    size_t blockSize = getVertexBlockSize(stride);
+    for(size_t offset = 0; offset < count; offset += blockSize)
+    {
+        size_t blockCount = offset + blockSize < count ? blockSize : count - offset;
+        data = decodeVertexBlock(data, dataEnd, dst + offset * stride, blockCount, stride, lastVertex);
+        if(!data) return false;
+    }
+    size_t tailSize = stride < MESHOPT_TAIL_MAX_SIZE ? MESHOPT_TAIL_MAX_SIZE : stride;
+    return static_cast<size_t>(dataEnd - data) == tailSize;
+}
+
+// 7 bits per byte, high bit set when more bytes follow
+static uint32_t decodeVByte(const unsigned char*& data)
+{
+    unsigned char lead = *data++;
+    if(lead < 128) return lead;
+    uint32_t result = lead & 127;
+    uint32_t shift = 7;
+    for(int i = 0; i < 4; i++)
+    {
+        unsigned char group = *data++;
+        result |= static_cast<uint32_t>(group & 127) << shift;
+        shift += 7;
+        if(group < 128) break;
+    }
+    return result;
+}
+
+// zigzag delta against last
+static uint32_t decodeIndex(const unsigned char*& data, uint32_t last)
+{
+    uint32_t v = decodeVByte(data);
+    return last + ((v >> 1) ^ (0u - (v & 1)));
+}
+
+static inline void writeIndex(unsigned char* dst, size_t i, size_t indexSize, uint32_t index)
+{
+    if(indexSize == 2)
+    {
+        uint16_t value = static_cast<uint16_t>(index);
+        memcpy(dst + i * 2, &value, sizeof(value));
+    }
+    else memcpy(dst + i * 4, &index, sizeof(index));
+}
+
+// recently seen vertices and edges, the encoder refers to them by age
+struct MeshoptTriangleState
+{
+    uint32_t vertices[16];
+    uint32_t edges[16][2];
+    size_t vertexOffset = 0;
+    size_t edgeOffset = 0;
+
+    void pushVertex(uint32_t v, bool advance = true)
+    {
+        vertices[vertexOffset] = v;
+        vertexOffset = (vertexOffset + (advance ? 1 : 0)) & 15;
+    }
+    void pushEdge(uint32_t a, uint32_t b)
+    {
+        edges[edgeOffset][0] = a;
+        edges[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1) & 15;
+    }
+    uint32_t vertex(size_t age) const { return vertices[(vertexOffset - age) & 15]; }
+};
+
+bool DATA::decodeMeshoptTriangles(unsigned char* dst, size_t count, size_t indexSize, const unsigned char* src, size_t size)
+{
+    if(count % 3 != 0 || (indexSize != 2 && indexSize != 4)) return false;
+    // header, one code per triangle and the 16 byte table of common codes at the end
+    if(size < 1 + count / 3 + 16) return false;
+    if((src[0] & 0xf0) != MESHOPT_INDEX_HEADER) return false;
+    int version = src[0] & 0x0f;
+    if(version > 1) return false;
+
+    MeshoptTriangleState state;
+    memset(state.vertices, 0xff, sizeof(state.vertices));
+    memset(state.edges, 0xff, sizeof(state.edges));
+    uint32_t next = 0;
+    uint32_t last = 0;
+    int fecmax = version >= 1 ? 13 : 15;
+
+    const unsigned char* code = src + 1;
+    const unsigned char* data = code + count / 3;
+    const unsigned char* dataSafeEnd = src + size - 16;
+    const unsigned char* codeauxTable = dataSafeEnd;
+
+    for(size_t i = 0; i < count; i += 3)
+    {
+        // a triangle reads at most 16 bytes, the table after the data keeps reads in bounds
+        if(data > dataSafeEnd) return false;
+        unsigned char codetri = *code++;
+        uint32_t a, b, c;
+        if(codetri < 0xf0)
+        {
+            // edge from the fifo and a new, cached or free third vertex
+            const uint32_t* edge = state.edges[(state.edgeOffset - 1 - (codetri >> 4)) & 15];
+            a = edge[0];
+            b = edge[1];
+            int fec = codetri & 15;
+            if(fec < fecmax)
+            {
+                c = fec == 0 ? next : state.vertex(1 + fec);
+                next += fec == 0;
+                state.pushVertex(c, fec == 0);
+            }
+            else
+            {
+                // 13 and 14 are the last free index -1 and +1
+                last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+                state.pushVertex(c);
+            }
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+        }
+        else
+        {
+            int fea, feb, fec;
+            if(codetri < 0xfe)
+            {
+                unsigned char codeaux = codeauxTable[codetri & 15];
+                fea = 0;
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+            }
+            else
+            {
+                unsigned char codeaux = *data++;
+                fea = codetri == 0xfe ? 0 : 15;
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+                if(codeaux == 0) next = 0;
+            }
+            // new vertices are numbered before free indices are read, same as the encoder
+            a = fea == 0 ? next++ : 0;
+            b = feb == 0 ? next++ : (feb == 15 ? 0 : state.vertex(feb));
+            c = fec == 0 ? next++ : (fec == 15 ? 0 : state.vertex(fec));
+            if(fea == 15) last = a = decodeIndex(data, last);
+            if(feb == 15) last = b = decodeIndex(data, last);
+            if(fec == 15) last = c = decodeIndex(data, last);
+            state.pushVertex(a);
+            state.pushVertex(b, feb == 0 || feb == 15);
+            state.pushVertex(c, fec == 0 || fec == 15);
+            state.pushEdge(b, a);
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+        }
+        writeIndex(dst, i + 0, indexSize, a);
+        writeIndex(dst, i + 1, indexSize, b);
+        writeIndex(dst, i + 2, indexSize, c);
+    }
+    // all data is read up to the table
+    return data == dataSafeEnd;
+}
+
+bool DATA::decodeMeshoptIndices(unsigned char* dst, size_t count, size_t indexSize, const unsigned char* src, size_t size)
+{
+    if(indexSize != 2 && indexSize != 4) return false;
+    // header, at least one byte per index and a 4 byte tail
+    if(size < 1 + count + 4) return false;
+    if((src[0] & 0xf0) != MESHOPT_SEQUENCE_HEADER || (src[0] & 0x0f) > 1) return false;
+
+    const unsigned char* data = src + 1;
+    const unsigned char* dataSafeEnd = src + size - 4;
+    // two baselines, the lowest bit picks the one an index is relative to
+    uint32_t last[2] = {0, 0};
+    for(size_t i = 0; i < count; i++)
+    {
+        if(data >= dataSafeEnd) return false;
+        uint32_t v = decodeVByte(data);
+        uint32_t baseline = v & 1;
+        v >>= 1;
+        uint32_t index = last[baseline] + ((v >> 1) ^ (0u - (v & 1)));
+        last[baseline] = index;
+        writeIndex(dst, i, indexSize, index);
+    }
+    return data == dataSafeEnd;
+}
+
+// round half away from zero
+static inline int roundSigned(float v)
+{
+    return static_cast<int>(v + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+// xy and the scale in z of an octahedral encoding back to a normalized xyz, w is kept
+template<typename T>
+static void decodeFilterOct(T* data, size_t begin, size_t count)
+{
+    const float max = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+    for(size_t i = begin; i < count; i++)
+    {
+        float x = static_cast<float>(data[i * 4 + 0]);
+        float y = static_cast<float>(data[i * 4 + 1]);
+        float z = static_cast<float>(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+        float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+        float s = max / std::sqrt(x * x + y * y + z * z);
+        data[i * 4 + 0] = static_cast<T>(roundSigned(x * s));
+        data[i * 4 + 1] = static_cast<T>(roundSigned(y * s));
+        data[i * 4 + 2] = static_cast<T>(roundSigned(z * s));
+    }
+}
+
+#ifdef MESHOPT_ENABLE_SSE2
+// x * s rounded half away from zero
+static inline __m128i roundSignedSSE2(__m128 v)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    return _mm_cvttps_epi32(_mm_add_ps(v, _mm_or_ps(half, _mm_and_ps(v, sign))));
+}
+
+// four elements per iteration, returns the first element left
+template<typename T>
+static size_t decodeFilterOctSSE2(T* data, size_t count)
+{
+    const __m128 max = _mm_set1_ps(static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1));
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        T* e = data + i * 4;
+        __m128 x = _mm_setr_ps(e[0], e[4], e[8], e[12]);
+        __m128 y = _mm_setr_ps(e[1], e[5], e[9], e[13]);
+        __m128 z = _mm_setr_ps(e[2], e[6], e[10], e[14]);
+        z = _mm_sub_ps(_mm_sub_ps(z, _mm_andnot_ps(sign, x)), _mm_andnot_ps(sign, y));
+        // t is min(z, 0) carrying the sign of x or y
+        __m128 t = _mm_min_ps(z, zero);
+        x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, sign)));
+        y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, sign)));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 s = _mm_div_ps(max, length);
+        int32_t xi[4], yi[4], zi[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(xi), roundSignedSSE2(_mm_mul_ps(x, s)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(yi), roundSignedSSE2(_mm_mul_ps(y, s)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(zi), roundSignedSSE2(_mm_mul_ps(z, s)));
+        for(int k = 0; k < 4; k++)
+        {
+            e[k * 4 + 0] = static_cast<T>(xi[k]);
+            e[k * 4 + 1] = static_cast<T>(yi[k]);
+            e[k * 4 + 2] = static_cast<T>(zi[k]);
+        }
+    }
+    return i;
+}
+
+// four values per iteration, returns the first value left
+static size_t decodeFilterExpSSE2(uint32_t* data, size_t count)
+{
+    const __m128i bias = _mm_set1_epi32(127);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i mantissa = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        __m128i exponent = _mm_srai_epi32(v, 24);
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, bias), 23));
+        _mm_storeu_ps(reinterpret_cast<float*>(data + i), _mm_mul_ps(scale, _mm_cvtepi32_ps(mantissa)));
+    }
+    return i;
+}
+#endif
+
+// three components scaled by the top bits of w and the index of the dropped component in its low 2 bits
+static void decodeFilterQuat(int16_t* data, size_t count)
+{
+    const float scale = 1.0f / std::sqrt(2.0f);
+    for(size_t i = 0; i < count; i++)
+    {
+        int16_t* e = data + i * 4;
+        float ss = scale / static_cast<float>(e[3] | 3);
+        float x = static_cast<float>(e[0]) * ss;
+        float y = static_cast<float>(e[1]) * ss;
+        float z = static_cast<float>(e[2]) * ss;
+        float ww = 1.0f - x * x - y * y - z * z;
+        float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+        int qc = e[3] & 3;
+        int16_t xf = static_cast<int16_t>(roundSigned(x * 32767.0f));
+        int16_t yf = static_cast<int16_t>(roundSigned(y * 32767.0f));
+        int16_t zf = static_cast<int16_t>(roundSigned(z * 32767.0f));
+        int16_t wf = static_cast<int16_t>(roundSigned(w * 32767.0f));
+        e[(qc + 1) & 3] = xf;
+        e[(qc + 2) & 3] = yf;
+        e[(qc + 3) & 3] = zf;
+        e[(qc + 0) & 3] = wf;
+    }
+}
+
+// mantissa in the low 24 bits, signed exponent in the top 8 bits
+static void decodeFilterExp(uint32_t* data, size_t begin, size_t count)
+{
+    for(size_t i = begin; i < count; i++)
+    {
+        int32_t mantissa = static_cast<int32_t>(data[i] << 8) >> 8;
+        int32_t exponent = static_cast<int32_t>(data[i]) >> 24;
+        uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, sizeof(scale));
+        float value = scale * static_cast<float>(mantissa);
+        memcpy(&data[i], &value, sizeof(value));
+    }
+}
+
+void DATA::decodeMeshoptFilter(unsigned char* data, size_t count, size_t stride, MeshoptFilters filter)
+{
+    size_t begin = 0;
+    switch(filter)
+    {
+        case MESHOPT_FILTER_OCTAHEDRAL:
+            if(stride == 4)
+            {
+#ifdef MESHOPT_ENABLE_SSE2
+                begin = decodeFilterOctSSE2(reinterpret_cast<int8_t*>(data), count);
+#endif
+                decodeFilterOct(reinterpret_cast<int8_t*>(data), begin, count);
+            }
+            else if(stride == 8)
+            {
+#ifdef MESHOPT_ENABLE_SSE2
+                begin = decodeFilterOctSSE2(reinterpret_cast<int16_t*>(data), count);
+#endif
+                decodeFilterOct(reinterpret_cast<int16_t*>(data), begin, count);
+            }
+            break;
+        case MESHOPT_FILTER_QUATERNION:
+            if(stride == 8)
+                decodeFilterQuat(reinterpret_cast<int16_t*>(data), count);
+            break;
+        case MESHOPT_FILTER_EXPONENTIAL:
+        {
+            size_t values = count * stride / 4;
+#ifdef MESHOPT_ENABLE_SSE2
+            begin = decodeFilterExpSSE2(reinterpret_cast<uint32_t*>(data), values);
+#endif
+            decodeFilterExp(reinterpret_cast<uint32_t*>(data), begin, values);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool DATA::decodeMeshoptBuffer(unsigned char* dst, size_t count, size_t stride, const unsigned char* src, size_t size,
+    MeshoptModes mode, MeshoptFilters filter)
+{
+    switch(mode)
+    {
+        case MESHOPT_MODE_ATTRIBUTES:
+            if(!decodeMeshoptVertices(dst, count, stride, src, size)) return false;
+            decodeMeshoptFilter(dst, count, stride, filter);
+            return true;
+        case MESHOPT_MODE_TRIANGLES:
+            return decodeMeshoptTriangles(dst, count, stride, src, size);
+        case MESHOPT_MODE_INDICES:
+            return decodeMeshoptIndices(dst, count, stride, src, size);
+        default:
+            return false;
+    }
+}
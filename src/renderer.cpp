@@ -35,12 +35,22 @@ void Renderer::CreateGraph()
 {
     if(app->GRAPH_MESHES.size())
         p_graph = DATA::Graph::newGraph(app->GRAPH_MESHES, p_backend->d_device);
+    else if(app->GRAPH_MODELS.size())
+        p_graph = DATA::Graph::newGraph(app->GRAPH_MODELS, p_backend->d_device);
     else if(app->GRAPH_MODEL_PATH != "")
         p_graph = DATA::Graph::newGraph(app->GRAPH_MODEL_PATH, p_backend->d_device);
     else
         throw std::runtime_error("ERROR: no graph information is set for renderer!");
     createGraphicsPipeline();
     createFramebuffers();
+
+    LOGGING::Logger* myLogger = app->GetLogger();
+    LOGGING::LogOwners myLoggerOwner = LOGGING::LOG_OWNERS_RENDERER;
+    if(myLogger)
+    {
+        for(auto& line : p_backend->p_allocator->describe())
+            myLogger->AddMessage(myLoggerOwner, line);
+    }
 }
 
 void Renderer::loop(USER_UPDATE user_func)
@@ -89,7 +99,13 @@ void Renderer::drawFrame(USER_UPDATE user_func)
 		vkWaitForFences(p_backend->d_device, 1, &d_fence_image[imageIndex], VK_TRUE, UINT64_MAX);
 	d_fence_image[imageIndex] = d_fence_render[CURRENT_FRAME];
 
-	updateUniformBuffers(user_func);
+	// image is no longer in flight, streamed textures can be bound to its descriptor sets
+	p_graph->onFrameStart(imageIndex);
+
+	updateUniformBuffers(user_func, imageIndex);
+
+	// recorded while the image is not in flight, so its frame slot can be written
+	p_graph->updateRenderCommandBuffer(imageIndex);
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -125,11 +141,9 @@ void Renderer::drawFrame(USER_UPDATE user_func)
 
 	result = vkQueuePresentKHR(p_backend->d_present_queue, &presentInfo);
 
-    bool updateCommands = true;
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || p_backend->d_frame_refreshed)
 	{
 		p_backend->d_frame_refreshed = false;
-        updateCommands = false;
 		recreateSwapChain();
 	}
 	else if (result != VK_SUCCESS)
@@ -138,21 +152,6 @@ void Renderer::drawFrame(USER_UPDATE user_func)
 	vkQueueWaitIdle(p_backend->d_present_queue);
 
 	CURRENT_FRAME = (CURRENT_FRAME + 1) % MAX_FRAMES_IN_FLIGHT;
-
-    // recreate render commands by image idx
-    if(updateCommands)
-    {
-        vkFreeCommandBuffers(p_backend->d_device, d_command_pool, 1, &p_graph->d_commands[imageIndex]);
-        VkCommandBufferAllocateInfo allocInfo{};
-	    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	    allocInfo.commandPool = d_command_pool;
-	    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	    allocInfo.commandBufferCount = 1;
-
-        if (vkAllocateCommandBuffers(p_backend->d_device, &allocInfo, &p_graph->d_commands[imageIndex]) != VK_SUCCESS)
-	    	throw std::runtime_error("ERROR: failed to allocate Vulkan command buffers!");
-        p_graph->updateRenderCommandBuffer(imageIndex);
-    }
 }
 
 Renderer::~Renderer()
@@ -378,8 +377,24 @@ void Renderer::createGraphicsPipeline()
         if(myLogger){myLogger->AddMessage(myLoggerOwner, "shader file " + shaderSourceDetails.names[i] + " loaded");}
     }
 
-    auto bindingDescription = DATA::Vertex::getBindingDescription();
-    auto attributeDescriptions = DATA::Vertex::getAttributeDescriptions();
+    // vertex input follows the format the graph packed its vertex buffer in
+    VkVertexInputBindingDescription bindingDescription;
+    std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions;
+    switch(p_graph->d_vertex_format)
+    {
+        case DATA::VERTEX_FORMAT_COMPACT:
+            bindingDescription = DATA::CompactVertex::getBindingDescription();
+            attributeDescriptions = DATA::CompactVertex::getAttributeDescriptions();
+            break;
+        case DATA::VERTEX_FORMAT_QUANTIZED:
+            bindingDescription = DATA::QuantizedVertex::getBindingDescription();
+            attributeDescriptions = DATA::QuantizedVertex::getAttributeDescriptions();
+            break;
+        default:
+            bindingDescription = DATA::Vertex::getBindingDescription();
+            attributeDescriptions = DATA::Vertex::getAttributeDescriptions();
+            break;
+    }
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -470,10 +485,13 @@ void Renderer::createGraphicsPipeline()
     pushConstantRange.size = sizeof(DATA::MeshConstantData);
     pushConstantRange.offset = 0;
 
+    // set 0 is bound once per frame, set 1 per material
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {{p_graph->d_descriptor_layout, p_graph->d_material_layout}};
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &p_graph->d_descriptor_layout;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
 	pipelineLayoutInfo.pushConstantRangeCount = 1;
 	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -519,8 +537,11 @@ void Renderer::createCommandPool()
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamilyID;
 	poolInfo.flags = 0;
 
+	// render command buffers are recorded again in place, single commands are freed after use
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	if (vkCreateCommandPool(p_backend->d_device, &poolInfo, nullptr, &d_command_pool) != VK_SUCCESS)
 		throw std::runtime_error("ERROR: failed to create Vulkan command pool!");
+	poolInfo.flags = 0;
     if (vkCreateCommandPool(p_backend->d_device, &poolInfo, nullptr, &d_command_pool_single) != VK_SUCCESS)
 		throw std::runtime_error("ERROR: failed to create Vulkan command pool!");
     if(myLogger){myLogger->AddMessage(myLoggerOwner, "Vulkan command pool created");}
@@ -654,7 +675,7 @@ VkExtent2D Renderer::selectSwapChainExtent(VkSurfaceCapabilitiesKHR& capabilitie
 }
 
 void Renderer::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
-    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, DATA::MemoryAllocation& imageMemory)
 {
     VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -678,17 +699,9 @@ void Renderer::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBit
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(p_backend->d_device, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = p_backend->findDeviceMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(p_backend->d_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-
-	vkBindImageMemory(p_backend->d_device, image, imageMemory, 0);
+	// attachments are recreated with the swap chain, their own allocation keeps the blocks unfragmented
+	imageMemory = p_backend->p_allocator->allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR, true);
+	vkBindImageMemory(p_backend->d_device, image, imageMemory.memory, imageMemory.offset);
 }
 
 VkImageView Renderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
@@ -831,7 +844,7 @@ void Renderer::stopSingleCommand(VkCommandBuffer& commandBuffer)
     vkFreeCommandBuffers(p_backend->d_device, d_command_pool_single, 1, &commandBuffer);
 }
 
-std::vector<VkCommandBuffer> Renderer::allocateRenderCommandBuffers(size_t size)
+std::vector<VkCommandBuffer> Renderer::allocateRenderCommandBuffers(size_t size, VkCommandBufferLevel level)
 {
     std::vector<VkCommandBuffer> buffers;
     buffers.resize(size);
@@ -839,7 +852,7 @@ std::vector<VkCommandBuffer> Renderer::allocateRenderCommandBuffers(size_t size)
     VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = d_command_pool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.level = level;
 	allocInfo.commandBufferCount = static_cast<uint32_t>(size);
 
 	if (vkAllocateCommandBuffers(p_backend->d_device, &allocInfo, buffers.data()) != VK_SUCCESS)
@@ -849,6 +862,7 @@ std::vector<VkCommandBuffer> Renderer::allocateRenderCommandBuffers(size_t size)
 
 void Renderer::freeRenderCommandBuffers(std::vector<VkCommandBuffer> buffers)
 {
+    if(buffers.empty()) return;
     vkFreeCommandBuffers(p_backend->d_device, d_command_pool, static_cast<uint32_t>(buffers.size()), buffers.data());
 }
 
@@ -906,43 +920,11 @@ void Renderer::recreateSwapChain()
     p_graph->onFrameSizeChangeEnd();
 }
 
-void Renderer::updateUniformBuffers(USER_UPDATE user_func)
+void Renderer::updateUniformBuffers(USER_UPDATE user_func, uint32_t imageID)
 {
-    void* data;
-    for(size_t i = 0; i < d_swap_chain_images.size(); i++)
-    {
-        user_func(p_graph->d_ubo_data, d_swap_chain_image_extent.width, d_swap_chain_image_extent.height);
-
-        vkMapMemory(p_backend->d_device, p_graph->d_ubo_buffers[i].mem, 0, sizeof(DATA::CameraUniform), 0, &data);
-        memcpy(data, &p_graph->d_ubo_data, sizeof(DATA::CameraUniform));
-        vkUnmapMemory(p_backend->d_device, p_graph->d_ubo_buffers[i].mem);
-
-    }
-    // update each node uniform (only when needed)
-    if(p_graph->d_node_uniform_buffers_need_update)
-    {
-        for(size_t i = 0; i < d_swap_chain_images.size(); i++)
-        {
-	        for(auto& node : p_graph->d_nodes)
-	        {
-	        	DATA::NodeUniformData uniformData{};
-
-		        glm::mat4 mat = node->transformMat;
-		        DATA::Node* ptr = node->parentNode;
-		        while(ptr)
-		        {
-		        	mat = ptr->transformMat * mat;
-		        	ptr = ptr->parentNode;
-		        }
-		        uniformData.localTransformation = mat;
-
-                vkMapMemory(p_backend->d_device, p_graph->d_node_uniform_buffers[node->nodeID][i].mem, 0, sizeof(DATA::NodeUniformData), 0, &data);
-                memcpy(data, &uniformData, sizeof(DATA::NodeUniformData));
-                vkUnmapMemory(p_backend->d_device, p_graph->d_node_uniform_buffers[node->nodeID][i].mem);
-	        }
-        }
-        p_graph->d_node_uniform_buffers_need_update = false;
-    }
+    user_func(p_graph->d_ubo_data, d_swap_chain_image_extent.width, d_swap_chain_image_extent.height);
+    // only the slot of this image, the others may still be read by frames in flight
+    p_graph->updateFrameData(imageID);
 }
 
 
@@ -0,0 +1,704 @@
+#include "texture.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <climits>
+
+#include <stb_image.h>
+
+#include "files.hpp"
+
+using namespace DATA;
+
+bool DATA::decodeTextureData(const unsigned char* bytes, size_t size, TextureData& texture, std::string& error)
+{
+    if(!bytes || !size || size > static_cast<size_t>(INT_MAX))
+    {
+        error = "no image data";
+        return false;
+    }
+    if(isKTX2Data(bytes, size))
+        return decodeKTX2TextureData(bytes, size, texture, error);
+    int length = static_cast<int>(size);
+    int width, height, channels;
+    void* pixels;
+    size_t pixelSize;
+    // always expand to 4 channels, 3 channel formats are rarely sampleable
+    if(stbi_is_16_bit_from_memory(bytes, length))
+    {
+        pixels = stbi_load_16_from_memory(bytes, length, &width, &height, &channels, STBI_rgb_alpha);
+        texture.format = VK_FORMAT_R16G16B16A16_UNORM;
+        pixelSize = 8;
+    }
+    else
+    {
+        pixels = stbi_load_from_memory(bytes, length, &width, &height, &channels, STBI_rgb_alpha);
+        texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+        pixelSize = 4;
+    }
+    if(!pixels)
+    {
+        error = stbi_failure_reason();
+        return false;
+    }
+    texture.width = static_cast<uint32_t>(width);
+    texture.height = static_cast<uint32_t>(height);
+    texture.levels = 1;
+    texture.levelOffsets = {0};
+    texture.pixels.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * pixelSize);
+    memcpy(texture.pixels.data(), pixels, texture.pixels.size());
+    stbi_image_free(pixels);
+    return true;
+}
+
+bool DATA::loadTextureData(const std::string path, TextureData& texture, std::string& error)
+{
+    if(FILES::get_file_extension(path) == "ktx2")
+    {
+        FILES::MappedFile file;
+        if(!file.open(path))
+        {
+            error = "cannot open file";
+            return false;
+        }
+        return decodeKTX2TextureData(file.data(), file.size(), texture, error);
+    }
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load((std::string(GLOB_FILE_FOLDER) + "/" + path).c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if(!pixels)
+    {
+        error = stbi_failure_reason();
+        return false;
+    }
+    texture.width = static_cast<uint32_t>(width);
+    texture.height = static_cast<uint32_t>(height);
+    texture.levels = 1;
+    texture.levelOffsets = {0};
+    texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+    texture.pixels.assign(pixels, pixels + static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+// KTX2 file layout, see the KTX 2.0 specification
+const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+const size_t KTX2_HEADER_SIZE = 80; // identifier, image description and the index of the data blocks
+const size_t KTX2_LEVEL_INDEX_SIZE = 24; // byteOffset, byteLength, uncompressedByteLength
+
+struct KTX2Header
+{
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+};
+
+bool DATA::isKTX2Data(const unsigned char* bytes, size_t size)
+{
+    return bytes && size >= sizeof(KTX2_IDENTIFIER) && memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+// formats that can be read from a KTX2 file as they are
+static bool isKTX2FormatSupported(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R16G16B16A16_UNORM:
+            return true;
+        default:
+            return isTextureFormatCompressed(format);
+    }
+}
+
+bool DATA::decodeKTX2TextureData(const unsigned char* bytes, size_t size, TextureData& texture, std::string& error)
+{
+    if(!isKTX2Data(bytes, size) || size < KTX2_HEADER_SIZE)
+    {
+        error = "not a KTX2 file";
+        return false;
+    }
+    KTX2Header header;
+    memcpy(&header, bytes + sizeof(KTX2_IDENTIFIER), sizeof(header));
+    VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    if(header.supercompressionScheme != 0 || format == VK_FORMAT_UNDEFINED)
+    {
+        error = "KTX2 supercompression and Basis Universal payloads are not supported";
+        return false;
+    }
+    if(!isKTX2FormatSupported(format))
+    {
+        error = "unsupported KTX2 format " + std::to_string(header.vkFormat);
+        return false;
+    }
+    if(!header.pixelWidth || !header.pixelHeight || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+    {
+        error = "only 2D KTX2 images are supported";
+        return false;
+    }
+    // a level count of 0 asks for the chain to be generated
+    uint32_t levels = std::max(header.levelCount, 1u);
+    if(levels > getTextureMipLevels(header.pixelWidth, header.pixelHeight) ||
+        KTX2_HEADER_SIZE + static_cast<size_t>(levels) * KTX2_LEVEL_INDEX_SIZE > size)
+    {
+        error = "KTX2 level index is corrupted";
+        return false;
+    }
+
+    // the file stores the smallest level first, levels are stored largest first here
+    std::vector<VkDeviceSize> offsets(levels);
+    VkDeviceSize total = 0;
+    for(uint32_t level = 0; level < levels; level++)
+    {
+        offsets[level] = total;
+        total += getTextureLevelSize(format, header.pixelWidth, header.pixelHeight, level);
+    }
+    texture.pixels.resize(static_cast<size_t>(total));
+    for(uint32_t level = 0; level < levels; level++)
+    {
+        uint64_t index[2];
+        memcpy(index, bytes + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_SIZE, sizeof(index));
+        VkDeviceSize levelSize = getTextureLevelSize(format, header.pixelWidth, header.pixelHeight, level);
+        if(index[1] < levelSize || index[0] > size || size - index[0] < levelSize)
+        {
+            error = "KTX2 level data is out of range";
+            texture.pixels.clear();
+            return false;
+        }
+        memcpy(texture.pixels.data() + offsets[level], bytes + index[0], static_cast<size_t>(levelSize));
+    }
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.format = format;
+    texture.levels = levels;
+    texture.levelOffsets = offsets;
+    return true;
+}
+
+uint32_t DATA::getTextureMipLevels(uint32_t width, uint32_t height)
+{
+    return static_cast<uint32_t>(std::floor(std::log2(std::max(std::max(width, height), 1u)))) + 1;
+}
+
+std::vector<VkFormat> DATA::getTextureBlockFormats()
+{
+    return {
+        VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+        VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK,
+        VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK,
+    };
+}
+
+// bytes per 4x4 block, 0 for uncompressed formats
+static size_t getTextureFormatBlockSize(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+bool DATA::isTextureFormatCompressed(VkFormat format)
+{
+    return getTextureFormatBlockSize(format) > 0;
+}
+
+size_t DATA::getTextureFormatPixelSize(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_R8_SRGB:
+        case VK_FORMAT_R8_UNORM:
+            return 1;
+        case VK_FORMAT_R8G8_SRGB:
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R16_UNORM:
+            return 2;
+        case VK_FORMAT_R8G8B8_SRGB:
+        case VK_FORMAT_R8G8B8_UNORM:
+            return 3;
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R16G16_UNORM:
+            return 4;
+        case VK_FORMAT_R16G16B16_UNORM:
+            return 6;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+            return 8;
+        default:
+            throw std::runtime_error("ERROR: unsupported texture format for CPU processing");
+    }
+}
+
+VkDeviceSize DATA::getTextureLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level)
+{
+    VkDeviceSize w = std::max(width >> level, 1u);
+    VkDeviceSize h = std::max(height >> level, 1u);
+    size_t blockSize = getTextureFormatBlockSize(format);
+    if(blockSize)
+        return ((w + 3) / 4) * ((h + 3) / 4) * blockSize;
+    return w * h * getTextureFormatPixelSize(format);
+}
+
+VkDeviceSize DATA::getTextureSize(VkFormat format, uint32_t width, uint32_t height, uint32_t levels)
+{
+    VkDeviceSize total = 0;
+    for(uint32_t level = 0; level < levels; level++)
+        total += getTextureLevelSize(format, width, height, level);
+    return total;
+}
+
+// sRGB encoded byte to linear float
+struct SRGBToLinearTable
+{
+    float values[256];
+    SRGBToLinearTable()
+    {
+        for(int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+static const float* getSRGBToLinearTable()
+{
+    // function local static is initialized once even with several loader threads
+    static const SRGBToLinearTable table;
+    return table.values;
+}
+
+static unsigned char linearToSRGB(float c)
+{
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return static_cast<unsigned char>(s * 255.0f + 0.5f);
+}
+
+// downsample src level into dst level, T is the channel type
+template<typename T>
+static void downsampleLevel(const T* src, uint32_t srcWidth, uint32_t srcHeight,
+    T* dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t channels, bool srgb, const float* srgbTable)
+{
+    for(uint32_t y = 0; y < dstHeight; y++)
+    {
+        uint32_t y0 = std::min(y * 2, srcHeight - 1);
+        uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+        for(uint32_t x = 0; x < dstWidth; x++)
+        {
+            uint32_t x0 = std::min(x * 2, srcWidth - 1);
+            uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+            const T* p[4] = {
+                src + (static_cast<size_t>(y0) * srcWidth + x0) * channels,
+                src + (static_cast<size_t>(y0) * srcWidth + x1) * channels,
+                src + (static_cast<size_t>(y1) * srcWidth + x0) * channels,
+                src + (static_cast<size_t>(y1) * srcWidth + x1) * channels,
+            };
+            T* out = dst + (static_cast<size_t>(y) * dstWidth + x) * channels;
+            for(uint32_t c = 0; c < channels; c++)
+            {
+                // alpha is always linear
+                bool linear = !srgb || (channels == 4 && c == 3);
+                if(linear)
+                {
+                    uint32_t sum = static_cast<uint32_t>(p[0][c]) + p[1][c] + p[2][c] + p[3][c];
+                    out[c] = static_cast<T>((sum + 2) / 4);
+                }
+                else
+                {
+                    float sum = srgbTable[p[0][c]] + srgbTable[p[1][c]] + srgbTable[p[2][c]] + srgbTable[p[3][c]];
+                    out[c] = static_cast<T>(linearToSRGB(sum * 0.25f));
+                }
+            }
+        }
+    }
+}
+
+void DATA::generateTextureMipmaps(TextureData& texture)
+{
+    uint32_t mipLevels = getTextureMipLevels(texture.width, texture.height);
+    size_t pixelSize = getTextureFormatPixelSize(texture.format);
+    bool wide = texture.format == VK_FORMAT_R16_UNORM || texture.format == VK_FORMAT_R16G16_UNORM ||
+        texture.format == VK_FORMAT_R16G16B16_UNORM || texture.format == VK_FORMAT_R16G16B16A16_UNORM;
+    bool srgb = texture.format == VK_FORMAT_R8_SRGB || texture.format == VK_FORMAT_R8G8_SRGB ||
+        texture.format == VK_FORMAT_R8G8B8_SRGB || texture.format == VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t channels = static_cast<uint32_t>(wide ? pixelSize / 2 : pixelSize);
+
+    // lay out all levels, keeping level 0 in place
+    std::vector<VkDeviceSize> offsets(mipLevels);
+    VkDeviceSize total = 0;
+    for(uint32_t level = 0; level < mipLevels; level++)
+    {
+        offsets[level] = total;
+        total += getTextureLevelSize(texture.format, texture.width, texture.height, level);
+    }
+    if(texture.pixels.size() < getTextureLevelSize(texture.format, texture.width, texture.height, 0))
+        throw std::runtime_error("ERROR: texture data is smaller than its first level");
+    texture.pixels.resize(static_cast<size_t>(total));
+
+    const float* srgbTable = getSRGBToLinearTable();
+    for(uint32_t level = 1; level < mipLevels; level++)
+    {
+        uint32_t srcWidth = std::max(texture.width >> (level - 1), 1u);
+        uint32_t srcHeight = std::max(texture.height >> (level - 1), 1u);
+        uint32_t dstWidth = std::max(texture.width >> level, 1u);
+        uint32_t dstHeight = std::max(texture.height >> level, 1u);
+        unsigned char* src = texture.pixels.data() + offsets[level - 1];
+        unsigned char* dst = texture.pixels.data() + offsets[level];
+        if(wide)
+            downsampleLevel(reinterpret_cast<const uint16_t*>(src), srcWidth, srcHeight,
+                reinterpret_cast<uint16_t*>(dst), dstWidth, dstHeight, channels, false, srgbTable);
+        else
+            downsampleLevel(reinterpret_cast<const uint8_t*>(src), srcWidth, srcHeight,
+                dst, dstWidth, dstHeight, channels, srgb, srgbTable);
+    }
+    texture.levels = mipLevels;
+    texture.levelOffsets = offsets;
+}
+
+static inline uint16_t packColor565(const int* c)
+{
+    return static_cast<uint16_t>(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+static inline void unpackColor565(uint16_t v, int* c)
+{
+    int r = (v >> 11) & 31;
+    int g = (v >> 5) & 63;
+    int b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block of 16 RGBA pixels, endpoints span the inset bounding box of the colors
+static void encodeBlockColor(const unsigned char* pixels, unsigned char* out)
+{
+    int low[3] = {255, 255, 255};
+    int high[3] = {0, 0, 0};
+    for(int i = 0; i < 16; i++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            low[c] = std::min(low[c], static_cast<int>(pixels[i * 4 + c]));
+            high[c] = std::max(high[c], static_cast<int>(pixels[i * 4 + c]));
+        }
+    }
+    // pull the endpoints in by 1/16 of the range, the extremes are rarely worth their error
+    for(int c = 0; c < 3; c++)
+    {
+        int inset = (high[c] - low[c]) >> 4;
+        low[c] += inset;
+        high[c] -= inset;
+    }
+    // every channel of high is at least the one of low, so color0 >= color1 and the block uses 4 colors
+    uint16_t color0 = packColor565(high);
+    uint16_t color1 = packColor565(low);
+    int palette[4][3];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for(int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    uint32_t indices = 0;
+    if(color0 != color1)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            int bestError = INT_MAX;
+            for(int k = 0; k < 4; k++)
+            {
+                int error = 0;
+                for(int c = 0; c < 3; c++)
+                {
+                    int d = static_cast<int>(pixels[i * 4 + c]) - palette[k][c];
+                    error += d * d;
+                }
+                if(error < bestError)
+                {
+                    best = k;
+                    bestError = error;
+                }
+            }
+            indices |= static_cast<uint32_t>(best) << (i * 2);
+        }
+    }
+    memcpy(out, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+// BC3 alpha or BC4 channel block of 16 values stride bytes apart, always in the 8 value mode
+static void encodeBlockChannel(const unsigned char* values, size_t stride, unsigned char* out)
+{
+    int low = 255;
+    int high = 0;
+    for(int i = 0; i < 16; i++)
+    {
+        low = std::min(low, static_cast<int>(values[i * stride]));
+        high = std::max(high, static_cast<int>(values[i * stride]));
+    }
+    out[0] = static_cast<unsigned char>(high);
+    out[1] = static_cast<unsigned char>(low);
+    uint64_t indices = 0;
+    if(high != low)
+    {
+        int palette[8] = {high, low};
+        for(int k = 2; k < 8; k++)
+            palette[k] = ((8 - k) * high + (k - 1) * low) / 7;
+        for(int i = 0; i < 16; i++)
+        {
+            int v = values[i * stride];
+            int best = 0;
+            for(int k = 1; k < 8; k++)
+                if(std::abs(palette[k] - v) < std::abs(palette[best] - v))
+                    best = k;
+            indices |= static_cast<uint64_t>(best) << (i * 3);
+        }
+    }
+    for(int b = 0; b < 6; b++)
+        out[2 + b] = static_cast<unsigned char>(indices >> (b * 8));
+}
+
+// 16 RGBA pixels of a BC1 color block, BC3 blocks always use 4 colors
+static void decodeBlockColor(const unsigned char* in, unsigned char* pixels, bool fourColors)
+{
+    uint16_t color0, color1;
+    uint32_t indices;
+    memcpy(&color0, in, 2);
+    memcpy(&color1, in + 2, 2);
+    memcpy(&indices, in + 4, 4);
+    int palette[4][4];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for(int c = 0; c < 3; c++)
+    {
+        if(fourColors || color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    if(!fourColors && color0 <= color1)
+        palette[3][3] = 0;
+    for(int i = 0; i < 16; i++)
+    {
+        const int* color = palette[(indices >> (i * 2)) & 3];
+        for(int c = 0; c < 4; c++)
+            pixels[i * 4 + c] = static_cast<unsigned char>(color[c]);
+    }
+}
+
+// 16 values of a BC3 alpha or BC4 channel block, written stride bytes apart
+static void decodeBlockChannel(const unsigned char* in, unsigned char* values, size_t stride)
+{
+    int palette[8] = {in[0], in[1]};
+    if(in[0] > in[1])
+    {
+        for(int k = 2; k < 8; k++)
+            palette[k] = ((8 - k) * in[0] + (k - 1) * in[1]) / 7;
+    }
+    else
+    {
+        for(int k = 2; k < 6; k++)
+            palette[k] = ((6 - k) * in[0] + (k - 1) * in[1]) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t indices = 0;
+    for(int b = 0; b < 6; b++)
+        indices |= static_cast<uint64_t>(in[2 + b]) << (b * 8);
+    for(int i = 0; i < 16; i++)
+        values[i * stride] = static_cast<unsigned char>(palette[(indices >> (i * 3)) & 7]);
+}
+
+void DATA::compressTextureData(TextureData& texture, VkFormat format)
+{
+    if(texture.format != VK_FORMAT_R8G8B8A8_SRGB && texture.format != VK_FORMAT_R8G8B8A8_UNORM)
+        throw std::runtime_error("ERROR: only 8 bit RGBA textures can be block compressed");
+    bool alpha = format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
+
+    std::vector<VkDeviceSize> offsets(texture.levels);
+    VkDeviceSize total = 0;
+    for(uint32_t level = 0; level < texture.levels; level++)
+    {
+        offsets[level] = total;
+        total += getTextureLevelSize(format, texture.width, texture.height, level);
+    }
+    std::vector<unsigned char> blocks(static_cast<size_t>(total));
+    for(uint32_t level = 0; level < texture.levels; level++)
+    {
+        uint32_t width = std::max(texture.width >> level, 1u);
+        uint32_t height = std::max(texture.height >> level, 1u);
+        const unsigned char* src = texture.pixels.data() + texture.levelOffsets[level];
+        unsigned char* dst = blocks.data() + offsets[level];
+        for(uint32_t by = 0; by < height; by += 4)
+        {
+            for(uint32_t bx = 0; bx < width; bx += 4)
+            {
+                // edge blocks repeat the last row and column
+                unsigned char block[16 * 4];
+                for(uint32_t y = 0; y < 4; y++)
+                    for(uint32_t x = 0; x < 4; x++)
+                        memcpy(block + (y * 4 + x) * 4,
+                            src + (static_cast<size_t>(std::min(by + y, height - 1)) * width + std::min(bx + x, width - 1)) * 4, 4);
+                if(alpha)
+                {
+                    encodeBlockChannel(block + 3, 4, dst);
+                    dst += 8;
+                }
+                encodeBlockColor(block, dst);
+                dst += 8;
+            }
+        }
+    }
+    texture.pixels.swap(blocks);
+    texture.levelOffsets = offsets;
+    texture.format = format;
+}
+
+bool DATA::decompressTextureData(TextureData& texture)
+{
+    VkFormat format;
+    switch(texture.format)
+    {
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            format = VK_FORMAT_R8G8B8A8_SRGB;
+            break;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            format = VK_FORMAT_R8G8B8A8_UNORM;
+            break;
+        default:
+            return false;
+    }
+    size_t blockSize = getTextureFormatBlockSize(texture.format);
+
+    std::vector<VkDeviceSize> offsets(texture.levels);
+    VkDeviceSize total = 0;
+    for(uint32_t level = 0; level < texture.levels; level++)
+    {
+        offsets[level] = total;
+        total += getTextureLevelSize(format, texture.width, texture.height, level);
+    }
+    std::vector<unsigned char> pixels(static_cast<size_t>(total));
+    for(uint32_t level = 0; level < texture.levels; level++)
+    {
+        uint32_t width = std::max(texture.width >> level, 1u);
+        uint32_t height = std::max(texture.height >> level, 1u);
+        const unsigned char* src = texture.pixels.data() + texture.levelOffsets[level];
+        unsigned char* dst = pixels.data() + offsets[level];
+        for(uint32_t by = 0; by < height; by += 4)
+        {
+            for(uint32_t bx = 0; bx < width; bx += 4, src += blockSize)
+            {
+                unsigned char block[16 * 4];
+                switch(texture.format)
+                {
+                    case VK_FORMAT_BC3_SRGB_BLOCK:
+                    case VK_FORMAT_BC3_UNORM_BLOCK:
+                        decodeBlockColor(src + 8, block, true);
+                        decodeBlockChannel(src, block + 3, 4);
+                        break;
+                    case VK_FORMAT_BC4_UNORM_BLOCK:
+                    case VK_FORMAT_BC5_UNORM_BLOCK:
+                        // missing channels read as 0, alpha as 1
+                        for(int i = 0; i < 16; i++)
+                        {
+                            block[i * 4 + 1] = block[i * 4 + 2] = 0;
+                            block[i * 4 + 3] = 255;
+                        }
+                        decodeBlockChannel(src, block, 4);
+                        if(texture.format == VK_FORMAT_BC5_UNORM_BLOCK)
+                            decodeBlockChannel(src + 8, block + 1, 4);
+                        break;
+                    default:
+                        decodeBlockColor(src, block, false);
+                        break;
+                }
+                // edge blocks only write the pixels inside the level
+                for(uint32_t y = 0; y < 4 && by + y < height; y++)
+                    for(uint32_t x = 0; x < 4 && bx + x < width; x++)
+                        memcpy(dst + (static_cast<size_t>(by + y) * width + bx + x) * 4, block + (y * 4 + x) * 4, 4);
+            }
+        }
+    }
+    texture.pixels.swap(pixels);
+    texture.levelOffsets = offsets;
+    texture.format = format;
+    return true;
+}
+
+// pick BC1 for opaque and BC3 for translucent 8 bit textures, undefined if the device cannot sample it
+static VkFormat findTextureBlockFormat(const TextureData& texture, const TextureTarget& target)
+{
+    bool srgb = texture.format == VK_FORMAT_R8G8B8A8_SRGB;
+    if(!srgb && texture.format != VK_FORMAT_R8G8B8A8_UNORM) return VK_FORMAT_UNDEFINED;
+    bool opaque = true;
+    size_t pixelCount = static_cast<size_t>(texture.width) * texture.height;
+    for(size_t i = 0; i < pixelCount && opaque; i++)
+        opaque = texture.pixels[i * 4 + 3] == 255;
+    VkFormat format;
+    if(opaque)
+        format = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    else
+        format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    if(std::find(target.blockFormats.begin(), target.blockFormats.end(), format) == target.blockFormats.end())
+        return VK_FORMAT_UNDEFINED;
+    return format;
+}
+
+void DATA::prepareTextureData(TextureData& texture, const TextureTarget& target)
+{
+    if(isTextureFormatCompressed(texture.format))
+    {
+        // block formats keep their levels, they cannot be blitted on the GPU
+        if(std::find(target.blockFormats.begin(), target.blockFormats.end(), texture.format) != target.blockFormats.end())
+            return;
+        if(!decompressTextureData(texture))
+            throw std::runtime_error("ERROR: texture format is not supported by the device");
+    }
+    VkFormat blockFormat = target.compress ? findTextureBlockFormat(texture, target) : VK_FORMAT_UNDEFINED;
+    // compressed textures and partial chains need all levels on the CPU
+    uint32_t mipLevels = getTextureMipLevels(texture.width, texture.height);
+    if(texture.levels < mipLevels && (target.mipmap || texture.levels > 1 || blockFormat != VK_FORMAT_UNDEFINED))
+        generateTextureMipmaps(texture);
+    if(blockFormat != VK_FORMAT_UNDEFINED)
+        compressTextureData(texture, blockFormat);
+}
@@ -0,0 +1,190 @@
+#include "threads.hpp"
+
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+using namespace UTILS;
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if(!threadCount)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    d_workers.reserve(threadCount);
+    for(size_t i = 0; i < threadCount; i++)
+        d_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_stop = true;
+    }
+    d_condition.notify_all();
+    for(auto& worker : d_workers)
+        if(worker.joinable()) worker.join();
+    d_workers.clear();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    // packaged_task is move only, wrap it so it fits into std::function
+    auto packed = std::make_shared<std::packaged_task<void()>>(task);
+    std::future<void> result = packed->get_future();
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_tasks.push_back([packed](){(*packed)();});
+    }
+    d_condition.notify_one();
+    return result;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+    if(!count) return;
+
+    struct ForState
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> finished{0};
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<ForState>();
+
+    // helpers may start after all work is taken, in which case they never touch func
+    auto run = [state, count, &func]()
+    {
+        size_t i;
+        while((i = state->next++) < count)
+        {
+            try
+            {
+                func(i);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if(!state->error) state->error = std::current_exception();
+            }
+            if(++state->finished == count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, d_workers.size());
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        for(size_t i = 0; i < helpers; i++)
+            d_tasks.push_back(run);
+    }
+    if(helpers > 1) d_condition.notify_all();
+    else if(helpers == 1) d_condition.notify_one();
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state, count](){return state->finished.load() == count;});
+    if(state->error)
+        std::rethrow_exception(state->error);
+}
+
+void ThreadPool::parallelPipeline(size_t count, const std::function<void(size_t)>& work, const std::function<void(size_t)>& consume)
+{
+    if(!count) return;
+
+    struct PipelineState
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<bool> cancelled{false};
+        size_t finished = 0;
+        std::deque<size_t> done;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<PipelineState>();
+
+    auto run = [state, count, &work]()
+    {
+        size_t i;
+        while((i = state->next++) < count)
+        {
+            std::exception_ptr error;
+            if(!state->cancelled)
+            {
+                try
+                {
+                    work(i);
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                    state->cancelled = true;
+                }
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(error && !state->error) state->error = error;
+            else if(!error && !state->cancelled) state->done.push_back(i);
+            state->finished++;
+            state->condition.notify_one();
+        }
+    };
+
+    // the calling thread is busy consuming, so every item goes to the workers
+    size_t helpers = std::min(count, d_workers.size());
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        for(size_t i = 0; i < helpers; i++)
+            d_tasks.push_back(run);
+    }
+    if(helpers > 1) d_condition.notify_all();
+    else d_condition.notify_one();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while(true)
+    {
+        state->condition.wait(lock, [&state, count](){return !state->done.empty() || state->finished == count;});
+        if(state->done.empty()) break;
+        size_t i = state->done.front();
+        state->done.pop_front();
+        lock.unlock();
+        try
+        {
+            consume(i);
+        }
+        catch(...)
+        {
+            lock.lock();
+            if(!state->error) state->error = std::current_exception();
+            state->cancelled = true;
+            state->done.clear();
+            continue;
+        }
+        lock.lock();
+    }
+    if(state->error)
+        std::rethrow_exception(state->error);
+}
+
+void ThreadPool::workerLoop()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(d_mutex);
+            d_condition.wait(lock, [this](){return d_stop || !d_tasks.empty();});
+            if(d_stop && d_tasks.empty()) return;
+            task = std::move(d_tasks.front());
+            d_tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -50,6 +50,22 @@ ImDrawData* UI::drawMenu()
     {
         ImGui::Begin("FPS");
         ImGui::Text("Current FPS: %.1f", app->RENDER_CURRENT_FPS);
+        const DATA::DrawStatistics& draws = app->RENDER_DRAW_STATISTICS;
+        ImGui::Text("Draws: %u for %u instances", draws.draws, draws.instances);
+        if(draws.triangles)
+        {
+            ImGui::Text("Meshlets: %u / %u visible", draws.meshletsVisible, draws.meshlets);
+            ImGui::Text("Triangles: %llu", (unsigned long long)draws.triangles);
+            ImGui::Text("Frustum culled: %llu", (unsigned long long)draws.trianglesFrustumCulled);
+            ImGui::Text("Cone culled: %llu", (unsigned long long)draws.trianglesConeCulled);
+            ImGui::Text("Submitted: %llu", (unsigned long long)draws.trianglesSubmitted);
+            ImGui::Text("Meshes per LOD:");
+            for(uint32_t level = 0; level <= DATA::MESH_MAX_LODS; level++)
+            {
+                ImGui::SameLine();
+                ImGui::Text("%u", draws.meshLevels[level]);
+            }
+        }
         ImGui::End();
     }
 
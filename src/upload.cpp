@@ -0,0 +1,360 @@
+#include "upload.hpp"
+
+#include "global.hpp"
+extern Application* app;
+
+#include <stdexcept>
+#include <algorithm>
+#include <sstream>
+
+using namespace DATA;
+
+UploadQueue::UploadQueue(VkDevice device, VkQueue graphicsQueue, uint32_t graphicsFamilyID, VkQueue transferQueue, uint32_t transferFamilyID,
+    VkDeviceSize ringSize)
+{
+    d_device = device;
+    d_graphics_queue = graphicsQueue;
+    d_graphics_family_id = graphicsFamilyID;
+    // queues of the same family need no ownership transfer, the graphics queue is used for everything then
+    d_separate_transfer = transferQueue != VK_NULL_HANDLE && transferFamilyID != graphicsFamilyID;
+    d_transfer_queue = d_separate_transfer ? transferQueue : graphicsQueue;
+    d_transfer_family_id = d_separate_transfer ? transferFamilyID : graphicsFamilyID;
+    d_ring_size = std::max<VkDeviceSize>(ringSize, 1 << 16);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = d_transfer_family_id;
+    // command buffers of finished batches are recorded again
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    if(vkCreateCommandPool(d_device, &poolInfo, nullptr, &d_command_pool) != VK_SUCCESS)
+        throw std::runtime_error("ERROR: failed to create Vulkan upload command pool!");
+    if(d_separate_transfer)
+    {
+        poolInfo.queueFamilyIndex = d_graphics_family_id;
+        if(vkCreateCommandPool(d_device, &poolInfo, nullptr, &d_graphics_command_pool) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to create Vulkan upload command pool!");
+    }
+
+    // mapped for the lifetime of the queue
+    void* mapped;
+    d_ring = createStagingBuffer(d_ring_size, &mapped);
+    p_ring_mapped = static_cast<unsigned char*>(mapped);
+}
+
+UploadQueue::~UploadQueue()
+{
+    finish();
+    for(auto& batch : d_finished)
+    {
+        vkDestroyFence(d_device, batch.fence, nullptr);
+        if(batch.copied != VK_NULL_HANDLE)
+            vkDestroySemaphore(d_device, batch.copied, nullptr);
+    }
+    vkDestroyCommandPool(d_device, d_command_pool, nullptr);
+    if(d_graphics_command_pool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(d_device, d_graphics_command_pool, nullptr);
+    d_ring.destroy(d_device);
+    p_ring_mapped = nullptr;
+}
+
+unsigned char* UploadQueue::stage(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& buffer, VkDeviceSize& offset)
+{
+    d_staged_bytes += size;
+    if(size > d_ring_size / 4)
+    {
+        // would stall the ring, freed with the batch it is copied in
+        void* mapped;
+        Buffer staging = createStagingBuffer(size, &mapped);
+        release(staging);
+        d_dedicated++;
+        buffer = staging.buf;
+        offset = 0;
+        return static_cast<unsigned char*>(mapped);
+    }
+
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+    while(true)
+    {
+        uint64_t start = (d_ring_head + alignment - 1) & ~(uint64_t)(alignment - 1);
+        // no wrapping inside an allocation, skip the end of the ring instead
+        if(start % d_ring_size + size > d_ring_size)
+            start = (start / d_ring_size + 1) * d_ring_size;
+        if(start + size - d_ring_tail <= d_ring_size)
+        {
+            d_ring_head = start + size;
+            // the space belongs to the batch recording the copy
+            if(d_open.commands == VK_NULL_HANDLE)
+                beginBatch();
+            buffer = d_ring.buf;
+            offset = start % d_ring_size;
+            return p_ring_mapped + offset;
+        }
+        // ring is full, the space of the recorded uploads only frees up once they are submitted
+        submit();
+        reclaim(true);
+    }
+}
+
+VkCommandBuffer UploadQueue::record()
+{
+    if(d_open.commands == VK_NULL_HANDLE)
+        beginBatch();
+    d_recorded++;
+    return d_open.commands;
+}
+
+VkCommandBuffer UploadQueue::recordGraphics()
+{
+    if(d_open.commands == VK_NULL_HANDLE)
+        beginBatch();
+    d_recorded++;
+    return d_open.graphicsCommands;
+}
+
+void UploadQueue::transferBuffer(VkBuffer buffer)
+{
+    // without a transfer queue the barrier at submit covers buffers
+    if(!d_separate_transfer) return;
+    if(d_open.commands == VK_NULL_HANDLE)
+        beginBatch();
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = d_transfer_family_id;
+    barrier.dstQueueFamilyIndex = d_graphics_family_id;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    // release on the transfer queue, the access masks of the other queue are ignored
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(d_open.commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+
+    // acquire on the graphics queue, chained to the semaphore wait at the transfer stage
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(d_open.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+    d_ownership_transfers++;
+}
+
+void UploadQueue::transferImage(VkImage image, uint32_t levels, VkImageLayout layout)
+{
+    if(d_open.commands == VK_NULL_HANDLE)
+        beginBatch();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = levels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    bool sampled = layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkAccessFlags dstAccess = sampled ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    VkPipelineStageFlags dstStage = sampled ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if(!d_separate_transfer)
+    {
+        // the later graphics commands are recorded into the same command buffer
+        if(sampled)
+        {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = dstAccess;
+            vkCmdPipelineBarrier(d_open.commands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0,
+                0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        return;
+    }
+
+    // release and acquire have to describe the same layout transition
+    barrier.srcQueueFamilyIndex = d_transfer_family_id;
+    barrier.dstQueueFamilyIndex = d_graphics_family_id;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(d_open.commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(d_open.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+    d_ownership_transfers++;
+}
+
+void UploadQueue::release(Buffer buffer)
+{
+    if(d_open.commands == VK_NULL_HANDLE)
+        beginBatch();
+    d_open.released.push_back(buffer);
+}
+
+void UploadQueue::submit()
+{
+    if(d_open.commands == VK_NULL_HANDLE)
+        return;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if(d_separate_transfer)
+    {
+        // the copies signal the graphics half of the batch, its acquire barriers wait at the transfer stage
+        vkEndCommandBuffer(d_open.commands);
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &d_open.commands;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &d_open.copied;
+        if(vkQueueSubmit(d_transfer_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to submit Vulkan upload command buffer!");
+
+        submitInfo = VkSubmitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &d_open.copied;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+
+    // make buffer copies and blits visible to the draws, image transitions carry their own barriers
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(d_open.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        1, &barrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(d_open.graphicsCommands);
+
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &d_open.graphicsCommands;
+    if(vkQueueSubmit(d_graphics_queue, 1, &submitInfo, d_open.fence) != VK_SUCCESS)
+        throw std::runtime_error("ERROR: failed to submit Vulkan upload command buffer!");
+    d_submits++;
+
+    d_open.ringEnd = d_ring_head;
+    d_in_flight.push_back(d_open);
+    d_open = Batch();
+    // free what already finished without blocking
+    reclaim(false);
+}
+
+void UploadQueue::finish()
+{
+    submit();
+    while(reclaim(true));
+}
+
+std::string UploadQueue::describe()
+{
+    std::stringstream ss;
+    ss << d_recorded << " uploads in " << d_submits << " submits and " << d_waits << " waits (would have been " << d_recorded << " submits and waits without batching), "
+       << (d_staged_bytes >> 10) << " KB staged through a " << (d_ring_size >> 20) << " MB ring";
+    if(d_dedicated)
+        ss << ", " << d_dedicated << " staging buffers for large data";
+    if(d_separate_transfer)
+        ss << ", copies on transfer queue family " << d_transfer_family_id << " with " << d_ownership_transfers << " ownership transfers";
+    else
+        ss << ", no separate transfer queue family, copies on the graphics queue";
+    return ss.str();
+}
+
+void UploadQueue::beginBatch()
+{
+    if(d_finished.size())
+    {
+        d_open = d_finished.back();
+        d_finished.pop_back();
+        vkResetCommandBuffer(d_open.commands, 0);
+        if(d_separate_transfer)
+            vkResetCommandBuffer(d_open.graphicsCommands, 0);
+        vkResetFences(d_device, 1, &d_open.fence);
+    }
+    else
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = d_command_pool;
+        allocInfo.commandBufferCount = 1;
+        if(vkAllocateCommandBuffers(d_device, &allocInfo, &d_open.commands) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to allocate Vulkan upload command buffer!");
+        d_open.graphicsCommands = d_open.commands;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if(vkCreateFence(d_device, &fenceInfo, nullptr, &d_open.fence) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to create Vulkan upload fence!");
+
+        if(d_separate_transfer)
+        {
+            allocInfo.commandPool = d_graphics_command_pool;
+            if(vkAllocateCommandBuffers(d_device, &allocInfo, &d_open.graphicsCommands) != VK_SUCCESS)
+                throw std::runtime_error("ERROR: failed to allocate Vulkan upload command buffer!");
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if(vkCreateSemaphore(d_device, &semaphoreInfo, nullptr, &d_open.copied) != VK_SUCCESS)
+                throw std::runtime_error("ERROR: failed to create Vulkan upload semaphore!");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(d_open.commands, &beginInfo);
+    if(d_separate_transfer)
+        vkBeginCommandBuffer(d_open.graphicsCommands, &beginInfo);
+}
+
+bool UploadQueue::reclaim(bool wait)
+{
+    if(d_in_flight.empty())
+        return false;
+    if(wait && vkGetFenceStatus(d_device, d_in_flight.front().fence) != VK_SUCCESS)
+    {
+        vkWaitForFences(d_device, 1, &d_in_flight.front().fence, VK_TRUE, UINT64_MAX);
+        d_waits++;
+    }
+    while(d_in_flight.size() && vkGetFenceStatus(d_device, d_in_flight.front().fence) == VK_SUCCESS)
+    {
+        Batch& batch = d_in_flight.front();
+        d_ring_tail = batch.ringEnd;
+        for(auto& buffer : batch.released)
+            buffer.destroy(d_device);
+        batch.released.clear();
+        d_finished.push_back(batch);
+        d_in_flight.pop_front();
+    }
+    return true;
+}
+
+Buffer UploadQueue::createStagingBuffer(VkDeviceSize size, void** mapped)
+{
+    Buffer newBuffer;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(vkCreateBuffer(d_device, &bufferInfo, nullptr, &newBuffer.buf) != VK_SUCCESS)
+        throw std::runtime_error("ERROR: failed to create Vulkan staging buffer!");
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(d_device, newBuffer.buf, &memRequirements);
+
+    newBuffer.mem = app->GetBackend()->p_allocator->allocate(memRequirements,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    vkBindBufferMemory(d_device, newBuffer.buf, newBuffer.mem.memory, newBuffer.mem.offset);
+    *mapped = newBuffer.mem.mapped;
+    newBuffer.allset = true;
+    return newBuffer;
+}